@@ -0,0 +1,201 @@
+/****************************************
+ *
+ *   Constellation almanac
+ *   Reduced almanacs of message 12, 31
+ *   and midi almanacs of message 37
+ *   gathered per PRN
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef ALMANAC_H
+#define ALMANAC_H
+
+#include <stdint.h>
+#include <cmath>
+
+#include "gps_l2_satellite.h"
+#include "orbit_engine.h"
+
+#define ALM_I0        0.30       /* reference inclination (semi-circles) */
+#define ALM_RED_DI    0.0056     /* reduced almanac inclination offset */
+#define ALM_TOA_SCALE 4096       /* toa scale factor 2^12 (s) */
+
+
+/*
+___________________________________________________
+   Almanac Struct:
+        orbital elements in radians
+        source: 12, 31 reduced or 37 midi
+        health: L1 L2 L5 bits, set if unhealthy
+___________________________________________________
+
+*/
+typedef struct
+{
+    bool valid;
+    uint8_t source;
+    uint8_t health;
+    int week;
+    double toa;
+    double sqrtA;
+    double e;
+    double i0;
+    double OMEGA0;
+    double OMEGA_DOT;
+    double omega;
+    double M0;
+    double af0;
+    double af1;
+
+} alm;
+
+
+/*___________________________________________________
+   Almanac Class:
+        :sat: latest almanac of PRN 1 - 32
+        :member functions:::::::::::::::::::::
+            -update: fold in a decoded message
+            -collect: every almanac of a file
+            -position: ecef position at t
+_____________________________________________________
+
+*/
+class Almanac{
+
+    public:
+
+    alm sat[MAXPRN + 1];
+
+    Almanac()
+    {
+        for(int i = 0 ; i <= MAXPRN ; i++) sat[i] = alm();
+    }
+
+    void update(const Msg_Type_12& m)
+    {
+        for(const auto& red: m.redalm)
+            update_reduced(m.WNan, m.toa, red, 12);
+    }
+
+    void update(const Msg_Type_31& m)
+    {
+        for(const auto& red: m.redalm)
+            update_reduced(m.WNan, m.toa, red, 31);
+    }
+
+    void update(const Msg_Type_37& m)
+    {
+        alm a = alm();
+        a.valid = true;
+        a.source = 37;
+        a.health = m.L1_health << 2 | m.L2_health << 1 | m.L5_health;
+        a.week = m.WNan;
+        a.toa = (double)m.toa * ALM_TOA_SCALE;
+        a.sqrtA = m.sqrtA;
+        a.e = m.e;
+        a.i0 = (ALM_I0 + m.delta_i) * PI;
+        a.OMEGA0 = m.OMEGA0 * PI;
+        a.OMEGA_DOT = m.OMEGA_DOT * PI;
+        a.omega = m.omega * PI;
+        a.M0 = m.M0 * PI;
+        a.af0 = m.af0a;
+        a.af1 = m.af1a;
+        store(m.PRNa, a);
+    }
+
+    /* almanacs received by every satellite */
+    void collect(const SatelliteFile& file)
+    {
+        for(int i = 1 ; i <= MAXPRN ; i++)
+        {
+            const Satellite* s = file.satellite[i];
+            for(const auto& m: s->m12) update(m);
+            for(const auto& m: s->m31) update(m);
+            for(const auto& m: s->m37) update(m);
+        }
+    }
+
+    /*
+        Ecef position from almanac
+        @param t: gps seconds since gps epoch
+        @param pos: ecef position (m)
+        @return false if PRN has no almanac
+    */
+    bool position(int prn, double t, double* pos) const
+    {
+        if(prn < 1 || prn > MAXPRN || !sat[prn].valid) return false;
+
+        const alm& a = sat[prn];
+        double tk = t - (a.week * 604800.0 + a.toa);
+        double A = a.sqrtA * a.sqrtA;
+        double M = a.M0 + sqrt(MU_GPS / (A * A * A)) * tk;
+
+        double E = M, sinE, cosE;
+        for(int k = 0 ; k < KEPLER_ITER + 1 ; k++){
+            fast_sincos(E, &sinE, &cosE);
+            E -= (E - a.e * sinE - M) / (1.0 - a.e * cosE);
+        }
+        fast_sincos(E, &sinE, &cosE);
+
+        double den = 1.0 - a.e * cosE;
+        double sin_v = sqrt(1.0 - a.e * a.e) * sinE / den;
+        double cos_v = (cosE - a.e) / den;
+        double sin_w, cos_w, si, ci, sW, cW;
+        fast_sincos(a.omega, &sin_w, &cos_w);
+        fast_sincos(a.i0, &si, &ci);
+        fast_sincos(a.OMEGA0 + (a.OMEGA_DOT - OMEGA_E) * tk - OMEGA_E * a.toa, &sW, &cW);
+
+        double r = A * den;
+        double xp = r * (cos_v * cos_w - sin_v * sin_w);
+        double yp = r * (sin_v * cos_w + cos_v * sin_w);
+
+        pos[0] = xp * cW - yp * ci * sW;
+        pos[1] = xp * sW + yp * ci * cW;
+        pos[2] = yp * si;
+        return true;
+    }
+
+    private:
+
+    /* newer almanac wins, midi over reduced for the same toa */
+    void store(int prn, const alm& a)
+    {
+        if(prn < 1 || prn > MAXPRN) return;
+
+        const alm& old = sat[prn];
+        double t_new = a.week * 604800.0 + a.toa;
+        double t_old = old.week * 604800.0 + old.toa;
+
+        if(!old.valid || t_new > t_old
+           || (t_new == t_old && (a.source == 37 || old.source != 37)))
+            sat[prn] = a;
+    }
+
+    /* reduced almanac: e = 0, omega = 0, i = 55 deg */
+    void update_reduced(int week, int toa,
+                        const Msg_Type_12::reduced_almanac& red, uint8_t source)
+    {
+        alm a = alm();
+        a.valid = true;
+        a.source = source;
+        a.health = red.L1 << 2 | red.L2 << 1 | red.L5;
+        a.week = week;
+        a.toa = (double)toa * ALM_TOA_SCALE;
+        a.sqrtA = sqrt(AREF + red.sigma_A);
+        a.e = 0;
+        a.i0 = (ALM_I0 + ALM_RED_DI) * PI;
+        a.OMEGA0 = red.omega_0 * PI;
+        a.OMEGA_DOT = OMEGADOTREF * PI;
+        a.omega = 0;
+        a.M0 = red.phi_0 * PI;
+        store(red.PRNa, a);
+    }
+
+};
+
+
+#endif
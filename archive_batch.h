@@ -0,0 +1,458 @@
+/****************************************
+ *
+ *   Archive batch
+ *   Work stealing reprocessing of many
+ *   binary captures of any size
+ *
+ *   A file is framed in chunk tasks, its
+ *   PRN groups are decoded in group tasks
+ *   and one merge task feeds the store in
+ *   file order, so results do not depend
+ *   on which worker ran what. Captures
+ *   sharing a sink merge one after the
+ *   other in the order added. Workers pop
+ *   their own deque from the back and
+ *   steal from the front of the others
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef ARCHIVE_BATCH_H
+#define ARCHIVE_BATCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <iostream>
+#ifndef WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "gps_l2_cnav_decode.h"
+#include "ubx_framer.h"
+#include "ndjson_sink.h"
+
+#define BATCH_CHUNK   (64 << 20) /* bytes framed by one task */
+#define BATCH_GROUPS  32         /* most PRN groups of a file */
+
+enum { TASK_CHUNK, TASK_GROUP, TASK_MERGE };
+
+
+/* unit of work, kind on file, index is chunk or group */
+typedef struct{
+
+    int kind;
+    int file;
+    int index;
+
+} batch_task;
+
+
+/*___________________________________________________
+   TaskDeque Class:
+        Deque of one worker, the owner works
+        at the back, thieves take the oldest
+        and largest work from the front
+_____________________________________________________
+
+*/
+class TaskDeque{
+
+    public:
+
+    void push(const batch_task& t)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        q.push_back(t);
+    }
+
+    bool pop(batch_task& t)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        if(q.empty()) return false;
+        t = q.back();
+        q.pop_back();
+        return true;
+    }
+
+    bool steal(batch_task& t)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        if(q.empty()) return false;
+        t = q.front();
+        q.pop_front();
+        return true;
+    }
+
+    private:
+
+    std::mutex m;
+    std::deque<batch_task> q;
+
+};
+
+
+/* frames of one chunk, frame results by position */
+typedef struct{
+
+    size_t begin, end;
+    std::vector<uint64_t> at;                   /* frame offsets, file order */
+    std::vector<uint8_t> id;                    /* message id, 0 if it failed */
+    std::vector<uint8_t> stored;                /* frame completed an upload */
+    std::vector<std::vector<uint32_t>> group;   /* positions of each group */
+
+} batch_chunk;
+
+/* one capture and the state of its tasks */
+struct batch_file{
+
+    std::string path;
+    const uint8_t* data = NULL;
+    size_t size = 0;
+    std::vector<uint8_t> copy;                  /* data when not mapped */
+    std::vector<batch_chunk> chunks;
+    std::atomic<int> chunks_left{0};
+    std::atomic<int> groups_left{0};
+    std::vector<eph> uploads[MAXPRN + 1];       /* completed uploads in order */
+    NdjsonSink* sink = NULL;
+    int chain = 0;                              /* merge chain of its sink */
+    size_t link = 0;                            /* place in the chain */
+    std::unique_ptr<SatelliteFile> file;
+
+};
+
+/* captures of one sink, merged one at a time in order */
+struct merge_chain{
+
+    std::mutex m;
+    std::vector<int> files;
+    std::vector<uint8_t> ready;                 /* decoded, merge waiting */
+    size_t next = 0;                            /* next file to merge */
+
+};
+
+
+/*___________________________________________________
+   ArchiveBatch Class:
+        :threads: workers, 0 for the core count
+        :chunk_bytes: bytes framed by one task
+        :tasks, steals: per worker, last run
+        :elapsed: seconds of the last run
+        :member functions:::::::::::::::::::::
+            -add: capture to process, its
+             messages to sink if given,
+             captures of one sink are written
+             in the order added
+            -run: every capture, false if one
+             can not be read
+            -file: decoded SatelliteFile of the
+             i-th capture
+_____________________________________________________
+
+*/
+class ArchiveBatch{
+
+    public:
+
+    int threads;
+    size_t chunk_bytes;
+    std::vector<size_t> tasks;
+    std::vector<size_t> steals;
+    double elapsed;
+
+    ArchiveBatch(int threads = 0, size_t chunk_bytes = BATCH_CHUNK)
+        : threads(threads), chunk_bytes(chunk_bytes), elapsed(0), groups(1) {}
+
+    ~ArchiveBatch() { for(auto& f: jobs) unmap(*f); }
+
+    void add(const std::string& path, NdjsonSink* sink = NULL)
+    {
+        jobs.emplace_back(new batch_file());
+        jobs.back()->path = path;
+        jobs.back()->sink = sink;
+    }
+
+    size_t files() const { return jobs.size(); }
+
+    SatelliteFile& file(size_t i) { return *jobs[i]->file; }
+
+    bool run()
+    {
+        int n = threads > 0 ? threads : (int)std::thread::hardware_concurrency();
+        if(n < 1) n = 1;
+        groups = std::min(n, BATCH_GROUPS);
+
+        bool ok = true;
+        for(auto& f: jobs) if(!map(*f)) ok = false;
+
+        /* largest captures first, their chunks spread over every deque */
+        std::vector<int> order(jobs.size());
+        for(size_t i = 0 ; i < order.size() ; i++) order[i] = (int)i;
+        std::stable_sort(order.begin(), order.end(),
+                         [&](int a, int b){ return jobs[a]->size > jobs[b]->size; });
+
+        deques.clear();
+        for(int w = 0 ; w < n ; w++) deques.emplace_back(new TaskDeque());
+        tasks.assign(n, 0);
+        steals.assign(n, 0);
+
+        /* one chain per sink, a capture without one is its own chain */
+        chains.clear();
+        for(size_t i = 0 ; i < jobs.size() ; i++)
+        {
+            batch_file& f = *jobs[i];
+            f.chain = -1;
+            for(size_t j = 0 ; j < i && f.sink ; j++)
+                if(jobs[j]->sink == f.sink){ f.chain = jobs[j]->chain; break; }
+            if(f.chain < 0){
+                f.chain = (int)chains.size();
+                chains.emplace_back(new merge_chain());
+            }
+            merge_chain& c = *chains[f.chain];
+            f.link = c.files.size();
+            c.files.push_back((int)i);
+            c.ready.push_back(0);
+        }
+
+        long total = 0;
+        int next = 0;
+        for(int i: order)
+        {
+            batch_file& f = *jobs[i];
+            f.file.reset(new SatelliteFile());
+            f.file->sink = f.sink;
+            split(f);
+            total += (long)f.chunks.size() + groups + 1;
+            for(size_t c = 0 ; c < f.chunks.size() ; c++)
+                deques[next++ % n]->push(batch_task{ TASK_CHUNK, i, (int)c });
+        }
+        remaining.store(total);
+
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> pool;
+        for(int w = 0 ; w < n ; w++) pool.emplace_back([this, w]{ work(w); });
+        for(std::thread& t: pool) t.join();
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        for(auto& f: jobs) unmap(*f);
+        return ok;
+    }
+
+    private:
+
+    int groups;
+    std::vector<std::unique_ptr<batch_file>> jobs;
+    std::vector<std::unique_ptr<TaskDeque>> deques;
+    std::vector<std::unique_ptr<merge_chain>> chains;
+    std::atomic<long> remaining;
+
+    bool map(batch_file& f)
+    {
+#ifndef WIN32
+        int fd = ::open(f.path.c_str(), O_RDONLY);
+        if(fd < 0){
+            std::cout << "File can not be opened: " << f.path << std::endl;
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size == 0){ ::close(fd); return st.st_size == 0; }
+
+        f.size = (size_t)st.st_size;
+        void* p = mmap(NULL, f.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED){ f.size = 0; return false; }
+        madvise(p, f.size, MADV_SEQUENTIAL);
+        f.data = (const uint8_t*)p;
+        return true;
+#else
+        FILE* fp = fopen(f.path.c_str(), "rb");
+        if(fp == NULL){
+            std::cout << "File can not be opened: " << f.path << std::endl;
+            return false;
+        }
+        uint8_t block[1 << 16];
+        size_t k;
+        while((k = fread(block, 1, sizeof block, fp)) > 0)
+            f.copy.insert(f.copy.end(), block, block + k);
+        fclose(fp);
+        f.data = f.copy.data();
+        f.size = f.copy.size();
+        return true;
+#endif
+    }
+
+    void unmap(batch_file& f)
+    {
+#ifndef WIN32
+        if(f.data) munmap((void*)f.data, f.size);
+#endif
+        f.copy.clear();
+        f.data = NULL;
+    }
+
+    void split(batch_file& f)
+    {
+        size_t k = f.size / chunk_bytes + 1;
+        f.chunks.assign(k, batch_chunk());
+        for(size_t c = 0 ; c < k ; c++){
+            f.chunks[c].begin = c * chunk_bytes;
+            f.chunks[c].end = std::min(f.size, (c + 1) * chunk_bytes);
+            f.chunks[c].group.resize(groups);
+        }
+        f.chunks_left.store((int)k);
+        f.groups_left.store(groups);
+    }
+
+    /* fibonacci hash of the PRN, as the pipeline workers */
+    int route(int prn) const
+    {
+        return (int)(((uint32_t)prn * 2654435761u >> 16) % (uint32_t)groups);
+    }
+
+    void work(int w)
+    {
+        uint32_t seed = 2463534242u + w;
+        while(remaining.load(std::memory_order_acquire) > 0)
+        {
+            batch_task t;
+            if(!deques[w]->pop(t) && !steal(w, seed, t)){
+                std::this_thread::yield();
+                continue;
+            }
+
+            switch(t.kind)
+            {
+                case TASK_CHUNK: chunk(w, *jobs[t.file], t); break;
+                case TASK_GROUP: group(w, *jobs[t.file], t); break;
+                case TASK_MERGE: merge(w, *jobs[t.file]); break;
+            }
+            tasks[w]++;
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    /* every other deque once, from a random victim */
+    bool steal(int w, uint32_t& seed, batch_task& t)
+    {
+        int n = (int)deques.size();
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+        for(int i = 0, v = seed % n ; i < n ; i++, v = (v + 1) % n)
+            if(v != w && deques[v]->steal(t)){ steals[w]++; return true; }
+        return false;
+    }
+
+    /*
+        Frames starting in [begin, end) of a chunk,
+        the last one may end past it
+    */
+    void chunk(int w, batch_file& f, const batch_task& t)
+    {
+        batch_chunk& c = f.chunks[t.index];
+        const uint8_t* d = f.data;
+
+        for(size_t p = c.begin ; p < c.end ; )
+        {
+            if(p + UBX_HEAD + 2 > f.size) break;
+            size_t len = d[p + 4] | (size_t)d[p + 5] << 8;
+            if(d[p] != H1 || d[p + 1] != H2 || len > UBX_MAXLEN
+               || p + UBX_HEAD + len + 2 > f.size || !checksum(d + p, len)){
+                p++;
+                continue;
+            }
+
+            frame_view v;
+            if(UbxFramer::view(d + p, len, v)){
+                c.group[route(v.head.svId)].push_back((uint32_t)c.at.size());
+                c.at.push_back(p);
+            }
+            p += UBX_HEAD + len + 2;
+        }
+        c.id.assign(c.at.size(), 0);
+        c.stored.assign(c.at.size(), 0);
+
+        if(f.chunks_left.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            for(int g = 0 ; g < groups ; g++)
+                deques[w]->push(batch_task{ TASK_GROUP, t.file, g });
+    }
+
+    /* satellites of one group, every chunk in order */
+    void group(int w, batch_file& f, const batch_task& t)
+    {
+        for(batch_chunk& c: f.chunks)
+            for(uint32_t i: c.group[t.index])
+            {
+                frame_view v;
+                if(!UbxFramer::view(f.data + c.at[i], LENGTH, v)) continue;
+
+                Satellite* s = f.file->satellite[v.head.svId];
+                s->take(v.head);
+                s->decode_words(v.words);
+
+                c.id[i] = s->last_msg;
+                c.stored[i] = s->eph_updated;
+                if(s->eph_updated) f.uploads[v.head.svId].push_back(s->eph_mssg);
+                s->eph_updated = false;
+                s->dc_msg = 0;
+            }
+
+        if(f.groups_left.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            merge_chain& c = *chains[f.chain];
+            std::lock_guard<std::mutex> lock(c.m);
+            c.ready[f.link] = 1;
+            if(c.next == f.link) deques[w]->push(batch_task{ TASK_MERGE, t.file, 0 });
+        }
+    }
+
+    /* store and corrections in file order, then the next capture of the chain */
+    void merge(int w, batch_file& f)
+    {
+        size_t used[MAXPRN + 1] = { 0 };
+        for(batch_chunk& c: f.chunks)
+        {
+            for(size_t i = 0 ; i < c.at.size() ; i++)
+            {
+                frame_view v;
+                if(!UbxFramer::view(f.data + c.at[i], LENGTH, v)) continue;
+
+                int prn = v.head.svId;
+                const eph* upload = c.stored[i] ? &f.uploads[prn][used[prn]++] : NULL;
+                f.file->merge_frame(prn, c.id[i], v.words, upload);
+            }
+            c = batch_chunk();
+        }
+        for(int prn = 0 ; prn <= MAXPRN ; prn++) std::vector<eph>().swap(f.uploads[prn]);
+
+        merge_chain& c = *chains[f.chain];
+        std::lock_guard<std::mutex> lock(c.m);
+        c.next++;
+        if(c.next < c.files.size() && c.ready[c.next])
+            deques[w]->push(batch_task{ TASK_MERGE, c.files[c.next], 0 });
+    }
+
+    static bool checksum(const uint8_t* frame, size_t len)
+    {
+        ck c;
+        for(size_t i = 2 ; i < UBX_HEAD + len ; i++) calculate(c, frame[i]);
+        return c.ck_a == frame[UBX_HEAD + len] && c.ck_b == frame[UBX_HEAD + len + 1];
+    }
+
+};
+
+
+#endif
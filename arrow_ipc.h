@@ -0,0 +1,656 @@
+/****************************************
+ *
+ *   Arrow IPC files
+ *   Writer and memory mapped reader of
+ *   the Arrow IPC file layout, flat
+ *   schemas of fixed width columns
+ *
+ *   Metadata flatbuffers are built by
+ *   hand, column buffers go to the file
+ *   straight from the caller's arrays
+ *   and are read in place from the map
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef ARROW_IPC_H
+#define ARROW_IPC_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define ARROW_V5        4        /* metadata version */
+#define ARROW_SCHEMA    1        /* message header union */
+#define ARROW_BATCH     3
+#define ARROW_INT       2        /* type union */
+#define ARROW_FLOAT     3
+#define ARROW_DOUBLE    2        /* floating point precision */
+#define ARROW_CONT      0xFFFFFFFFu
+
+/* column types */
+#define ARROW_I32       0
+#define ARROW_I64       1
+#define ARROW_F64       2
+#define ARROW_OTHER     3
+
+
+/*___________________________________________________
+   FlatBuilder Class:
+        Flatbuffer built front to back, a
+        table before its children, uoffsets
+        patched once a child is placed
+        :b: buffer, root offset at 0
+        :slot: positions of the fields of the
+               last table ended
+        :member functions:::::::::::::::::::::
+            -begin, add, ref, end: one table
+            -string, refs, structs: vectors
+            -link: point a ref at a child
+            -finish: root table
+_____________________________________________________
+
+*/
+class FlatBuilder{
+
+    public:
+
+    std::vector<uint8_t> b;
+    size_t slot[16];
+
+    FlatBuilder() : b(4, 0), n(0), count(0) {}
+
+    void begin(int slots)
+    {
+        n = slots;
+        count = 0;
+    }
+
+    void add(int id, uint8_t v)  { push(id, 1, v); }
+    void add(int id, int16_t v)  { push(id, 2, (uint16_t)v); }
+    void add(int id, int32_t v)  { push(id, 4, (uint32_t)v); }
+    void add(int id, int64_t v)  { push(id, 8, (uint64_t)v); }
+
+    /* uoffset to a child placed later */
+    void ref(int id)             { push(id, 4, 0, true); }
+
+    /*
+        vtable, then the table, 8 byte fields first
+        @return table position
+    */
+    size_t end()
+    {
+        align(2);
+        size_t vt = b.size();
+        b.resize(vt + 4 + 2 * n, 0);
+
+        align(8);
+        size_t t = b.size();
+        b.resize(t + 8, 0);
+        put32(t, (uint32_t)(t - vt));
+
+        for(int w = 8 ; w >= 1 ; w /= 2)
+            for(int i = 0 ; i < count ; i++)
+            {
+                if(field[i].size != w) continue;
+                align(w);
+                size_t at = b.size();
+                b.resize(at + w, 0);
+                memcpy(b.data() + at, &field[i].v, w);
+                slot[field[i].id] = at;
+                put16(vt + 4 + 2 * field[i].id, (uint16_t)(at - t));
+            }
+
+        put16(vt, (uint16_t)(4 + 2 * n));
+        put16(vt + 2, (uint16_t)(b.size() - t));
+        return t;
+    }
+
+    size_t string(const char* s)
+    {
+        uint32_t len = (uint32_t)strlen(s);
+        align(4);
+        size_t at = b.size();
+        b.resize(at + 4 + len + 1, 0);
+        put32(at, len);
+        memcpy(b.data() + at + 4, s, len);
+        return at;
+    }
+
+    /* vector of count uoffsets, element i at +4 + 4 i */
+    size_t refs(size_t count)
+    {
+        align(4);
+        size_t at = b.size();
+        b.resize(at + 4 + 4 * count, 0);
+        put32(at, (uint32_t)count);
+        return at;
+    }
+
+    /* vector of 8 byte aligned structs */
+    size_t structs(const void* data, size_t size, size_t count)
+    {
+        while((b.size() + 4) % 8) b.push_back(0);
+        size_t at = b.size();
+        b.resize(at + 4 + size * count, 0);
+        put32(at, (uint32_t)count);
+        if(count) memcpy(b.data() + at + 4, data, size * count);
+        return at;
+    }
+
+    void link(size_t at, size_t target)
+    {
+        put32(at, (uint32_t)(target - at));
+    }
+
+    /* root offset, size padded to 8 */
+    size_t finish(size_t root)
+    {
+        put32(0, (uint32_t)root);
+        align(8);
+        return b.size();
+    }
+
+    private:
+
+    typedef struct
+    {
+        int id;
+        int size;
+        uint64_t v;
+    } pending;
+
+    pending field[16];
+    int n;
+    int count;
+
+    void push(int id, int size, uint64_t v, bool is_ref = false)
+    {
+        field[count].id = id;
+        field[count].size = size;
+        field[count].v = is_ref ? 0 : v;
+        count++;
+    }
+
+    void align(size_t a)
+    {
+        while(b.size() % a) b.push_back(0);
+    }
+
+    void put16(size_t at, uint16_t v) { memcpy(b.data() + at, &v, 2); }
+    void put32(size_t at, uint32_t v) { memcpy(b.data() + at, &v, 4); }
+
+};
+
+
+/*
+___________________________________________________
+   Arrow Column Struct:
+        :name: field name
+        :type: ARROW_I32, ARROW_I64, ARROW_F64
+        :data: rows values, the caller's memory
+___________________________________________________
+
+*/
+typedef struct
+{
+    const char* name;
+    int type;
+    const void* data;
+
+} arrow_column;
+
+
+/*___________________________________________________
+   ArrowWriter Class:
+        One record batch of flat columns as an
+        Arrow IPC file, column memory is written
+        as it is
+        :member functions:::::::::::::::::::::
+            -write: schema, batch, footer
+_____________________________________________________
+
+*/
+class ArrowWriter{
+
+    public:
+
+    /* @return false if the file can not be written */
+    static bool write(const std::string& path, const arrow_column* cols, int n, size_t rows)
+    {
+        FILE* fp = fopen(path.c_str(), "wb");
+        if(fp == NULL){
+            std::cout << "Arrow file can not be opened: " << path << std::endl;
+            return false;
+        }
+
+        /* body layout, empty validity then values of each column */
+        std::vector<int64_t> nodes(2 * n), bufs(4 * n);
+        int64_t body = 0;
+        for(int k = 0 ; k < n ; k++){
+            int64_t len = (int64_t)(rows * width(cols[k].type));
+            nodes[2*k] = (int64_t)rows;
+            nodes[2*k+1] = 0;
+            bufs[4*k] = body;
+            bufs[4*k+1] = 0;
+            bufs[4*k+2] = body;
+            bufs[4*k+3] = len;
+            body += pad8(len);
+        }
+
+        bool ok = fwrite("ARROW1\0\0", 1, 8, fp) == 8;
+        int64_t pos = 8;
+
+        FlatBuilder s;
+        s.begin(5);
+        s.add(0, (int16_t)ARROW_V5);
+        s.add(1, (uint8_t)ARROW_SCHEMA);
+        s.ref(2);
+        size_t msg = s.end();
+        s.link(s.slot[2], schema(s, cols, n));
+        ok = ok && message(fp, s, msg, pos) > 0;
+
+        /* record batch */
+        FlatBuilder r;
+        r.begin(5);
+        r.add(0, (int16_t)ARROW_V5);
+        r.add(1, (uint8_t)ARROW_BATCH);
+        r.ref(2);
+        r.add(3, body);
+        msg = r.end();
+        size_t hdr = r.slot[2];
+
+        r.begin(5);
+        r.add(0, (int64_t)rows);
+        r.ref(1);
+        r.ref(2);
+        size_t rb = r.end();
+        size_t node_at = r.slot[1], buf_at = r.slot[2];
+        r.link(hdr, rb);
+        r.link(node_at, r.structs(nodes.data(), 16, n));
+        r.link(buf_at, r.structs(bufs.data(), 16, 2 * n));
+
+        int64_t block[3] = { pos, 0, body };
+        int32_t meta = message(fp, r, msg, pos);
+        memcpy((char*)block + 8, &meta, 4);
+        ok = ok && meta > 0;
+
+        static const char zeros[8] = { 0 };
+        for(int k = 0 ; k < n && ok ; k++){
+            size_t len = (size_t)bufs[4*k+3];
+            ok = fwrite(cols[k].data, 1, len, fp) == len
+              && fwrite(zeros, 1, pad8(len) - len, fp) == pad8(len) - len;
+        }
+        pos += body;
+
+        /* end of stream, footer */
+        uint32_t eos[2] = { ARROW_CONT, 0 };
+        ok = ok && fwrite(eos, 4, 2, fp) == 2;
+
+        FlatBuilder f;
+        f.begin(5);
+        f.add(0, (int16_t)ARROW_V5);
+        f.ref(1);
+        f.ref(3);
+        size_t footer = f.end();
+        size_t schema_at = f.slot[1], blocks_at = f.slot[3];
+        f.link(schema_at, schema(f, cols, n));
+        f.link(blocks_at, f.structs(block, 24, 1));
+        int32_t len = (int32_t)f.finish(footer);
+
+        ok = ok && fwrite(f.b.data(), 1, len, fp) == (size_t)len
+                && fwrite(&len, 4, 1, fp) == 1
+                && fwrite("ARROW1", 1, 6, fp) == 6;
+
+        return fclose(fp) == 0 && ok;
+    }
+
+    static size_t width(int type)
+    {
+        return type == ARROW_I32 ? 4 : 8;
+    }
+
+    private:
+
+    static size_t pad8(size_t n) { return (n + 7) & ~(size_t)7; }
+    static int64_t pad8(int64_t n) { return (n + 7) & ~(int64_t)7; }
+
+    /* schema table with its fields, @return its position */
+    static size_t schema(FlatBuilder& fb, const arrow_column* cols, int n)
+    {
+        fb.begin(4);
+        fb.ref(1);
+        size_t s = fb.end();
+        size_t fields_at = fb.slot[1];
+
+        size_t v = fb.refs(n);
+        fb.link(fields_at, v);
+
+        for(int k = 0 ; k < n ; k++)
+        {
+            fb.begin(7);
+            fb.ref(0);
+            fb.add(1, (uint8_t)0);
+            fb.add(2, (uint8_t)(cols[k].type == ARROW_F64 ? ARROW_FLOAT : ARROW_INT));
+            fb.ref(3);
+            fb.ref(5);
+            size_t field = fb.end();
+            size_t name_at = fb.slot[0], type_at = fb.slot[3], child_at = fb.slot[5];
+            fb.link(v + 4 + 4 * k, field);
+
+            fb.link(name_at, fb.string(cols[k].name));
+
+            if(cols[k].type == ARROW_F64){
+                fb.begin(1);
+                fb.add(0, (int16_t)ARROW_DOUBLE);
+            }
+            else{
+                fb.begin(2);
+                fb.add(0, (int32_t)(8 * width(cols[k].type)));
+                fb.add(1, (uint8_t)1);
+            }
+            fb.link(type_at, fb.end());
+            fb.link(child_at, fb.refs(0));
+        }
+        return s;
+    }
+
+    /*
+        Continuation, metadata length and the padded
+        flatbuffer, pos moves past it
+        @return metadata length with the prefix, 0 on
+                a write error
+    */
+    static int32_t message(FILE* fp, FlatBuilder& fb, size_t root, int64_t& pos)
+    {
+        int32_t len = (int32_t)fb.finish(root);
+        uint32_t prefix[2] = { ARROW_CONT, (uint32_t)len };
+        bool ok = fwrite(prefix, 4, 2, fp) == 2
+               && fwrite(fb.b.data(), 1, len, fp) == (size_t)len;
+        pos += 8 + len;
+        return ok ? 8 + len : 0;
+    }
+
+};
+
+
+/*___________________________________________________
+   ArrowFile Class:
+        Memory mapped Arrow IPC file, columns
+        point into the map
+        :member functions:::::::::::::::::::::
+            -open, close
+            -columns, name, type: schema
+            -batches, rows: record batches
+            -data, column: values of a batch
+_____________________________________________________
+
+*/
+class ArrowFile{
+
+    public:
+
+    ArrowFile() : base(NULL), size(0), bad(false) {}
+    ~ArrowFile() { close(); }
+
+    ArrowFile(const ArrowFile&) = delete;
+    ArrowFile& operator=(const ArrowFile&) = delete;
+
+    /*
+        Map a file and read its footer, flat schemas
+        of fixed width signed int or float columns
+        without nulls or compression, every offset
+        checked against the file
+        @return false otherwise
+    */
+    bool open(const std::string& path)
+    {
+        close();
+#ifndef WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0){
+            std::cout << "Arrow file can not be opened: " << path << std::endl;
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size < 24){ ::close(fd); return false; }
+        size = (size_t)st.st_size;
+        void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(map == MAP_FAILED){ size = 0; return false; }
+        base = (const uint8_t*)map;
+#else
+        FILE* fp = fopen(path.c_str(), "rb");
+        if(fp == NULL){
+            std::cout << "Arrow file can not be opened: " << path << std::endl;
+            return false;
+        }
+        char block[1 << 16];
+        size_t n;
+        while((n = fread(block, 1, sizeof block, fp)) > 0)
+            copy.insert(copy.end(), block, block + n);
+        fclose(fp);
+        base = copy.data();
+        size = copy.size();
+#endif
+        if(!footer()){ close(); return false; }
+        return true;
+    }
+
+    void close()
+    {
+#ifndef WIN32
+        if(base) munmap((void*)base, size);
+#else
+        copy.clear();
+#endif
+        base = NULL;
+        size = 0;
+        fields.clear();
+        batch.clear();
+    }
+
+    int columns() const                 { return (int)fields.size(); }
+    const std::string& name(int k) const { return fields[k].name; }
+    int type(int k) const               { return fields[k].type; }
+    size_t batches() const              { return batch.size(); }
+    size_t rows(size_t b) const         { return batch[b].rows; }
+
+    /* values of column k in batch b */
+    const void* data(size_t b, int k) const
+    {
+        return base + batch[b].data[k];
+    }
+
+    template <class T>
+    const T* column(size_t b, int k) const
+    {
+        return (const T*)data(b, k);
+    }
+
+    /* column index by name, -1 if there is none */
+    int find(const char* s) const
+    {
+        for(size_t k = 0 ; k < fields.size() ; k++)
+            if(fields[k].name == s) return (int)k;
+        return -1;
+    }
+
+    private:
+
+    typedef struct
+    {
+        std::string name;
+        int type;
+        size_t width;
+    } field_info;
+
+    typedef struct
+    {
+        size_t rows;
+        std::vector<size_t> data;     /* offsets into the map */
+    } batch_info;
+
+    const uint8_t* base;
+    size_t size;
+    bool bad;                     /* a read fell outside the map */
+    std::vector<field_info> fields;
+    std::vector<batch_info> batch;
+#ifdef WIN32
+    std::vector<uint8_t> copy;
+#endif
+
+    /* n bytes at pos lie in the map, else the file is bad */
+    bool inside(size_t pos, size_t n)
+    {
+        if(pos <= size && n <= size - pos) return true;
+        bad = true;
+        return false;
+    }
+
+    uint32_t u32(size_t at) { uint32_t v = 0; if(inside(at, 4)) memcpy(&v, base + at, 4); return v; }
+    int64_t i64(size_t at)  { int64_t v = 0;  if(inside(at, 8)) memcpy(&v, base + at, 8); return v; }
+    uint16_t u16(size_t at) { uint16_t v = 0; if(inside(at, 2)) memcpy(&v, base + at, 2); return v; }
+    uint8_t u8(size_t at)   { return inside(at, 1) ? base[at] : 0; }
+
+    /* position of field id of the table at t, 0 if absent */
+    size_t at(size_t t, int id)
+    {
+        if(t == 0) return 0;
+        size_t vt = t - (int32_t)u32(t);
+        if((size_t)(4 + 2 * id) >= u16(vt)) return 0;
+        uint16_t off = u16(vt + 4 + 2 * id);
+        return off && inside(t + off, 1) ? t + off : 0;
+    }
+
+    size_t deref(size_t pos)
+    {
+        if(pos == 0) return 0;
+        size_t v = pos + u32(pos);
+        return inside(v, 4) ? v : 0;
+    }
+
+    /* length of the vector at v, 0 if it does not fit */
+    size_t count(size_t v, size_t width)
+    {
+        size_t n = u32(v);
+        return inside(v + 4, n * width) ? n : 0;
+    }
+
+    bool footer()
+    {
+        bad = false;
+        if(memcmp(base, "ARROW1", 6) != 0 || memcmp(base + size - 6, "ARROW1", 6) != 0)
+            return false;
+
+        int32_t len = (int32_t)u32(size - 10);
+        if(len <= 0 || (size_t)len > size - 18) return false;
+        size_t fb = size - 10 - len;
+        size_t root = fb + u32(fb);
+
+        size_t schema = deref(at(root, 1));
+        size_t list = deref(at(schema, 1));
+        if(schema == 0 || list == 0) return false;
+
+        size_t n = count(list, 4);
+        for(size_t i = 0 ; i < n && !bad ; i++)
+        {
+            size_t f = deref(list + 4 + 4 * i);
+            size_t name = deref(at(f, 0));
+            size_t type = deref(at(f, 3));
+            size_t kids = deref(at(f, 5));
+            uint8_t kind = u8(at(f, 2));
+            if(f == 0 || (kids && u32(kids) != 0)) return false;
+
+            field_info fi;
+            fi.name = "";
+            if(name && inside(name + 4, u32(name)))
+                fi.name = std::string((const char*)base + name + 4, u32(name));
+            fi.type = ARROW_OTHER;
+            fi.width = 0;
+
+            /* unsigned ints would read back as signed */
+            if(kind == ARROW_INT && type && u8(at(type, 1))){
+                int bits = at(type, 0) ? (int32_t)u32(at(type, 0)) : 0;
+                fi.type = bits == 32 ? ARROW_I32 : bits == 64 ? ARROW_I64 : ARROW_OTHER;
+                fi.width = fi.type == ARROW_OTHER ? 0 : bits / 8;
+            }
+            else if(kind == ARROW_FLOAT && type){
+                int p = at(type, 0) ? (int16_t)u16(at(type, 0)) : 0;
+                fi.width = p == ARROW_DOUBLE ? 8 : p == 1 ? 4 : 2;
+                fi.type = p == ARROW_DOUBLE ? ARROW_F64 : ARROW_OTHER;
+            }
+            if(fi.width == 0) return false;
+            fields.push_back(fi);
+        }
+
+        size_t blocks = deref(at(root, 3));
+        n = blocks ? count(blocks, 24) : 0;
+        for(size_t i = 0 ; i < n ; i++)
+            if(!record_batch(blocks + 4 + 24 * i)) return false;
+        return !bad;
+    }
+
+    /* record batch of a footer block */
+    bool record_batch(size_t block)
+    {
+        int64_t offset = i64(block);
+        int32_t meta = (int32_t)u32(block + 8);
+        int64_t body_len = i64(block + 16);
+        if(bad || offset < 8 || meta < 8 || body_len < 0
+           || !inside((size_t)offset, (size_t)meta)
+           || !inside((size_t)offset + meta, (size_t)body_len)) return false;
+
+        size_t m = (size_t)offset;
+        size_t fb = u32(m) == ARROW_CONT ? m + 8 : m + 4;
+        size_t root = fb + u32(fb);
+        if(u8(at(root, 1)) != ARROW_BATCH) return false;
+
+        size_t rb = deref(at(root, 2));
+        if(rb == 0 || at(rb, 3)) return false;           /* compressed */
+
+        batch_info bi;
+        int64_t rows = at(rb, 0) ? i64(at(rb, 0)) : 0;
+        if(rows < 0) return false;
+        bi.rows = (size_t)rows;
+
+        /* one node per column, a column holding nulls is refused */
+        size_t nodes = deref(at(rb, 1));
+        if(fields.size() && (nodes == 0 || count(nodes, 16) != fields.size())) return false;
+        for(size_t k = 0 ; k < fields.size() ; k++)
+            if(i64(nodes + 4 + 16 * k) != rows || i64(nodes + 4 + 16 * k + 8) != 0)
+                return false;
+
+        size_t bufs = deref(at(rb, 2));
+        if(bufs == 0 || count(bufs, 16) != 2 * fields.size()) return false;
+
+        size_t body = (size_t)(offset + meta);
+        for(size_t k = 0 ; k < fields.size() ; k++)
+        {
+            size_t b = bufs + 4 + 16 * (2 * k + 1);
+            int64_t off = i64(b), len = i64(b + 8);
+            if(off < 0 || len < 0 || off > body_len || len > body_len - off
+               || bi.rows > (size_t)len / fields[k].width)
+                return false;
+            bi.data.push_back(body + (size_t)off);
+        }
+        batch.push_back(bi);
+        return !bad;
+    }
+
+};
+
+
+#endif
@@ -53,6 +53,59 @@ uint32_t extractbit_LE(uint32_t M, unsigned start_bit, unsigned end_bit)
 
 }
 
+/*
+* extract bits across message words, unsigned
+* bit 0 is the msb of wrd[0], as transmitted
+* @param wrd message words
+* @param pos first bit
+* @param len number of bits, up to 32
+*/
+uint32_t getbitu(const uint32_t* wrd, int pos, int len)
+{
+    uint32_t r = 0;
+    for (int i = pos; i < pos + len; i++)
+        r = (r << 1) | ((wrd[i / 32] >> (31 - i % 32)) & 1u);
+
+    return r;
+}
+
+/*
+* extract bits across message words, two's complement
+*/
+int32_t getbits(const uint32_t* wrd, int pos, int len)
+{
+    uint32_t r = getbitu(wrd, pos, len);
+    if (len <= 0 || len >= 32 || !(r >> (len - 1)))
+        return (int32_t)r;
+
+    return (int32_t)(r | (~0u << len));
+}
+
+/*
+* set bits in a byte buffer, msb first as transmitted
+* @param buff byte buffer
+* @param pos first bit
+* @param len number of bits, up to 32
+* @param data value, low len bits are written
+*/
+void setbitu(uint8_t* buff, int pos, int len, uint32_t data)
+{
+    for (int i = pos + len - 1; i >= pos; i--, data >>= 1)
+    {
+        uint8_t mask = 1u << (7 - i % 8);
+        if (data & 1u) buff[i / 8] |= mask;
+        else           buff[i / 8] &= ~mask;
+    }
+}
+
+/*
+* set bits in a byte buffer, two's complement
+*/
+void setbits(uint8_t* buff, int pos, int len, int32_t data)
+{
+    setbitu(buff, pos, len, (uint32_t)data);
+}
+
 /*
 * concatenate two binary numbers
 * @param length of first number
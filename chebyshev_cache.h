@@ -0,0 +1,308 @@
+/****************************************
+ *
+ *   Chebyshev orbit cache
+ *   Per PRN chebyshev fits of the orbit
+ *   engine over time windows that never
+ *   cross a change of ephemeris
+ *   Position, velocity and clock of a
+ *   cached window cost a few fma each
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef CHEB_CACHE_H
+#define CHEB_CACHE_H
+
+#include <stdint.h>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <algorithm>
+
+#include "orbit_engine.h"
+
+#define CHEB_WINDOW   3600       /* longest fit window (s) */
+#define CHEB_DEGREE   14         /* default polynomial degree */
+#define CHEB_MAXDEG   24         /* max polynomial degree */
+
+
+/*___________________________________________________
+   ChebyshevCache Class:
+        :engine: orbit engine sampled at the nodes
+        :windows: per PRN fitted windows by
+                  ephemeris and index
+        :gen: store generation windows were fit at
+        :member functions:::::::::::::::::::::
+            -state: position, velocity, clock at t
+            -position: position and clock at t
+            -max_error: worst fit error so far
+_____________________________________________________
+
+*/
+class ChebyshevCache{
+
+    public:
+
+    /*
+        @param engine: orbit engine of the store
+        @param store: ephemerides, a new upload of
+                      a PRN drops its windows
+        @param window: fit window length (s)
+        @param degree: polynomial degree
+    */
+    ChebyshevCache(OrbitEngine& orbit_engine, const EphemerisStore& eph_store,
+                   double window = CHEB_WINDOW, int degree = CHEB_DEGREE)
+        : engine(orbit_engine), store(eph_store), span(window),
+          n(degree + 1 > CHEB_MAXDEG ? CHEB_MAXDEG : degree + 1)
+    {
+        for(int i = 0 ; i <= MAXPRN ; i++){ gen[i] = ~0u; last[i] = NULL; }
+        pos_error = 0;
+        clk_error = 0;
+    }
+
+    /*
+        Position and clock of PRN at t
+        @param t: gps seconds since gps epoch
+        @param pos: ecef position (m)
+        @param clk: clock correction (s), may be NULL
+        @return false if no ephemeris covers t
+    */
+    bool position(int prn, double t, double* pos, double* clk = NULL)
+    {
+        const fit* f = window_at(prn, t);
+        if(f == NULL) return false;
+
+        double x = (t - f->mid) / f->half;
+        pos[0] = clenshaw(f->c[0], x);
+        pos[1] = clenshaw(f->c[1], x);
+        pos[2] = clenshaw(f->c[2], x);
+        if(clk) *clk = clenshaw(f->c[3], x);
+        return true;
+    }
+
+    /* position, velocity and clock of PRN at t */
+    bool state(int prn, double t, sat_state& s)
+    {
+        const fit* f = window_at(prn, t);
+        s.valid = (f != NULL);
+        if(f == NULL) return false;
+
+        double x = (t - f->mid) / f->half;
+        for(int k = 0 ; k < 3 ; k++){
+            s.pos[k] = clenshaw(f->c[k], x);
+            s.vel[k] = clenshaw(f->d[k], x);
+        }
+        s.clk = clenshaw(f->c[3], x);
+        s.clk_rate = clenshaw(f->d[3], x);
+        return true;
+    }
+
+    /* largest position (m) and clock (s) fit error */
+    double max_error() const { return pos_error; }
+    double max_clock_error() const { return clk_error; }
+
+    /* drop every fitted window */
+    void clear()
+    {
+        for(int i = 0 ; i <= MAXPRN ; i++){
+            windows[i].clear();
+            last[i] = NULL;
+        }
+    }
+
+    private:
+
+    /* one window, channels x, y, z, clock */
+    struct fit
+    {
+        double mid, half;
+        bool valid;
+        double c[4][CHEB_MAXDEG];    /* series coefficients */
+        double d[4][CHEB_MAXDEG];    /* derivative coefficients */
+        double error;                /* position error (m) */
+    };
+
+    OrbitEngine& engine;
+    const EphemerisStore& store;
+    double span;
+    int n;
+
+    typedef std::pair<size_t, int64_t> window_key;
+
+    std::map<window_key, fit> windows[MAXPRN + 1];
+    const fit* last[MAXPRN + 1];
+    uint32_t gen[MAXPRN + 1];
+    double pos_error;
+    double clk_error;
+
+    /* sum of c_j T_j(x) with the first term halved */
+    double clenshaw(const double* c, double x) const
+    {
+        double b0 = 0, b1 = 0, x2 = 2.0 * x;
+        for(int j = n - 1 ; j >= 1 ; j--){
+            double b = x2 * b0 - b1 + c[j];
+            b1 = b0;
+            b0 = b;
+        }
+        return x * b0 - b1 + 0.5 * c[0];
+    }
+
+    const fit* window_at(int prn, double t)
+    {
+        if(prn < 1 || prn > MAXPRN) return NULL;
+
+        /* new upload of PRN, refit on demand */
+        if(gen[prn] != store.generation(prn)){
+            windows[prn].clear();
+            last[prn] = NULL;
+            gen[prn] = store.generation(prn);
+        }
+
+        const fit* f = last[prn];
+        if(f == NULL || t < f->mid - f->half || t >= f->mid + f->half){
+
+            /* windows are counted from the start of the ephemeris */
+            double lo, hi;
+            const eph* e = ephemeris_at(prn, t);
+            if(e == NULL) return NULL;
+            size_t i = e - store.ephemerides(prn).data();
+            segment(prn, i, lo, hi);
+
+            int64_t k = (int64_t)floor((t - lo) / span);
+            if(k > 0 && lo + k * span >= hi) k--;
+
+            window_key key(i, k);
+            std::map<window_key, fit>::iterator it = windows[prn].find(key);
+            if(it == windows[prn].end()){
+                it = windows[prn].insert(std::make_pair(key, fit())).first;
+                double a = lo + k * span;
+                fit_window(prn, a, std::min(a + span, hi), it->second);
+            }
+            f = last[prn] = &it->second;
+        }
+
+        return f->valid ? f : NULL;
+    }
+
+    const eph* ephemeris_at(int prn, double t) const
+    {
+        gtime_t tt;
+        static const time_t t0 = epoch2time(gpst0).time;
+        double whole = floor(t);
+        tt.time = t0 + (time_t)whole;
+        tt.sec = t - whole;
+        return store.find(prn, tt);
+    }
+
+    /*
+        Times find() picks the i-th ephemeris of PRN:
+        its fit interval, up to the midpoint with a
+        neighbour unless the neighbour does not
+        cover the time there
+    */
+    void segment(int prn, size_t i, double& lo, double& hi) const
+    {
+        const std::vector<eph>& ephs = store.ephemerides(prn);
+        double a, b;
+        cover(ephs[i], lo, hi);
+
+        if(i > 0){
+            cover(ephs[i-1], a, b);
+            double m = (toe_of(ephs[i-1]) + toe_of(ephs[i])) / 2;
+            lo = std::max(lo, std::min(m, b));
+        }
+        if(i + 1 < ephs.size()){
+            cover(ephs[i+1], a, b);
+            double m = (toe_of(ephs[i]) + toe_of(ephs[i+1])) / 2;
+            hi = std::min(hi, std::max(m, a));
+        }
+    }
+
+    static double toe_of(const eph& e)
+    {
+        return gpst_seconds(gpst2time((int)e.week, e.TOE));
+    }
+
+    /* fit interval of an ephemeris around its toe */
+    static void cover(const eph& e, double& lo, double& hi)
+    {
+        int hours = e.fit_interval ? e.fit_interval : EPH_FIT_HOURS;
+        lo = toe_of(e) - hours * 3600 / 2.0;
+        hi = toe_of(e) + hours * 3600 / 2.0;
+    }
+
+    /* sample the engine at chebyshev nodes of [a, b) */
+    void fit_window(int prn, double a, double b, fit& f)
+    {
+        f.half = (b - a) / 2;
+        f.mid = a + f.half;
+        f.valid = false;
+        if(f.half <= 0) return;
+
+        int prns[2 * CHEB_MAXDEG];
+        double t[2 * CHEB_MAXDEG];
+        sat_state s[2 * CHEB_MAXDEG];
+
+        for(int k = 0 ; k < n ; k++){
+            prns[k] = prn;
+            t[k] = f.mid + f.half * cos(PI * (k + 0.5) / n);
+        }
+
+        f.valid = engine.evaluate(prns, t, n, s) == (size_t)n;
+        if(!f.valid) return;
+
+        for(int ch = 0 ; ch < 4 ; ch++)
+        {
+            for(int j = 0 ; j < n ; j++){
+                double sum = 0;
+                for(int k = 0 ; k < n ; k++)
+                    sum += value(s[k], ch) * cos(PI * j * (k + 0.5) / n);
+                f.c[ch][j] = 2.0 * sum / n;
+            }
+
+            /* derivative series, per second */
+            f.d[ch][n-1] = 0;
+            if(n > 1) f.d[ch][n-2] = 2.0 * (n - 1) * f.c[ch][n-1];
+            for(int j = n - 2 ; j >= 1 ; j--)
+                f.d[ch][j-1] = f.d[ch][j+1] + 2.0 * j * f.c[ch][j];
+            for(int j = 0 ; j < n ; j++)
+                f.d[ch][j] /= f.half;
+        }
+
+        /* fit error between the nodes */
+        int m = 2 * n > 2 * CHEB_MAXDEG ? 2 * CHEB_MAXDEG : 2 * n;
+        for(int k = 0 ; k < m ; k++){
+            prns[k] = prn;
+            t[k] = f.mid + f.half * (2.0 * (k + 0.5) / m - 1.0);
+        }
+        engine.evaluate(prns, t, m, s);
+
+        f.error = 0;
+        for(int k = 0 ; k < m ; k++)
+        {
+            if(!s[k].valid) continue;
+            double x = (t[k] - f.mid) / f.half, e2 = 0;
+            for(int ch = 0 ; ch < 3 ; ch++){
+                double d = clenshaw(f.c[ch], x) - s[k].pos[ch];
+                e2 += d * d;
+            }
+            double dc = fabs(clenshaw(f.c[3], x) - s[k].clk);
+
+            if(sqrt(e2) > f.error) f.error = sqrt(e2);
+            if(dc > clk_error) clk_error = dc;
+        }
+        if(f.error > pos_error) pos_error = f.error;
+    }
+
+    static double value(const sat_state& s, int ch)
+    {
+        return ch < 3 ? s.pos[ch] : s.clk;
+    }
+
+};
+
+
+#endif
@@ -0,0 +1,463 @@
+/****************************************
+ *
+ *   Cnav archive
+ *   Decoded messages of a file as one
+ *   column table per message type, kept
+ *   as Arrow IPC files
+ *
+ *   Columns are contiguous arrays, the
+ *   writer hands them to the file as
+ *   they are. A table holds prn, tow, wn
+ *   and every decoded field, packets of
+ *   12, 13, 14 and 31 are a row each
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef CNAV_ARCHIVE_H
+#define CNAV_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "gps_l2_satellite.h"
+#include "arrow_ipc.h"
+
+#define CNAV_TYPES    64         /* 6 bit message type id */
+#define CNAV_TOW_WEEK 100800     /* 6 s tow counts in a week */
+
+
+/*
+___________________________________________________
+   Cnav Column Struct:
+        :name: field name
+        :integer: values in i, else in f
+___________________________________________________
+
+*/
+typedef struct
+{
+    std::string name;
+    bool integer;
+    std::vector<int32_t> i;
+    std::vector<double> f;
+
+} cnav_column;
+
+
+/*___________________________________________________
+   CnavTable Class:
+        :msg: message type id
+        :rows: row count
+        :cols: columns in field order
+        :member functions:::::::::::::::::::::
+            -row: one row from a field visitor
+            -clear
+_____________________________________________________
+
+*/
+class CnavTable{
+
+    public:
+
+    int msg;
+    size_t rows;
+    std::vector<cnav_column> cols;
+
+    CnavTable() : msg(0), rows(0) {}
+
+    /*
+        Append a row, fields(put) calls put(name, v)
+        for each field in the same order every row,
+        the first row lays out the columns
+    */
+    template <class F>
+    void row(int prn, uint32_t tow, int wn, F fields)
+    {
+        size_t k = 0;
+        auto put = [&](const char* name, auto v){
+            bool integer = std::is_integral<decltype(v)>::value;
+            if(k == cols.size()){
+                cnav_column c;
+                c.name = name;
+                c.integer = integer;
+                cols.push_back(c);
+            }
+            if(cols[k].integer) cols[k].i.push_back((int32_t)v);
+            else cols[k].f.push_back((double)v);
+            k++;
+        };
+        put("prn", prn);
+        put("tow", tow);
+        put("wn", wn);
+        fields(put);
+        rows++;
+    }
+
+    void clear()
+    {
+        rows = 0;
+        cols.clear();
+    }
+
+};
+
+
+/*___________________________________________________
+   CnavArchive Class:
+        :table: column tables by message type id
+        :member functions:::::::::::::::::::::
+            -collect: every message of a file
+            -week_at: week of a tow
+            -add: one message
+            -write: a file per message type
+            -path: file of a message type
+_____________________________________________________
+
+*/
+class CnavArchive{
+
+    public:
+
+    CnavTable table[CNAV_TYPES];
+
+    CnavArchive()
+    {
+        for(int i = 0 ; i < CNAV_TYPES ; i++) table[i].msg = i;
+    }
+
+    /*
+        A row of message 10 takes its own week, other
+        rows the week of the message 10 nearest in
+        time, so files across a rollover keep their
+        weeks. Satellites without a 10 take the
+        session week
+    */
+    void collect(const SatelliteFile& file)
+    {
+        for(int prn = 1 ; prn <= MAXPRN ; prn++)
+        {
+            const Satellite& s = *file.satellite[prn];
+
+            std::vector<int64_t> t10;
+            std::vector<int> weeks;
+            for(const auto& m: s.m10){
+                int w = full_week(m.WN);
+                t10.push_back((int64_t)w * CNAV_TOW_WEEK + m.TOW);
+                if(std::find(weeks.begin(), weeks.end(), w) == weeks.end()) weeks.push_back(w);
+            }
+            std::sort(t10.begin(), t10.end());
+            auto wn = [&](uint32_t tow){ return week_at(t10, weeks, tow); };
+
+            for(const auto& m: s.m10) add(prn, full_week(m.WN), m);
+            for(const auto& m: s.m11) add(prn, wn(m.TOW), m);
+            for(const auto& m: s.m12) add(prn, wn(m.TOW), m);
+            for(const auto& m: s.m13) add(prn, wn(m.TOW), m);
+            for(const auto& m: s.m14) add(prn, wn(m.TOW), m);
+            for(const auto& m: s.m30) add(prn, wn(m.TOW), m);
+            for(const auto& m: s.m31) add(prn, wn(m.TOW), m);
+            for(const auto& m: s.m32) add(prn, wn(m.TOW), m);
+            for(const auto& m: s.m33) add(prn, wn(m.TOW), m);
+            for(const auto& m: s.m34) add(prn, wn(m.TOW), m);
+            for(const auto& m: s.m35) add(prn, wn(m.TOW), m);
+            for(const auto& m: s.m37) add(prn, wn(m.TOW), m);
+        }
+    }
+
+    /*
+        Tables with rows as dir/cnav_<id>.arrow
+        @return false if a file can not be written
+    */
+    bool write(const std::string& dir) const
+    {
+        bool ok = true;
+        std::vector<arrow_column> cols;
+
+        for(int id = 0 ; id < CNAV_TYPES ; id++)
+        {
+            const CnavTable& t = table[id];
+            if(t.rows == 0) continue;
+
+            cols.clear();
+            for(const auto& c: t.cols){
+                arrow_column a;
+                a.name = c.name.c_str();
+                a.type = c.integer ? ARROW_I32 : ARROW_F64;
+                a.data = c.integer ? (const void*)c.i.data() : (const void*)c.f.data();
+                cols.push_back(a);
+            }
+            ok = ArrowWriter::write(path(dir, id), cols.data(), (int)cols.size(), t.rows) && ok;
+        }
+        return ok;
+    }
+
+    /*
+        Week, out of those of the 10s and the weeks
+        around them, placing tow closest to a 10
+        @param t10: 10s as week * CNAV_TOW_WEEK + tow,
+                    sorted
+    */
+    static int week_at(const std::vector<int64_t>& t10, const std::vector<int>& weeks, uint32_t tow)
+    {
+        if(t10.empty()) return sessionweek();
+
+        int best = weeks[0];
+        int64_t gap = INT64_MAX;
+        for(int w: weeks)
+            for(int c = w - 1 ; c <= w + 1 ; c++)
+            {
+                int64_t t = (int64_t)c * CNAV_TOW_WEEK + tow;
+                auto it = std::lower_bound(t10.begin(), t10.end(), t);
+                int64_t d = INT64_MAX;
+                if(it != t10.end()) d = *it - t;
+                if(it != t10.begin() && t - *(it - 1) < d) d = t - *(it - 1);
+                if(d < gap){ gap = d; best = c; }
+            }
+        return best;
+    }
+
+    static std::string path(const std::string& dir, int msg)
+    {
+        return dir + "/cnav_" + std::to_string(msg) + ".arrow";
+    }
+
+    void add(int prn, int wn, const Msg_Type_10& m)
+    {
+        table[10].row(prn, m.TOW, wn, [&](auto f){
+            f("WN", m.WN);
+            f("top", m.top);
+            f("toe", m.toe);
+            f("URAi", m.URAi);
+            f("L1_health", m.L1_health);
+            f("L2_health", m.L2_health);
+            f("L5_health", m.L5_health);
+            f("alert", m.alert);
+            f("deltaA", m.deltaA);
+            f("Adot", m.Adot);
+            f("delntan0", m.delntan0);
+            f("deln0dot", m.deln0dot);
+            f("en", m.en);
+            f("M0n", m.M0n);
+            f("omegan", m.omegan);
+            f("integ_flag", m.integ_flag);
+            f("L2C_phasing", m.L2C_phasing);
+        });
+    }
+
+    void add(int prn, int wn, const Msg_Type_11& m)
+    {
+        table[11].row(prn, m.TOW, wn, [&](auto f){
+            f("toe", m.toe);
+            f("omega0n", m.omega0n);
+            f("i0n", m.i0n);
+            f("delomegadot", m.delomegadot);
+            f("i0nDOT", m.i0nDOT);
+            f("cisn", m.cisn);
+            f("cicn", m.cicn);
+            f("crsn", m.crsn);
+            f("crcn", m.crcn);
+            f("cusn", m.cusn);
+            f("cucn", m.cucn);
+        });
+    }
+
+    void add(int prn, int wn, const Msg_Type_12& m)
+    {
+        for(const auto& a: m.redalm)
+            table[12].row(prn, m.TOW, wn, [&](auto f){
+                f("WNan", m.WNan);
+                f("toa", m.toa);
+                almanac(f, a);
+            });
+    }
+
+    void add(int prn, int wn, const Msg_Type_13& m)
+    {
+        for(const auto& c: m.ClockDifs)
+            table[13].row(prn, m.TOW, wn, [&](auto f){
+                f("topD", m.topD);
+                f("tOD", m.tOD);
+                cdc(f, c);
+            });
+    }
+
+    void add(int prn, int wn, const Msg_Type_14& m)
+    {
+        for(const auto& e: m.ephdif_corrections)
+            table[14].row(prn, m.TOW, wn, [&](auto f){
+                f("topD", m.topD);
+                f("tOD", m.tOD);
+                edc(f, e);
+            });
+    }
+
+    void add(int prn, int wn, const Msg_Type_30& m)
+    {
+        table[30].row(prn, m.TOW, wn, [&](auto f){
+            clock(f, m.toc, m.af0, m.af1, m.af2);
+            f("top", m.top);
+            f("URANED0", m.URANED0);
+            f("URANED1", m.URANED1);
+            f("URANED2", m.URANED2);
+            f("TGD", m.TGD);
+            f("ISCL1CA", m.ISCL1CA);
+            f("ISCL2C", m.ISCL2C);
+            f("ISCL5I5", m.ISCL5I5);
+            f("ISCL5Q5", m.ISCL5Q5);
+            f("alpha0", m.alpha[0]);
+            f("alpha1", m.alpha[1]);
+            f("alpha2", m.alpha[2]);
+            f("alpha3", m.alpha[3]);
+            f("beta0", m.beta[0]);
+            f("beta1", m.beta[1]);
+            f("beta2", m.beta[2]);
+            f("beta3", m.beta[3]);
+        });
+    }
+
+    void add(int prn, int wn, const Msg_Type_31& m)
+    {
+        for(const auto& a: m.redalm)
+            table[31].row(prn, m.TOW, wn, [&](auto f){
+                clock(f, m.toc, m.af0, m.af1, m.af2);
+                f("WNan", m.WNan);
+                f("toa", m.toa);
+                almanac(f, a);
+            });
+    }
+
+    void add(int prn, int wn, const Msg_Type_32& m)
+    {
+        table[32].row(prn, m.TOW, wn, [&](auto f){
+            clock(f, m.toc, m.af0, m.af1, m.af2);
+            f("tEOP", m.tEOP);
+            f("PM_X", m.PM_X);
+            f("PM_Xdot", m.PM_Xdot);
+            f("PM_Y", m.PM_Y);
+            f("PM_Ydot", m.PM_Ydot);
+            f("deltaUTGPS", m.deltaUTGPS);
+            f("deltaUTGPSdot", m.deltaUTGPSdot);
+        });
+    }
+
+    void add(int prn, int wn, const Msg_Type_33& m)
+    {
+        table[33].row(prn, m.TOW, wn, [&](auto f){
+            clock(f, m.toc, m.af0, m.af1, m.af2);
+            f("A0", m.A0);
+            f("A1", m.A1);
+            f("A2", m.A2);
+            f("deltatLS", m.deltatLS);
+            f("tot", m.tot);
+            f("WNot", m.WNot);
+            f("WNLSF", m.WNLSF);
+            f("DN", m.DN);
+            f("deltatLSF", m.deltatLSF);
+        });
+    }
+
+    void add(int prn, int wn, const Msg_Type_34& m)
+    {
+        table[34].row(prn, m.TOW, wn, [&](auto f){
+            clock(f, m.toc, m.af0, m.af1, m.af2);
+            f("topD", m.topD);
+            f("tOD", m.tOD);
+            cdc(f, m.clockdif);
+            edc(f, m.ephdif);
+        });
+    }
+
+    void add(int prn, int wn, const Msg_Type_35& m)
+    {
+        table[35].row(prn, m.TOW, wn, [&](auto f){
+            clock(f, m.toc, m.af0, m.af1, m.af2);
+            f("tGGTO", m.tGGTO);
+            f("WNGGTO", m.WNGGTO);
+            f("GNSSID", m.GNSSID);
+            f("A0GGTO", m.A0GGTO);
+            f("A1GGTO", m.A1GGTO);
+            f("A2GGTO", m.A2GGTO);
+        });
+    }
+
+    void add(int prn, int wn, const Msg_Type_37& m)
+    {
+        table[37].row(prn, m.TOW, wn, [&](auto f){
+            clock(f, m.toc, m.af0, m.af1, m.af2);
+            f("WNan", m.WNan);
+            f("toa", m.toa);
+            f("PRNa", m.PRNa);
+            f("L1_health", m.L1_health);
+            f("L2_health", m.L2_health);
+            f("L5_health", m.L5_health);
+            f("e", m.e);
+            f("delta_i", m.delta_i);
+            f("OMEGA_DOT", m.OMEGA_DOT);
+            f("sqrtA", m.sqrtA);
+            f("OMEGA0", m.OMEGA0);
+            f("omega", m.omega);
+            f("M0", m.M0);
+            f("af0a", m.af0a);
+            f("af1a", m.af1a);
+        });
+    }
+
+    private:
+
+    /* long double clock terms are kept as double */
+    template <class F>
+    static void clock(F& f, uint32_t toc, long double af0, long double af1, long double af2)
+    {
+        f("toc", toc);
+        f("af0", (double)af0);
+        f("af1", (double)af1);
+        f("af2", (double)af2);
+    }
+
+    template <class F>
+    static void almanac(F& f, const Msg_Type_12::reduced_almanac& a)
+    {
+        f("PRNa", a.PRNa);
+        f("L1", a.L1);
+        f("L2", a.L2);
+        f("L5", a.L5);
+        f("phi_0", a.phi_0);
+        f("omega_0", a.omega_0);
+        f("sigma_A", a.sigma_A);
+    }
+
+    template <class F>
+    static void cdc(F& f, const Msg_Type_13::CDC_scaled& c)
+    {
+        f("cdc_prn", c.prn);
+        f("cdc_type", c.type);
+        f("daf0", c.daf0);
+        f("daf1", c.daf1);
+        f("UDRA", c.UDRA);
+    }
+
+    template <class F>
+    static void edc(F& f, const Msg_Type_14::EDC& e)
+    {
+        f("edc_prn", e.prn);
+        f("edc_type", e.type);
+        f("delalph", e.delalph);
+        f("delbeta", e.delbeta);
+        f("delgamm", e.delgamm);
+        f("deli", e.deli);
+        f("delomg", e.delomg);
+        f("delA", e.delA);
+        f("UDRAdot", e.UDRAdot);
+    }
+
+};
+
+
+#endif
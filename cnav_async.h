@@ -0,0 +1,492 @@
+/****************************************
+ *
+ *   CNAV async
+ *   C++20 coroutine interface to frame
+ *   and message streams, for decoders
+ *   living inside an event loop
+ *
+ *   A stream reads a nonblocking pipe,
+ *   socket or file into a byte ring and
+ *   suspends on an empty read, the loop
+ *   resumes it once epoll reports the fd
+ *   readable. Thousands of streams share
+ *   the threads running loops
+ *
+ *   Linux only, needs -std=c++20
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef CNAV_ASYNC_H
+#define CNAV_ASYNC_H
+
+#include <stdint.h>
+#include <string.h>
+#include <exception>
+#include <coroutine>
+#include <vector>
+#include <unordered_map>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+
+#include "ubx_framer.h"
+
+#define ASYNC_EVENTS  256        /* events per epoll_wait */
+#define ASYNC_BURST   64         /* frames before a stream yields */
+
+
+/*___________________________________________________
+   Task Class:
+        Lazy coroutine returning T, starts
+        when awaited and resumes its awaiter
+        when done
+_____________________________________________________
+
+*/
+template <class T>
+class Task{
+
+    public:
+
+    struct promise_type{
+
+        T value;
+        std::coroutine_handle<> caller;
+
+        Task get_return_object()
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct done{
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                std::coroutine_handle<> c = h.promise().caller;
+                return c ? c : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+
+        done final_suspend() noexcept { return {}; }
+        void return_value(T v) { value = std::move(v); }
+        void unhandled_exception() { std::terminate(); }
+
+    };
+
+    Task(Task&& t) noexcept : h(t.h) { t.h = nullptr; }
+    Task(const Task&) = delete;
+    ~Task() { if(h) h.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+    {
+        h.promise().caller = caller;
+        return h;
+    }
+
+    T await_resume() { return std::move(h.promise().value); }
+
+    private:
+
+    std::coroutine_handle<promise_type> h;
+
+    explicit Task(std::coroutine_handle<promise_type> h) : h(h) {}
+
+};
+
+
+/*___________________________________________________
+   Spawn Struct:
+        Return type of top level coroutines,
+        they run at once and free themselves
+        when done
+_____________________________________________________
+
+*/
+struct Spawn{
+
+    struct promise_type{
+
+        Spawn get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+    };
+
+};
+
+
+/*___________________________________________________
+   AsyncGenerator Class:
+        Coroutine that may co_await and
+        co_yield values of T
+        :member functions:::::::::::::::::::::
+            -next: awaitable, the next value,
+             NULL once the generator returned
+_____________________________________________________
+
+*/
+template <class T>
+class AsyncGenerator{
+
+    public:
+
+    struct promise_type{
+
+        T* current = NULL;
+        std::coroutine_handle<> consumer;
+
+        AsyncGenerator get_return_object()
+        {
+            return AsyncGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        /* back to the awaiter of next */
+        struct handoff{
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                return h.promise().consumer;
+            }
+            void await_resume() noexcept {}
+        };
+
+        handoff yield_value(T& v) noexcept { current = &v; return {}; }
+        handoff final_suspend() noexcept { current = NULL; return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+    };
+
+    AsyncGenerator(AsyncGenerator&& g) noexcept : h(g.h) { g.h = nullptr; }
+    AsyncGenerator(const AsyncGenerator&) = delete;
+    ~AsyncGenerator() { if(h) h.destroy(); }
+
+    struct next_awaiter{
+
+        std::coroutine_handle<promise_type> h;
+
+        bool await_ready() noexcept { return h.done(); }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept
+        {
+            h.promise().consumer = consumer;
+            return h;
+        }
+
+        T* await_resume() noexcept { return h.done() ? NULL : h.promise().current; }
+
+    };
+
+    next_awaiter next() { return next_awaiter{ h }; }
+
+    private:
+
+    std::coroutine_handle<promise_type> h;
+
+    explicit AsyncGenerator(std::coroutine_handle<promise_type> h) : h(h) {}
+
+};
+
+
+/*___________________________________________________
+   AsyncLoop Class:
+        Epoll loop resuming coroutines, run
+        one per thread
+        :member functions:::::::::::::::::::::
+            -readable: awaitable, resumes once
+             fd has bytes or hung up
+            -yield: awaitable, resumes after
+             the other ready coroutines
+            -run_once: one epoll wait
+            -run: until no coroutine waits
+            -forget: fd about to close, its
+             waiter is resumed on the next turn
+_____________________________________________________
+
+*/
+class AsyncLoop{
+
+    public:
+
+    AsyncLoop() : ep(epoll_create1(EPOLL_CLOEXEC)), waiting(0) {}
+    ~AsyncLoop() { ::close(ep); }
+
+    AsyncLoop(const AsyncLoop&) = delete;
+    AsyncLoop& operator=(const AsyncLoop&) = delete;
+
+    struct readable_awaiter{
+
+        AsyncLoop& loop;
+        int fd;
+
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { loop.wait(fd, h); }
+        void await_resume() noexcept {}
+
+    };
+
+    struct yield_awaiter{
+
+        AsyncLoop& loop;
+
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { loop.ready.push_back(h); }
+        void await_resume() noexcept {}
+
+    };
+
+    readable_awaiter readable(int fd) { return readable_awaiter{ *this, fd }; }
+    yield_awaiter yield() { return yield_awaiter{ *this }; }
+
+    /* @return coroutines resumed, -1 on epoll error */
+    int run_once(int timeout_ms = -1)
+    {
+        int n = 0;
+        std::vector<std::coroutine_handle<>> now;
+        now.swap(ready);
+        for(std::coroutine_handle<> h: now){ h.resume(); n++; }
+
+        if(waiting == 0) return n;
+
+        epoll_event ev[ASYNC_EVENTS];
+        int k = epoll_wait(ep, ev, ASYNC_EVENTS, ready.empty() ? timeout_ms : 0);
+        if(k < 0) return errno == EINTR ? n : -1;
+
+        for(int i = 0 ; i < k ; i++){
+            auto it = waiters.find(ev[i].data.fd);
+            if(it == waiters.end()) continue;
+            std::coroutine_handle<> h = it->second;
+            waiters.erase(it);
+            waiting--;
+            h.resume();
+            n++;
+        }
+        return n;
+    }
+
+    void run()
+    {
+        while(waiting > 0 || !ready.empty())
+            if(run_once() < 0) break;
+    }
+
+    /* before closing an fd a coroutine may still wait on */
+    void forget(int fd)
+    {
+        epoll_ctl(ep, EPOLL_CTL_DEL, fd, NULL);
+
+        auto it = waiters.find(fd);
+        if(it == waiters.end()) return;
+        ready.push_back(it->second);
+        waiters.erase(it);
+        waiting--;
+    }
+
+    private:
+
+    int ep;
+    size_t waiting;
+    std::vector<std::coroutine_handle<>> ready;
+    std::unordered_map<int, std::coroutine_handle<>> waiters;   /* by fd */
+
+    /*
+        One shot, the fd stays registered but
+        disarmed until the next wait. Regular
+        files can not be polled and are always
+        readable
+    */
+    void wait(int fd, std::coroutine_handle<> h)
+    {
+        epoll_event ev;
+        memset(&ev, 0, sizeof ev);
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        ev.data.fd = fd;
+
+        if(epoll_ctl(ep, EPOLL_CTL_MOD, fd, &ev) == 0
+           || (errno == ENOENT && epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) == 0)){
+            waiters[fd] = h;
+            waiting++;
+            return;
+        }
+        ready.push_back(h);
+    }
+
+};
+
+
+/* latest message of a stream, sat holds its decoded form */
+typedef struct{
+
+    int prn;
+    int id;
+    bool stored;           /* completed an upload */
+    uint32_t words[10];
+    const Satellite* sat;
+
+} cnav_message;
+
+
+/*___________________________________________________
+   AsyncStream Class:
+        UBX stream over a nonblocking fd,
+        decoded into its own SatelliteFile
+        :file: decoded messages and uploads,
+               sink, caster and shm as set,
+               the latest STREAM_RETAIN messages
+               of each type are kept
+        :bytes: bytes read
+        :member functions:::::::::::::::::::::
+            -open: nonblocking fd of a file or
+             fifo, -1 on failure
+            -next_frame: awaitable, next gps
+             l2 subframe, false at the end
+            -next_message: awaitable, next
+             frame decoded into file, frames
+             failing the crc are passed over
+            -messages: generator of the
+             decoded messages
+            -close: a reader waiting on the fd
+             ends as at end of stream, the
+             stream must outlive its readers
+_____________________________________________________
+
+*/
+class AsyncStream{
+
+    public:
+
+    SatelliteFile file;
+    UbxFramer framer;
+    size_t bytes;
+
+    AsyncStream(AsyncLoop& loop, int fd, size_t ring_bytes = RING_BYTES)
+        : bytes(0), loop(loop), fd(fd), burst(0),
+          ring(ring_bytes < 2 * (UBX_HEAD + UBX_MAXLEN + 2) ? 2 * (UBX_HEAD + UBX_MAXLEN + 2) : ring_bytes)
+    {
+        file.retain = STREAM_RETAIN;
+        if(fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    ~AsyncStream() { close(); }
+
+    AsyncStream(const AsyncStream&) = delete;
+    AsyncStream& operator=(const AsyncStream&) = delete;
+
+    static int open(const char* path)
+    {
+        return ::open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    }
+
+    /*
+        Every ASYNC_BURST frames the stream goes back to
+        the loop, a busy stream can not starve the others
+        and ready frames do not nest resumes without end
+        where tail calls are off, -O0 and sanitizers
+    */
+    Task<bool> next_frame(frame_view& v)
+    {
+        for(;;)
+        {
+            size_t len;
+            while(framer.next(ring, frame, len))
+                if(UbxFramer::view(frame, len, v)){
+                    framer.frames++;
+                    if(++burst >= ASYNC_BURST){
+                        burst = 0;
+                        co_await loop.yield();
+                    }
+                    co_return true;
+                }
+            if(!co_await fill()) co_return false;
+        }
+    }
+
+    Task<bool> next_message(cnav_message& m)
+    {
+        frame_view v;
+        while(co_await next_frame(v))
+        {
+            m.prn = v.head.svId;
+            m.stored = file.decode_frame(v.head, v.words);
+            m.sat = file.satellite[m.prn];
+            m.id = m.sat->last_msg;
+            memcpy(m.words, v.words, sizeof m.words);
+            if(m.id) co_return true;
+        }
+        co_return false;
+    }
+
+    AsyncGenerator<cnav_message> messages()
+    {
+        cnav_message m;
+        while(co_await next_message(m)) co_yield m;
+    }
+
+    void close()
+    {
+        if(fd < 0) return;
+        loop.forget(fd);
+        ::close(fd);
+        fd = -1;
+    }
+
+    private:
+
+    AsyncLoop& loop;
+    int fd;
+    int burst;
+    ByteRing ring;
+    uint8_t frame[UBX_HEAD + UBX_MAXLEN + 2];
+
+    /*
+        One readv into the ring, suspends while the
+        fd is empty
+        @return false at end of stream or on error
+    */
+    Task<bool> fill()
+    {
+        for(;;)
+        {
+            if(fd < 0) co_return false;
+
+            uint8_t* p[2];
+            size_t len[2];
+            int blocks = ring.spans(p, len);
+
+            iovec iov[2];
+            for(int i = 0 ; i < blocks ; i++){ iov[i].iov_base = p[i]; iov[i].iov_len = len[i]; }
+
+            ssize_t k = readv(fd, iov, blocks);
+            if(k > 0){
+                ring.commit((size_t)k);
+                bytes += (size_t)k;
+                co_return true;
+            }
+            if(k == 0) co_return false;
+            if(errno == EINTR) continue;
+            if(errno != EAGAIN) co_return false;
+
+            burst = 0;
+            co_await loop.readable(fd);
+        }
+    }
+
+};
+
+
+#endif
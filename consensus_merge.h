@@ -0,0 +1,351 @@
+/****************************************
+ *
+ *   Consensus merge
+ *   Fan-in of the receivers decoding the
+ *   same PRNs, copies of a message are
+ *   voted on by payload hash and uploads
+ *   field by field into one ephemeris per
+ *   PRN and toe
+ *
+ *   A field corrupted in one receiver but
+ *   passing the crc loses to the copies of
+ *   the others, downstream reads the
+ *   consensus store once instead of every
+ *   receiver's store. Votes are on the
+ *   broadcast uploads, the dc packets that
+ *   win their vote correct the consensus
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef CONSENSUS_MERGE_H
+#define CONSENSUS_MERGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+#include "gps_l2_satellite.h"
+#include "ephemeris_store.h"
+#include "dc_corrections.h"
+
+#define MERGE_RECEIVERS 64       /* receivers of one merge, bits of a mask */
+#define MERGE_WINDOW    8192     /* message keys remembered */
+#define MERGE_TOES      4        /* ballots kept per PRN */
+
+#define EPH_FIELD(f)  { offsetof(eph, f), sizeof(((eph*)0)->f) }
+
+
+/* fields voted on, padding of eph is left out */
+typedef struct{
+
+    size_t at;
+    size_t size;
+
+} eph_field;
+
+static const eph_field eph_fields[] = {
+    EPH_FIELD(clock_bias),   EPH_FIELD(clock_drift), EPH_FIELD(clock_rate),
+    EPH_FIELD(IODE),         EPH_FIELD(Crs),         EPH_FIELD(delta_n),
+    EPH_FIELD(M0),           EPH_FIELD(Cuc),         EPH_FIELD(eccentricity),
+    EPH_FIELD(Cus),          EPH_FIELD(sqrtA),       EPH_FIELD(TOE),
+    EPH_FIELD(Cic),          EPH_FIELD(OMEGA),       EPH_FIELD(Cis),
+    EPH_FIELD(I0),           EPH_FIELD(Crc),         EPH_FIELD(omega),
+    EPH_FIELD(OMEGA_DOT),    EPH_FIELD(IDOT),        EPH_FIELD(l2_codes),
+    EPH_FIELD(week),         EPH_FIELD(l2_p_flag),   EPH_FIELD(sv_acc),
+    EPH_FIELD(sv_health),    EPH_FIELD(tgd),         EPH_FIELD(IODC),
+    EPH_FIELD(trans_time),   EPH_FIELD(fit_interval), EPH_FIELD(Adot),
+    EPH_FIELD(delta_n_dot),  EPH_FIELD(toc)
+};
+
+#define EPH_FIELDS (sizeof(eph_fields) / sizeof(eph_fields[0]))
+
+
+/* fnv-1a over n bytes, seeded by h */
+static inline uint64_t fnv1a(const void* p, size_t n, uint64_t h = 14695981039346656037ULL)
+{
+    const uint8_t* b = (const uint8_t*)p;
+    for(size_t i = 0 ; i < n ; i++){ h ^= b[i]; h *= 1099511628211ULL; }
+    return h;
+}
+
+static inline uint64_t eph_hash(const eph& e)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for(size_t i = 0 ; i < EPH_FIELDS ; i++)
+        h = fnv1a((const uint8_t*)&e + eph_fields[i].at, eph_fields[i].size, h);
+    return h;
+}
+
+
+/*___________________________________________________
+   ConsensusMerge Class:
+        :ephemerides: consensus uploads, one per
+                      PRN and toe
+        :corrections: cdc/edc of the consensus
+                      messages 13, 14 and 34,
+                      applied to ephemerides
+        :quorum: votes before a message or an
+                 upload is published, 1 passes
+                 the first copy
+        :unique: messages passed on
+        :duplicates: copies of a payload already
+                     voted for or passed on
+        :conflicts: copies differing from another
+                    copy of their PRN, type and tow
+        :member functions:::::::::::::::::::::
+            -message: vote of a receiver on the
+             latest message of a satellite
+            -collect: votes of the broadcast
+             uploads a receiver's store gained
+            -vote: one receiver's upload
+_____________________________________________________
+
+*/
+class ConsensusMerge{
+
+    public:
+
+    EphemerisStore ephemerides;
+    DcCorrections corrections;
+    int quorum;
+    size_t unique;
+    size_t duplicates;
+    size_t conflicts;
+
+    explicit ConsensusMerge(int quorum = 2)
+        : corrections(ephemerides), quorum(quorum), unique(0), duplicates(0),
+          conflicts(0), next(0)
+    {
+        memset(sent, 0, sizeof sent);
+        window.resize(MERGE_WINDOW, 0);
+    }
+
+    /*
+        A receiver has one vote per PRN, type and tow,
+        a copy with another payload moves it. The
+        message is passed on once a payload has quorum
+        votes and leads every other, whichever copy
+        came first. A dc message passed on corrects
+        the consensus store
+        @param s: satellite whose last_msg was just
+                  decoded
+        @return true when this copy made its payload
+                the consensus, s holds what to pass on
+    */
+    bool message(int receiver, int prn, const Satellite& s)
+    {
+        if(s.last_msg == 0 || receiver < 0 || receiver >= MERGE_RECEIVERS) return false;
+
+        uint64_t tow = concatbin(s.words[0] & 0xFFF, s.words[1] >> 27, 5);
+        uint64_t key = (uint64_t)prn << 40 | (uint64_t)s.last_msg << 32 | tow;
+        uint64_t hash = fnv1a(s.words, sizeof s.words, key);
+        uint64_t bit = 1ULL << receiver;
+
+        auto it = tallies.find(key);
+        if(it == tallies.end()){
+            remember(key);
+            it = tallies.emplace(key, tally()).first;
+        }
+        tally& t = it->second;
+
+        copy* c = NULL;
+        for(copy& k: t.c) if(k.hash == hash) c = &k;
+        if(c && (c->voters & bit || t.sent)){ duplicates++; return false; }
+        if(c == NULL){
+            if(!t.c.empty()) conflicts++;
+            t.c.push_back(copy{ hash, 0, 0 });
+            c = &t.c.back();
+        }
+
+        for(copy& k: t.c)
+            if(&k != c && k.voters & bit){ k.voters &= ~bit; k.votes--; }
+        c->voters |= bit;
+        c->votes++;
+
+        if(t.sent || c->votes < quorum) return false;
+        for(const copy& k: t.c)
+            if(&k != c && k.votes >= c->votes) return false;
+
+        t.sent = true;
+        unique++;
+        switch(s.last_msg)
+        {
+            case 13: corrections.update(s.m13.back()); break;
+            case 14: corrections.update(s.m14.back()); break;
+            case 34: corrections.update(s.m34.back()); break;
+        }
+        return true;
+    }
+
+    /*
+        Broadcast upload a satellite of file last put
+        in its store, for PRNs whose generation moved
+        since the last call. The store entry itself
+        may carry the receiver's dc corrections, which
+        differ with the packets each one has seen
+    */
+    void collect(int receiver, const SatelliteFile& file)
+    {
+        if(receiver < 0 || receiver >= MERGE_RECEIVERS) return;
+
+        for(int prn = 1 ; prn <= MAXPRN ; prn++)
+        {
+            uint32_t g = file.ephemerides.generation(prn);
+            const Satellite& s = *file.satellite[prn];
+            if(g == sent[receiver][prn] || !s.eph_completed) continue;
+            sent[receiver][prn] = g;
+            vote(receiver, prn, s.eph_mssg);
+        }
+    }
+
+    /*
+        A receiver has one vote per PRN and toe, a
+        later upload of the same toe moves it. The
+        upload is published once every field has a
+        value with quorum votes leading every other
+    */
+    void vote(int receiver, int prn, const eph& e)
+    {
+        if(receiver < 0 || receiver >= MERGE_RECEIVERS || prn < 1 || prn > MAXPRN) return;
+
+        uint64_t bit = 1ULL << receiver;
+        double key = e.week * 604800.0 + e.TOE;
+        ballot& b = ballots[prn][key];
+
+        uint64_t h = eph_hash(e);
+        for(size_t i = 0 ; i < b.c.size() ; )
+        {
+            if(b.c[i].voters & bit && b.c[i].hash != h){
+                b.c[i].voters &= ~bit;
+                b.c[i].votes--;
+                if(b.c[i].votes == 0){ b.c.erase(b.c.begin() + i); continue; }
+            }
+            i++;
+        }
+
+        candidate* c = NULL;
+        for(candidate& k: b.c) if(k.hash == h) c = &k;
+        if(c == NULL){
+            b.c.push_back(candidate{ h, e, 0, 0 });
+            c = &b.c.back();
+        }
+        if(!(c->voters & bit)){ c->voters |= bit; c->votes++; }
+
+        eph merged;
+        if(consensus(b, quorum, merged))
+        {
+            uint64_t mh = eph_hash(merged);
+            if(!b.published || mh != b.hash){
+                ephemerides.insert(prn, merged);
+                corrections.apply(prn);
+                b.published = true;
+                b.hash = mh;
+            }
+        }
+
+        while(ballots[prn].size() > MERGE_TOES) ballots[prn].erase(ballots[prn].begin());
+    }
+
+    private:
+
+    typedef struct{
+
+        uint64_t hash;
+        eph e;
+        uint64_t voters;       /* receiver bits */
+        int votes;
+
+    } candidate;
+
+    struct ballot{
+
+        std::vector<candidate> c;
+        bool published = false;
+        uint64_t hash = 0;     /* of the published consensus */
+
+    };
+
+    typedef struct{
+
+        uint64_t hash;         /* of the words */
+        uint64_t voters;       /* receiver bits */
+        int votes;
+
+    } copy;
+
+    struct tally{
+
+        std::vector<copy> c;
+        bool sent = false;     /* a payload was passed on */
+
+    };
+
+    std::map<double, ballot> ballots[MAXPRN + 1];   /* by full toe seconds */
+    std::unordered_map<uint64_t, tally> tallies;    /* by message key */
+    std::vector<uint64_t> window;                   /* keys, oldest at next */
+    size_t next;
+    uint32_t sent[MERGE_RECEIVERS][MAXPRN + 1];
+
+    /* keep the tallies of the last MERGE_WINDOW keys */
+    void remember(uint64_t key)
+    {
+        if(window[next] != 0) tallies.erase(window[next]);
+        window[next] = key;
+        next = (next + 1) % MERGE_WINDOW;
+    }
+
+    /* votes of the candidates sharing field [at, at + n) with candidate i */
+    static int weight(const ballot& b, size_t i, size_t at, size_t n)
+    {
+        const uint8_t* v = (const uint8_t*)&b.c[i].e + at;
+        int w = 0;
+        for(const candidate& k: b.c)
+            if(memcmp((const uint8_t*)&k.e + at, v, n) == 0) w += k.votes;
+        return w;
+    }
+
+    /*
+        Each field takes the value with the most votes
+        over the candidates. As for a message, that
+        value needs quorum votes and more than any
+        other value, a tie holds the ballot
+        @return false if a field has no such value
+    */
+    static bool consensus(const ballot& b, int quorum, eph& out)
+    {
+        if(b.c.empty()) return false;
+        out = b.c[0].e;
+
+        for(size_t f = 0 ; f < EPH_FIELDS ; f++)
+        {
+            size_t at = eph_fields[f].at, n = eph_fields[f].size;
+            int best = 0;
+            size_t pick = 0;
+            for(size_t i = 0 ; i < b.c.size() ; i++)
+            {
+                int w = weight(b, i, at, n);
+                if(w > best){ best = w; pick = i; }
+            }
+            if(best < quorum) return false;
+
+            const uint8_t* v = (const uint8_t*)&b.c[pick].e + at;
+            for(size_t i = 0 ; i < b.c.size() ; i++)
+                if(memcmp((const uint8_t*)&b.c[i].e + at, v, n) != 0 && weight(b, i, at, n) >= best)
+                    return false;
+
+            memcpy((uint8_t*)&out + at, v, n);
+        }
+        return true;
+    }
+
+};
+
+
+#endif
@@ -0,0 +1,185 @@
+/****************************************
+ *
+ *   Differential corrections
+ *   Clock (CDC) and ephemeris (EDC)
+ *   differential corrections of message
+ *   13, 14 and 34 applied to the latest
+ *   upload of the corrected PRN
+ *   IS-GPS-200 30.3.3.7
+ *
+ *   A packet only rewrites the store
+ *   entry of its own PRN, so orbit
+ *   engines refit that PRN alone
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef DC_CORRECTIONS_H
+#define DC_CORRECTIONS_H
+
+#include <stdint.h>
+#include <cmath>
+
+#include "gps_l2_message_types.hpp"
+#include "ephemeris_store.h"
+
+#define DC_TYPE_CNAV  0          /* dc data type of cnav ephemeris */
+
+
+/*___________________________________________________
+   DcCorrections Class:
+        :store: ephemerides being corrected
+        :member functions:::::::::::::::::::::
+            -update: take a decoded message 13,
+             14 or 34, corrects the packet PRNs
+            -apply: correct PRN's latest upload
+             again, after a new one is stored
+            -corrected: has PRN a correction
+_____________________________________________________
+
+*/
+class DcCorrections{
+
+    public:
+
+    explicit DcCorrections(EphemerisStore& eph_store) : store(eph_store)
+    {
+        for(int i = 0 ; i <= MAXPRN ; i++) sat[i] = state();
+    }
+
+    void update(const Msg_Type_13& m)
+    {
+        for(const auto& c: m.ClockDifs)
+            if(clock(c, m.tOD)) apply(c.prn);
+    }
+
+    void update(const Msg_Type_14& m)
+    {
+        for(const auto& e: m.ephdif_corrections)
+            if(orbit(e)) apply(e.prn);
+    }
+
+    void update(const Msg_Type_34& m)
+    {
+        /* one rewrite when both packets are for the same PRN */
+        bool c = clock(m.clockdif, m.tOD);
+        bool e = orbit(m.ephdif);
+        if(c) apply(m.clockdif.prn);
+        if(e && (!c || m.ephdif.prn != m.clockdif.prn)) apply(m.ephdif.prn);
+    }
+
+    /*
+        Rewrite the latest upload of PRN from its
+        broadcast values and the latest packets
+        @return false if nothing to correct
+    */
+    bool apply(int prn)
+    {
+        if(prn < 1 || prn > MAXPRN) return false;
+
+        state& s = sat[prn];
+        const std::vector<eph>& ephs = store.ephemerides(prn);
+        if(ephs.empty() || !(s.has_cdc || s.has_edc)) return false;
+
+        /* anything but what was written last is a new broadcast upload */
+        size_t index = ephs.size() - 1;
+        if(!s.has_raw || !same(ephs[index], s.out)){
+            s.raw = ephs[index];
+            s.has_raw = true;
+        }
+
+        s.out = s.raw;
+        if(s.has_cdc) correct_clock(s.out, s.cdc, s.cdc_tod);
+        if(s.has_edc) correct_orbit(s.out, s.edc);
+
+        store.replace(prn, index, s.out);
+        return true;
+    }
+
+    bool corrected(int prn) const
+    {
+        return prn >= 1 && prn <= MAXPRN && (sat[prn].has_cdc || sat[prn].has_edc);
+    }
+
+    private:
+
+    /* latest packets and the upload they were applied to */
+    struct state
+    {
+        bool has_cdc = false;
+        bool has_edc = false;
+        bool has_raw = false;
+        Msg_Type_13::CDC_scaled cdc;
+        Msg_Type_14::EDC edc;
+        double cdc_tod = 0;
+        eph raw;
+        eph out;
+    };
+
+    EphemerisStore& store;
+    state sat[MAXPRN + 1];
+
+    /* keep a packet, false if it is not for a cnav PRN */
+    bool clock(const Msg_Type_13::CDC_scaled& c, uint32_t tod)
+    {
+        if(c.type != DC_TYPE_CNAV || c.prn < 1 || c.prn > MAXPRN) return false;
+
+        state& s = sat[c.prn];
+        s.cdc = c;
+        s.cdc_tod = tod;
+        s.has_cdc = true;
+        return true;
+    }
+
+    bool orbit(const Msg_Type_14::EDC& e)
+    {
+        if(e.type != DC_TYPE_CNAV || e.prn < 1 || e.prn > MAXPRN) return false;
+
+        state& s = sat[e.prn];
+        s.edc = e;
+        s.has_edc = true;
+        return true;
+    }
+
+    /* da0 + da1 (t - tOD) folded into the polynomial about toc */
+    static void correct_clock(eph& e, const Msg_Type_13::CDC_scaled& c, double tod)
+    {
+        double dt = e.toc - tod;
+        if(dt > 302400) dt -= 604800;
+        else if(dt < -302400) dt += 604800;
+
+        e.clock_bias += c.daf0 + c.daf1 * dt;
+        e.clock_drift += c.daf1;
+    }
+
+    /*
+        alpha = e cos(w), beta = e sin(w), gamma = M0 + w
+        are corrected, then split back into e, w, M0
+    */
+    static void correct_orbit(eph& e, const Msg_Type_14::EDC& d)
+    {
+        double alpha = e.eccentricity * cos(e.omega) + d.delalph;
+        double beta = e.eccentricity * sin(e.omega) + d.delbeta;
+        double gamma = e.M0 + e.omega + d.delgamm * PI;
+
+        e.eccentricity = sqrt(alpha * alpha + beta * beta);
+        e.omega = atan2(beta, alpha);
+        e.M0 = gamma - e.omega;
+        e.I0 += d.deli * PI;
+        e.OMEGA += d.delomg * PI;
+        e.sqrtA = sqrt(e.sqrtA * e.sqrtA + d.delA);
+    }
+
+    static bool same(const eph& a, const eph& b)
+    {
+        return a.TOE == b.TOE && a.week == b.week && a.clock_bias == b.clock_bias
+            && a.M0 == b.M0 && a.eccentricity == b.eccentricity && a.sqrtA == b.sqrtA;
+    }
+
+};
+
+
+#endif
\ No newline at end of file
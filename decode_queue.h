@@ -0,0 +1,285 @@
+/****************************************
+ *
+ *   Decode queue
+ *   Framed subframes waiting for decode,
+ *   one bounded queue per priority class
+ *
+ *   Ephemeris and clock messages go
+ *   first, dc corrections next, almanac
+ *   and text last. Within a class every
+ *   stream has its own lane and lanes
+ *   are served in turn. When a receiver
+ *   dumps its buffer the lower classes
+ *   are shed as set by the policy and a
+ *   full class sheds from its longest
+ *   lane, a fresh upload of another
+ *   stream waits one turn of each busy
+ *   stream whatever the backlog
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef DECODE_QUEUE_H
+#define DECODE_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <unordered_map>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+#include "ubx_framer.h"
+
+#define PRIO_CLASSES  3
+
+enum { PRIO_HIGH, PRIO_MEDIUM, PRIO_LOW };
+enum { SHED_NEWEST, SHED_OLDEST };
+
+
+/* class of a message id, ids not listed are medium */
+static inline int msg_class(int id)
+{
+    switch(id)
+    {
+        case 10: case 11: case 30:
+            return PRIO_HIGH;
+        case 12: case 15: case 31: case 36: case 37:
+            return PRIO_LOW;
+        default:
+            return PRIO_MEDIUM;
+    }
+}
+
+
+/*___________________________________________________
+   shed_policy Struct:
+        :depth: slots of each class
+        :full: SHED_NEWEST drops the arrival,
+               SHED_OLDEST the head of the
+               longest lane of a full class
+        :shed_above: share of all slots in use
+                     above which arrivals of the
+                     class are shed, 1 for never
+        :budget: frames decoded per drain
+_____________________________________________________
+
+*/
+typedef struct{
+
+    size_t depth[PRIO_CLASSES];
+    int full[PRIO_CLASSES];
+    double shed_above[PRIO_CLASSES];
+    size_t budget;
+
+} shed_policy;
+
+/* stale uploads give way to fresh ones, low classes shed first */
+static const shed_policy default_shed = {
+    { 4096, 4096, 4096 },
+    { SHED_OLDEST, SHED_OLDEST, SHED_NEWEST },
+    { 1.0, 0.9, 0.5 },
+    1024
+};
+
+
+/*___________________________________________________
+   DecodeQueue Class:
+        Single threaded, frames of Owner
+        streams in strict priority order,
+        round robin over the streams of a
+        class
+        :queued, decoded: frames of each class
+        :shed_full: dropped, class queue full
+        :shed_load: dropped, queue above the
+                    class's shed_above share
+        :max_wait: seconds, longest a frame of
+                   each class waited
+        :member functions:::::::::::::::::::::
+            -push: frame of a stream, false if
+             it was shed
+            -pop: oldest frame of the next
+             stream of the highest class
+             waiting
+            -waiting: frames of a stream
+            -purge: drops the frames of a
+             stream
+            -report: counters by class
+_____________________________________________________
+
+*/
+template <class Owner>
+class DecodeQueue{
+
+    public:
+
+    shed_policy policy;
+    size_t queued[PRIO_CLASSES];
+    size_t decoded[PRIO_CLASSES];
+    size_t shed_full[PRIO_CLASSES];
+    size_t shed_load[PRIO_CLASSES];
+    double max_wait[PRIO_CLASSES];
+
+    explicit DecodeQueue(const shed_policy& p = default_shed) : policy(p), total(0), slots(0)
+    {
+        for(int c = 0 ; c < PRIO_CLASSES ; c++){
+            if(policy.depth[c] == 0) policy.depth[c] = 1;
+            slots += policy.depth[c];
+            q[c].count = 0;
+            queued[c] = decoded[c] = shed_full[c] = shed_load[c] = 0;
+            max_wait[c] = 0;
+        }
+    }
+
+    size_t size() const { return total; }
+    bool empty() const { return total == 0; }
+    size_t size(int c) const { return q[c].count; }
+
+    /* frames of one stream */
+    size_t waiting(const Owner* owner) const
+    {
+        size_t n = 0;
+        for(int c = 0 ; c < PRIO_CLASSES ; c++){
+            auto it = q[c].lanes.find((Owner*)owner);
+            if(it != q[c].lanes.end()) n += it->second.size();
+        }
+        return n;
+    }
+
+    bool push(Owner* owner, const frame_view& v)
+    {
+        common C;
+        C.word = v.words[0];
+        int c = msg_class(C.msgTypeId);
+        klass& k = q[c];
+
+        if(policy.shed_above[c] < 1 && (double)(total + 1) > policy.shed_above[c] * slots){
+            shed_load[c]++;
+            return false;
+        }
+        if(k.count == policy.depth[c]){
+            shed_full[c]++;
+            if(policy.full[c] == SHED_NEWEST) return false;
+            shed(k, owner);
+        }
+
+        std::deque<item>& lane = k.lanes[owner];
+        if(lane.empty()) k.turn.push_back(owner);
+        lane.push_back(item{ v, std::chrono::steady_clock::now() });
+        k.count++;
+        total++;
+        queued[c]++;
+        return true;
+    }
+
+    bool pop(Owner*& owner, frame_view& v)
+    {
+        for(int c = 0 ; c < PRIO_CLASSES ; c++)
+        {
+            klass& k = q[c];
+            if(k.count == 0) continue;
+
+            owner = k.turn.front();
+            k.turn.pop_front();
+            std::deque<item>& lane = k.lanes[owner];
+
+            v = lane.front().v;
+            double w = std::chrono::duration<double>(std::chrono::steady_clock::now() - lane.front().t).count();
+            if(w > max_wait[c]) max_wait[c] = w;
+
+            lane.pop_front();
+            if(lane.empty()) k.lanes.erase(owner);
+            else k.turn.push_back(owner);
+
+            k.count--;
+            total--;
+            decoded[c]++;
+            return true;
+        }
+        return false;
+    }
+
+    void purge(const Owner* owner)
+    {
+        for(int c = 0 ; c < PRIO_CLASSES ; c++)
+        {
+            klass& k = q[c];
+            auto it = k.lanes.find((Owner*)owner);
+            if(it == k.lanes.end()) continue;
+
+            k.count -= it->second.size();
+            total -= it->second.size();
+            k.lanes.erase(it);
+            for(auto t = k.turn.begin() ; t != k.turn.end() ; t++)
+                if(*t == owner){ k.turn.erase(t); break; }
+        }
+    }
+
+    void report(std::ostream& os) const
+    {
+        static const char* names[PRIO_CLASSES] = { "high", "medium", "low" };
+
+        os << std::fixed << std::setprecision(3);
+        for(int c = 0 ; c < PRIO_CLASSES ; c++)
+            os << std::setw(8) << names[c] << "  queued " << std::setw(10) << queued[c]
+               << "  decoded " << std::setw(10) << decoded[c]
+               << "  shed full " << std::setw(8) << shed_full[c]
+               << "  shed load " << std::setw(8) << shed_load[c]
+               << "  max wait " << 1000.0 * max_wait[c] << " ms" << std::endl;
+    }
+
+    private:
+
+    typedef struct{
+
+        frame_view v;
+        std::chrono::steady_clock::time_point t;
+
+    } item;
+
+    struct klass{
+
+        std::unordered_map<Owner*, std::deque<item>> lanes;
+        std::deque<Owner*> turn;       /* streams with frames, next first */
+        size_t count;
+
+    };
+
+    klass q[PRIO_CLASSES];
+    size_t total;
+    size_t slots;
+
+    /*
+        Oldest frame of the arriving stream while its
+        lane is at least a fair share, otherwise of
+        the longest lane
+    */
+    void shed(klass& k, Owner* owner)
+    {
+        auto it = k.lanes.find(owner);
+        if(it == k.lanes.end() || it->second.size() * k.lanes.size() < k.count)
+        {
+            it = k.lanes.begin();
+            for(auto l = k.lanes.begin() ; l != k.lanes.end() ; l++)
+                if(l->second.size() > it->second.size()) it = l;
+        }
+
+        it->second.pop_front();
+        k.count--;
+        total--;
+        if(it->second.empty()){
+            Owner* o = it->first;
+            k.lanes.erase(it);
+            for(auto t = k.turn.begin() ; t != k.turn.end() ; t++)
+                if(*t == o){ k.turn.erase(t); break; }
+        }
+    }
+
+};
+
+
+#endif
@@ -0,0 +1,161 @@
+/****************************************
+ *
+ *   Decode queue test
+ *   Priority order, round robin over
+ *   streams, shedding and purge
+ *
+ *   g++ -std=c++20 -O2 -I. decode_queue_test.cpp -o decode_queue_test
+ *   ./decode_queue_test
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "gps_l2_cnav_decode.h"
+#include "decode_queue.h"
+
+typedef struct{ int id; } stream;
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if(ok) return;
+    std::cerr << "FAIL " << what << std::endl;
+    failures++;
+}
+
+/* frame of message id, seq in its second word */
+static frame_view frame(int id, uint32_t seq)
+{
+    frame_view v;
+    memset(&v, 0, sizeof v);
+    v.words[0] = 0x8Bu << 24 | 1u << 18 | (uint32_t)id << 12;
+    v.words[1] = seq;
+    return v;
+}
+
+/* stream and seq of every frame popped */
+static std::vector<std::pair<int, uint32_t>> drain(DecodeQueue<stream>& q)
+{
+    std::vector<std::pair<int, uint32_t>> out;
+    stream* s;
+    frame_view v;
+    while(q.pop(s, v)) out.push_back({ s->id, v.words[1] });
+    return out;
+}
+
+static shed_policy policy(size_t depth, int full_low, double low_above)
+{
+    shed_policy p = default_shed;
+    for(int c = 0 ; c < PRIO_CLASSES ; c++) p.depth[c] = depth;
+    p.full[PRIO_LOW] = full_low;
+    p.shed_above[PRIO_LOW] = low_above;
+    return p;
+}
+
+
+/* strict class order, streams in turn, fifo within a stream */
+static void ordering()
+{
+    stream a{ 1 }, b{ 2 };
+    DecodeQueue<stream> q;
+
+    q.push(&a, frame(37, 1));      /* low */
+    q.push(&a, frame(13, 2));      /* medium */
+    q.push(&a, frame(10, 3));      /* high */
+    q.push(&a, frame(11, 4));
+    q.push(&a, frame(30, 5));
+    q.push(&b, frame(12, 6));      /* low */
+    q.push(&b, frame(10, 7));      /* high */
+    q.push(&b, frame(99, 8));      /* not listed, medium */
+
+    check(q.size() == 8 && q.size(PRIO_HIGH) == 4 && q.size(PRIO_MEDIUM) == 2 && q.size(PRIO_LOW) == 2,
+          "ordering: class sizes");
+    check(q.waiting(&a) == 5 && q.waiting(&b) == 3, "ordering: waiting");
+
+    std::vector<std::pair<int, uint32_t>> want = {
+        { 1, 3 }, { 2, 7 }, { 1, 4 }, { 1, 5 },
+        { 1, 2 }, { 2, 8 },
+        { 1, 1 }, { 2, 6 }
+    };
+    check(drain(q) == want, "ordering: pop order");
+    check(q.empty() && q.decoded[PRIO_HIGH] == 4 && q.decoded[PRIO_LOW] == 2, "ordering: counters");
+}
+
+/* a full class sheds the arrival or the oldest of its longest lane */
+static void shed_full()
+{
+    stream a{ 1 }, b{ 2 };
+    DecodeQueue<stream> q(policy(4, SHED_NEWEST, 1.0));
+
+    for(uint32_t i = 1 ; i <= 4 ; i++) check(q.push(&a, frame(31, i)), "shed full: low accepted");
+    check(!q.push(&b, frame(31, 5)), "shed full: newest low shed");
+    check(q.shed_full[PRIO_LOW] == 1 && q.size(PRIO_LOW) == 4 && q.waiting(&b) == 0, "shed full: low kept");
+
+    for(uint32_t i = 11 ; i <= 14 ; i++) q.push(&a, frame(10, i));
+    check(q.push(&b, frame(10, 15)), "shed full: fresh upload accepted");
+    check(q.shed_full[PRIO_HIGH] == 1 && q.size(PRIO_HIGH) == 4, "shed full: high depth held");
+
+    /* the busy stream lost its oldest, the fresh one waits one turn */
+    std::vector<std::pair<int, uint32_t>> want = {
+        { 1, 12 }, { 2, 15 }, { 1, 13 }, { 1, 14 },
+        { 1, 1 }, { 1, 2 }, { 1, 3 }, { 1, 4 }
+    };
+    check(drain(q) == want, "shed full: pop order");
+}
+
+/* above its share of all slots a class sheds arrivals */
+static void shed_load()
+{
+    stream a{ 1 };
+    DecodeQueue<stream> q(policy(16, SHED_NEWEST, 0.5));
+
+    for(uint32_t i = 0 ; i < 16 ; i++) q.push(&a, frame(10, i));
+    for(uint32_t i = 16 ; i < 24 ; i++) q.push(&a, frame(13, i));
+    check(!q.push(&a, frame(37, 100)), "shed load: low shed at half");
+    check(q.shed_load[PRIO_LOW] == 1 && q.size(PRIO_LOW) == 0, "shed load: counted");
+    check(q.push(&a, frame(14, 101)), "shed load: medium below its share");
+    check(q.push(&a, frame(11, 102)), "shed load: high never shed by load");
+    check(q.shed_load[PRIO_HIGH] == 0 && q.shed_full[PRIO_HIGH] == 1 && q.size() == 25, "shed load: size");
+}
+
+/* purge drops one stream, the others keep their order */
+static void purge()
+{
+    stream a{ 1 }, b{ 2 }, c{ 3 };
+    DecodeQueue<stream> q;
+
+    for(uint32_t i = 0 ; i < 3 ; i++){
+        q.push(&a, frame(10, 10 + i));
+        q.push(&b, frame(10, 20 + i));
+        q.push(&c, frame(12, 30 + i));
+    }
+    q.purge(&b);
+    check(q.waiting(&b) == 0 && q.size() == 6, "purge: frames of stream dropped");
+
+    std::vector<std::pair<int, uint32_t>> want = {
+        { 1, 10 }, { 1, 11 }, { 1, 12 },
+        { 3, 30 }, { 3, 31 }, { 3, 32 }
+    };
+    check(drain(q) == want, "purge: pop order");
+    check(q.empty(), "purge: empty");
+}
+
+
+int main()
+{
+    ordering();
+    shed_full();
+    shed_load();
+    purge();
+
+    std::cout << (failures ? "decode queue test failed" : "decode queue test passed") << std::endl;
+    return failures ? 1 : 0;
+}
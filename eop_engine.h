@@ -0,0 +1,422 @@
+/****************************************
+ *
+ *   Earth orientation engine
+ *   ECEF <-> ECI (mean J2000) transforms
+ *   of satellite states with the earth
+ *   orientation parameters of message 32
+ *   IS-GPS-200 30.3.3.5
+ *
+ *   IAU 1976 precession, IAU 1980
+ *   nutation (leading terms), GAST and
+ *   broadcast polar motion and UT1
+ *
+ *   Rotations are computed once per
+ *   epoch by prepare and shared by every
+ *   satellite of that epoch
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef EOP_ENGINE_H
+#define EOP_ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <cmath>
+
+#include "gps_l2_satellite.h"
+#include "time_service.h"
+
+#define AS2R          (PI / 180.0 / 3600.0)     /* arcsec to rad */
+#define JD_GPST0      2444244.5                 /* julian date of gps epoch */
+#define JD_J2000      2451545.0                 /* julian date of J2000 */
+#define TT_GPST       51.184                    /* tt - gps time (s) */
+#define OMEGA_UT1     7.292115146706979E-5      /* earth rotation rate, nominal lod (rad/s) */
+#define NUT_TERMS     30                        /* iau 1980 nutation terms kept */
+
+
+/*
+___________________________________________________
+   Eop Frame Struct:
+        per epoch 3x3 row major matrices,
+        state = position, velocity
+        ecef -> eci:  r_i = e2i r_e
+                      v_i = e2i v_e + e2i_v r_e
+        eci -> ecef:  r_e = i2e r_i
+                      v_e = i2e v_i + i2e_v r_i
+___________________________________________________
+
+*/
+typedef struct
+{
+    double e2i[9];
+    double e2i_v[9];
+    double i2e[9];
+    double i2e_v[9];
+
+} eop_frame;
+
+
+/*___________________________________________________
+   EopEngine Class:
+        :tEOP: eop reference time of week (s)
+        :PM_X, PM_Y: polar motion (arcsec) and
+                     rates (arcsec/day)
+        :deltaUTGPS: ut1 - gps (s) and rate (s/day)
+        :tow: tow count of the message
+        :frames: rotations of the prepared epochs
+        :member functions:::::::::::::::::::::
+            -update: take a decoded message 32
+            -collect: latest message 32 of a file
+            -frame: rotations of one epoch
+            -prepare: rotations of a batch of epochs
+            -ecef2eci, eci2ecef: transform states
+             of the prepared epochs
+_____________________________________________________
+
+*/
+class EopEngine{
+
+    public:
+
+    uint32_t tEOP;
+    double PM_X, PM_Xdot;
+    double PM_Y, PM_Ydot;
+    double deltaUTGPS, deltaUTGPSdot;
+    uint32_t tow;
+    bool valid;
+
+    std::vector<eop_frame> frames;
+
+    EopEngine()
+    {
+        tEOP = tow = 0;
+        PM_X = PM_Xdot = PM_Y = PM_Ydot = 0;
+        deltaUTGPS = deltaUTGPSdot = 0;
+        valid = false;
+    }
+
+    void update(const Msg_Type_32& m)
+    {
+        tEOP = m.tEOP;
+        PM_X = m.PM_X;
+        PM_Xdot = m.PM_Xdot;
+        PM_Y = m.PM_Y;
+        PM_Ydot = m.PM_Ydot;
+        deltaUTGPS = m.deltaUTGPS;
+        deltaUTGPSdot = m.deltaUTGPSdot;
+        tow = m.TOW;
+        valid = true;
+    }
+
+    /* message 32 with the latest tow count */
+    void collect(const SatelliteFile& file)
+    {
+        const Msg_Type_32* latest = NULL;
+        for(int i = 1 ; i <= MAXPRN ; i++)
+        {
+            const Satellite* s = file.satellite[i];
+            if(s->m32.empty()) continue;
+            if(latest == NULL || s->m32.back().TOW > latest->TOW)
+                latest = &s->m32.back();
+        }
+        if(latest) update(*latest);
+    }
+
+    /*
+        Rotations of one epoch, without a message 32
+        polar motion is zero and ut1 is taken as utc
+        @param t: gps seconds since gps epoch
+    */
+    void frame(double t, eop_frame& f) const
+    {
+        double xp = 0, yp = 0, dut;
+        if(valid){
+            double dd = week_diff(t, tEOP) / 86400.0;
+            xp = (PM_X + PM_Xdot * dd) * AS2R;
+            yp = (PM_Y + PM_Ydot * dd) * AS2R;
+            dut = deltaUTGPS + deltaUTGPSdot * dd;
+        }
+        else dut = -utc.leap_seconds(t);
+
+        /* precession and nutation, tt centuries since J2000 */
+        double tt = (JD_GPST0 - JD_J2000 + (t + TT_GPST) / 86400.0) / 36525.0;
+        double P[9], N[9], NP[9], T[9], eps, dpsi, deps, om;
+        precession(tt, P);
+        eps = mean_obliquity(tt);
+        nutation(tt, &dpsi, &deps, &om);
+
+        double R1[9], R2[9], R3[9];
+        rot_x(-eps - deps, R1);
+        rot_z(-dpsi, R2);
+        rot_x(eps, R3);
+        mat_mul(R1, R2, T);
+        mat_mul(T, R3, N);
+        mat_mul(N, P, NP);
+
+        /* earth rotation, equation of the equinoxes with the 1994 terms */
+        double gast = gmst(t + dut) + dpsi * cos(eps)
+                    + (0.00264 * sin(om) + 0.000063 * sin(2.0 * om)) * AS2R;
+        double R[9], W[9];
+        rot_z(gast, R);
+        rot_y(-xp, R1);
+        rot_x(-yp, R2);
+        mat_mul(R1, R2, W);
+
+        /* i2e = W R NP */
+        double RNP[9];
+        mat_mul(R, NP, RNP);
+        mat_mul(W, RNP, f.i2e);
+        transpose(f.i2e, f.e2i);
+
+        /* e2i_v = (R NP)' S W', S = [w]x about the pef z axis */
+        double w = OMEGA_UT1 * (1.0 + (valid ? deltaUTGPSdot : 0) / 86400.0);
+        double S[9] = { 0, -w, 0,  w, 0, 0,  0, 0, 0 };
+        double Wt[9], SWt[9], RNPt[9];
+        transpose(W, Wt);
+        transpose(RNP, RNPt);
+        mat_mul(S, Wt, SWt);
+        mat_mul(RNPt, SWt, f.e2i_v);
+
+        /* i2e_v = -i2e e2i_v i2e */
+        mat_mul(f.e2i_v, f.i2e, T);
+        mat_mul(f.i2e, T, R1);
+        for(int k = 0 ; k < 9 ; k++) f.i2e_v[k] = -R1[k];
+    }
+
+    /*
+        Rotations of a batch of epochs, kept in frames
+        @param t: gps seconds since gps epoch
+        @param epochs: number of epochs
+    */
+    void prepare(const double* t, size_t epochs)
+    {
+        frames.resize(epochs);
+        for(size_t k = 0 ; k < epochs ; k++) frame(t[k], frames[k]);
+    }
+
+    /*
+        Transform states of the prepared epochs
+        @param in: epochs * sats states, epoch major,
+                   x, y, z (m), vx, vy, vz (m/s)
+        @param sats: satellites per epoch
+        @param out: transformed states, may alias in
+    */
+    void ecef2eci(const double* in, size_t sats, double* out) const
+    {
+        for(size_t k = 0 ; k < frames.size() ; k++)
+            rotate(frames[k].e2i, frames[k].e2i_v, in + k * sats * 6,
+                   out + k * sats * 6, sats);
+    }
+
+    void eci2ecef(const double* in, size_t sats, double* out) const
+    {
+        for(size_t k = 0 ; k < frames.size() ; k++)
+            rotate(frames[k].i2e, frames[k].i2e_v, in + k * sats * 6,
+                   out + k * sats * 6, sats);
+    }
+
+    /* single state at t */
+    void ecef2eci(double t, const double* in, double* out) const
+    {
+        eop_frame f;
+        frame(t, f);
+        rotate(f.e2i, f.e2i_v, in, out, 1);
+    }
+
+    void eci2ecef(double t, const double* in, double* out) const
+    {
+        eop_frame f;
+        frame(t, f);
+        rotate(f.i2e, f.i2e_v, in, out, 1);
+    }
+
+    private:
+
+    TimeService utc;
+
+    /* r' = M r, v' = M v + V r over n states */
+    static void rotate(const double* M, const double* V, const double* in,
+                       double* out, size_t n)
+    {
+        const double m0 = M[0], m1 = M[1], m2 = M[2], m3 = M[3], m4 = M[4];
+        const double m5 = M[5], m6 = M[6], m7 = M[7], m8 = M[8];
+        const double v0 = V[0], v1 = V[1], v2 = V[2], v3 = V[3], v4 = V[4];
+        const double v5 = V[5], v6 = V[6], v7 = V[7], v8 = V[8];
+
+        OMP_SIMD()
+        for(size_t j = 0 ; j < n ; j++)
+        {
+            const double* a = in + j * 6;
+            double x = a[0], y = a[1], z = a[2], vx = a[3], vy = a[4], vz = a[5];
+            double* b = out + j * 6;
+
+            b[0] = m0 * x + m1 * y + m2 * z;
+            b[1] = m3 * x + m4 * y + m5 * z;
+            b[2] = m6 * x + m7 * y + m8 * z;
+            b[3] = m0 * vx + m1 * vy + m2 * vz + v0 * x + v1 * y + v2 * z;
+            b[4] = m3 * vx + m4 * vy + m5 * vz + v3 * x + v4 * y + v5 * z;
+            b[5] = m6 * vx + m7 * vy + m8 * vz + v6 * x + v7 * y + v8 * z;
+        }
+    }
+
+    /* t - tow of week, wrapped into half a week */
+    static double week_diff(double t, double tow_ref)
+    {
+        double dt = fmod(t, 604800.0) - tow_ref;
+        if(dt > 302400) dt -= 604800;
+        else if(dt < -302400) dt += 604800;
+        return dt;
+    }
+
+    /* iau 1982 gmst (rad), u: ut1 seconds since gps epoch */
+    static double gmst(double u)
+    {
+        double days = floor(u / 86400.0);
+        double sod = u - days * 86400.0;
+        double t1 = (JD_GPST0 + days - JD_J2000) / 36525.0;
+        double t2 = t1 * t1, t3 = t2 * t1;
+
+        double g = 24110.54841 + 8640184.812866 * t1 + 0.093104 * t2 - 6.2E-6 * t3
+                 + 1.002737909350795 * sod;
+        return fmod(g, 86400.0) * PI / 43200.0;
+    }
+
+    /* iau 1976 mean obliquity (rad) */
+    static double mean_obliquity(double t)
+    {
+        return (84381.448 - 46.8150 * t - 0.00059 * t * t + 0.001813 * t * t * t) * AS2R;
+    }
+
+    /* iau 1976 precession, J2000 to mean of date */
+    static void precession(double t, double* P)
+    {
+        double t2 = t * t, t3 = t2 * t;
+        double ze = (2306.2181 * t + 0.30188 * t2 + 0.017998 * t3) * AS2R;
+        double th = (2004.3109 * t - 0.42665 * t2 - 0.041833 * t3) * AS2R;
+        double z  = (2306.2181 * t + 1.09468 * t2 + 0.018203 * t3) * AS2R;
+
+        double R1[9], R2[9], R3[9], T[9];
+        rot_z(-z, R1);
+        rot_y(th, R2);
+        rot_z(-ze, R3);
+        mat_mul(R2, R3, T);
+        mat_mul(R1, T, P);
+    }
+
+    /*
+        Iau 1980 nutation, terms above 1.5 mas kept
+        @param dpsi, deps: nutation in longitude,
+                           obliquity (rad)
+        @param om: moon's ascending node (rad)
+    */
+    static void nutation(double t, double* dpsi, double* deps, double* om)
+    {
+        /* l, l', F, D, OMEGA, dpsi (0.1 mas) and rate, deps and rate */
+        static const double nut[NUT_TERMS][9] = {
+            {  0,  0,  0,  0,  1, -171996, -174.2, 92025,  8.9 },
+            {  0,  0,  2, -2,  2,  -13187,   -1.6,  5736, -3.1 },
+            {  0,  0,  2,  0,  2,   -2274,   -0.2,   977, -0.5 },
+            {  0,  0,  0,  0,  2,    2062,    0.2,  -895,  0.5 },
+            {  0,  1,  0,  0,  0,    1426,   -3.4,    54, -0.1 },
+            {  1,  0,  0,  0,  0,     712,    0.1,    -7,    0 },
+            {  0,  1,  2, -2,  2,    -517,    1.2,   224, -0.6 },
+            {  0,  0,  2,  0,  1,    -386,   -0.4,   200,    0 },
+            {  1,  0,  2,  0,  2,    -301,      0,   129, -0.1 },
+            {  0, -1,  2, -2,  2,     217,   -0.5,   -95,  0.3 },
+            {  1,  0,  0, -2,  0,    -158,      0,    -1,    0 },
+            {  0,  0,  2, -2,  1,     129,    0.1,   -70,    0 },
+            { -1,  0,  2,  0,  2,     123,      0,   -53,    0 },
+            {  1,  0,  0,  0,  1,      63,    0.1,   -33,    0 },
+            {  0,  0,  0,  2,  0,      63,      0,    -2,    0 },
+            { -1,  0,  2,  2,  2,     -59,      0,    26,    0 },
+            { -1,  0,  0,  0,  1,     -58,   -0.1,    32,    0 },
+            {  1,  0,  2,  0,  1,     -51,      0,    27,    0 },
+            {  2,  0,  0, -2,  0,      48,      0,     1,    0 },
+            { -2,  0,  2,  0,  1,      46,      0,   -24,    0 },
+            {  0,  0,  2,  2,  2,     -38,      0,    16,    0 },
+            {  2,  0,  2,  0,  2,     -31,      0,    13,    0 },
+            {  2,  0,  0,  0,  0,      29,      0,    -1,    0 },
+            {  1,  0,  2, -2,  2,      29,      0,   -12,    0 },
+            {  0,  0,  2,  0,  0,      26,      0,    -1,    0 },
+            {  0,  0,  2, -2,  0,     -22,      0,     0,    0 },
+            { -1,  0,  2,  0,  1,      21,      0,   -10,    0 },
+            {  0,  2,  0,  0,  0,      17,   -0.1,     0,    0 },
+            {  0,  2,  2, -2,  2,     -16,    0.1,     7,    0 },
+            { -1,  0,  0,  2,  1,      16,      0,    -8,    0 }
+        };
+
+        /* delaunay arguments, deg and arcsec polynomials */
+        static const double fc[5][5] = {
+            { 134.96340251, 1717915923.2178,  31.8792,  0.051635, -0.00024470 },
+            { 357.52910918,  129596581.0481,  -0.5532,  0.000136, -0.00001149 },
+            {  93.27209062, 1739527262.8478, -12.7512, -0.001037,  0.00000417 },
+            { 297.85019547, 1602961601.2090,  -6.3706,  0.006593, -0.00003169 },
+            { 125.04455501,   -6962890.2665,   7.4722,  0.007702, -0.00005939 }
+        };
+
+        double f[5], tt[4] = { t, t * t, t * t * t, t * t * t * t };
+        for(int i = 0 ; i < 5 ; i++){
+            double as = 0;
+            for(int j = 0 ; j < 4 ; j++) as += fc[i][j+1] * tt[j];
+            f[i] = fmod(fc[i][0] * 3600.0 + as, 1296000.0) * AS2R;
+        }
+
+        double ps = 0, ep = 0;
+        for(int i = 0 ; i < NUT_TERMS ; i++){
+            double ang = 0;
+            for(int j = 0 ; j < 5 ; j++) ang += nut[i][j] * f[j];
+            ps += (nut[i][5] + nut[i][6] * t) * sin(ang);
+            ep += (nut[i][7] + nut[i][8] * t) * cos(ang);
+        }
+        *dpsi = ps * 1E-4 * AS2R;
+        *deps = ep * 1E-4 * AS2R;
+        *om = f[4];
+    }
+
+    static void rot_x(double a, double* R)
+    {
+        double s = sin(a), c = cos(a);
+        R[0] = 1; R[1] =  0; R[2] = 0;
+        R[3] = 0; R[4] =  c; R[5] = s;
+        R[6] = 0; R[7] = -s; R[8] = c;
+    }
+
+    static void rot_y(double a, double* R)
+    {
+        double s = sin(a), c = cos(a);
+        R[0] = c; R[1] = 0; R[2] = -s;
+        R[3] = 0; R[4] = 1; R[5] =  0;
+        R[6] = s; R[7] = 0; R[8] =  c;
+    }
+
+    static void rot_z(double a, double* R)
+    {
+        double s = sin(a), c = cos(a);
+        R[0] =  c; R[1] = s; R[2] = 0;
+        R[3] = -s; R[4] = c; R[5] = 0;
+        R[6] =  0; R[7] = 0; R[8] = 1;
+    }
+
+    static void mat_mul(const double* A, const double* B, double* C)
+    {
+        for(int i = 0 ; i < 3 ; i++)
+            for(int j = 0 ; j < 3 ; j++)
+                C[i*3+j] = A[i*3] * B[j] + A[i*3+1] * B[3+j] + A[i*3+2] * B[6+j];
+    }
+
+    static void transpose(const double* A, double* B)
+    {
+        for(int i = 0 ; i < 3 ; i++)
+            for(int j = 0 ; j < 3 ; j++)
+                B[j*3+i] = A[i*3+j];
+    }
+
+};
+
+
+#endif
\ No newline at end of file
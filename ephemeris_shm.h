@@ -0,0 +1,327 @@
+/****************************************
+ *
+ *   Ephemeris shared memory
+ *   Latest upload of every PRN and the
+ *   klobuchar parameters published by one
+ *   decoder to co-located processes
+ *
+ *   Each record is a seqlock, the writer
+ *   never waits and readers copy without
+ *   locks or system calls, retrying only
+ *   when a publish overlapped the copy.
+ *   A reader polls live() to learn that
+ *   the writer closed or made the segment
+ *   again and it has to attach anew
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef EPHEMERIS_SHM_H
+#define EPHEMERIS_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <type_traits>
+#ifndef WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#else
+#include <windows.h>
+#endif
+
+#include "ephemeris_store.h"
+#include "gps_l2_message_types.hpp"
+
+#define SHM_NAME      "/gps_l2_eph"   /* default segment */
+#define SHM_MAGIC     0x4C324550      /* "PE2L" */
+#define SHM_LINE      64              /* records on their own cache lines */
+
+
+/* klobuchar record of the segment */
+typedef struct{
+
+    double alpha[4];
+    double beta[4];
+    uint32_t tow;          /* tow of message 30 (s) */
+    uint32_t valid;
+
+} shm_iono;
+
+
+/*___________________________________________________
+   Seqlock Struct:
+        Record of trivially copyable T in
+        shared memory. Sequence is odd while
+        the writer copies, payload words are
+        relaxed atomics so a torn copy is only
+        discarded, never undefined
+        :seq: publish count * 2, 0 never written
+        :member functions:::::::::::::::::::::
+            -store: single writer publish
+            -load: consistent copy, false if
+             never written
+_____________________________________________________
+
+*/
+template <class T>
+struct alignas(SHM_LINE) Seqlock{
+
+    static_assert(std::is_trivially_copyable<T>::value, "seqlock record must be trivially copyable");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock free");
+
+    enum { WORDS = (sizeof(T) + 7) / 8 };
+
+    std::atomic<uint32_t> seq;
+    std::atomic<uint64_t> words[WORDS];
+
+    void store(const T& v)
+    {
+        uint64_t w[WORDS] = { 0 };
+        memcpy(w, &v, sizeof(T));
+
+        uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for(int i = 0 ; i < WORDS ; i++) words[i].store(w[i], std::memory_order_relaxed);
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    bool load(T& v) const
+    {
+        uint64_t w[WORDS];
+        uint32_t s0, s1;
+        do
+        {
+            s0 = seq.load(std::memory_order_acquire);
+            if(s0 == 0) return false;
+            if(s0 & 1) continue;
+            for(int i = 0 ; i < WORDS ; i++) w[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s1 = seq.load(std::memory_order_relaxed);
+        } while((s0 & 1) || s0 != s1);
+
+        memcpy(&v, w, sizeof(T));
+        return true;
+    }
+
+};
+
+
+/* segment layout, magic is set last by the writer */
+typedef struct{
+
+    std::atomic<uint32_t> magic;
+    uint32_t size;                     /* sizeof of the layout */
+    uint32_t maxprn;
+    std::atomic<uint32_t> closed;      /* writer closed the segment */
+    std::atomic<uint64_t> epoch;       /* changes with every create */
+    std::atomic<uint64_t> updates;     /* publishes of any record */
+    Seqlock<shm_iono> iono;
+    Seqlock<eph> sat[MAXPRN + 1];
+
+} shm_segment;
+
+
+/*___________________________________________________
+   EphemerisShm Class:
+        One writer creates the segment, any
+        number of readers attach to it
+        :member functions:::::::::::::::::::::
+            -create: writer side, segment name
+            -attach: reader side, read only
+            -publish: uploads whose store
+             generation changed, or message 30
+            -read, iono: snapshots of a reader
+            -updates: change counter to poll
+            -live: false once the writer closed
+             or created the segment again
+            -close
+_____________________________________________________
+
+*/
+class EphemerisShm{
+
+    public:
+
+    EphemerisShm() : seg(NULL), owner(false), epoch(0)
+    {
+#ifdef WIN32
+        handle = NULL;
+#endif
+        for(int i = 0 ; i <= MAXPRN ; i++) sent[i] = 0;
+    }
+
+    ~EphemerisShm() { close(); }
+
+    /*
+        Create or reset the segment of name
+        @return false if it can not be mapped
+    */
+    bool create(const char* name = SHM_NAME)
+    {
+        close();
+        if(!map(name, true)) return false;
+
+        /* readers of an earlier segment of name see a new epoch */
+        memset((void*)seg, 0, sizeof(shm_segment));
+        seg->size = sizeof(shm_segment);
+        seg->maxprn = MAXPRN;
+        epoch = (uint64_t)std::chrono::system_clock::now().time_since_epoch().count() | 1;
+        seg->epoch.store(epoch, std::memory_order_relaxed);
+        seg->magic.store(SHM_MAGIC, std::memory_order_release);
+        owner = true;
+        this->name = name;
+
+        /* every PRN of the store goes to the new segment */
+        for(int i = 0 ; i <= MAXPRN ; i++) sent[i] = 0;
+        return true;
+    }
+
+    /* @return false if no writer created name or layouts differ */
+    bool attach(const char* name = SHM_NAME)
+    {
+        close();
+        if(!map(name, false)) return false;
+
+        if(seg->magic.load(std::memory_order_acquire) != SHM_MAGIC
+           || seg->size != sizeof(shm_segment) || seg->maxprn != MAXPRN)
+        {
+            std::cout << "Ephemeris segment layout differs: " << name << std::endl;
+            close();
+            return false;
+        }
+        epoch = seg->epoch.load(std::memory_order_acquire);
+        return true;
+    }
+
+    void close()
+    {
+        if(seg == NULL) return;
+        if(owner) seg->closed.store(1, std::memory_order_release);
+#ifndef WIN32
+        munmap((void*)seg, sizeof(shm_segment));
+        if(owner) shm_unlink(name.c_str());
+#else
+        UnmapViewOfFile((void*)seg);
+        CloseHandle(handle);
+        handle = NULL;
+#endif
+        seg = NULL;
+        owner = false;
+    }
+
+    void publish(int prn, const eph& e)
+    {
+        if(seg == NULL || !owner || prn < 1 || prn > MAXPRN) return;
+        seg->sat[prn].store(e);
+        seg->updates.fetch_add(1, std::memory_order_release);
+    }
+
+    /* latest upload of every PRN whose generation moved */
+    void publish(const EphemerisStore& store)
+    {
+        for(int prn = 1 ; prn <= MAXPRN ; prn++)
+        {
+            uint32_t g = store.generation(prn);
+            if(g == sent[prn] || store.ephemerides(prn).empty()) continue;
+            sent[prn] = g;
+            publish(prn, store.ephemerides(prn).back());
+        }
+    }
+
+    void publish(const Msg_Type_30& m)
+    {
+        if(seg == NULL || !owner) return;
+
+        shm_iono k;
+        for(int i = 0 ; i < 4 ; i++){
+            k.alpha[i] = m.alpha[i];
+            k.beta[i] = m.beta[i];
+        }
+        k.tow = m.TOW;
+        k.valid = 1;
+        seg->iono.store(k);
+        seg->updates.fetch_add(1, std::memory_order_release);
+    }
+
+    /* @return false if PRN was never published */
+    bool read(int prn, eph& e) const
+    {
+        if(seg == NULL || prn < 1 || prn > MAXPRN) return false;
+        return seg->sat[prn].load(e);
+    }
+
+    bool iono(shm_iono& k) const
+    {
+        return seg != NULL && seg->iono.load(k);
+    }
+
+    /* a reader copies again only when this moved */
+    uint64_t updates() const
+    {
+        return seg ? seg->updates.load(std::memory_order_acquire) : 0;
+    }
+
+    /* the segment attached to is still the writer's */
+    bool live() const
+    {
+        return seg != NULL && !seg->closed.load(std::memory_order_acquire)
+               && seg->epoch.load(std::memory_order_acquire) == epoch;
+    }
+
+    private:
+
+    shm_segment* seg;
+    bool owner;
+    uint64_t epoch;                    /* of the segment when mapped */
+    std::string name;
+    uint32_t sent[MAXPRN + 1];
+#ifdef WIN32
+    HANDLE handle;
+#endif
+
+    bool map(const char* name, bool writer)
+    {
+        void* p;
+#ifndef WIN32
+        int fd = shm_open(name, writer ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+        if(fd < 0){
+            std::cout << "Ephemeris segment can not be opened: " << name << std::endl;
+            return false;
+        }
+        if(writer && ftruncate(fd, sizeof(shm_segment)) != 0){
+            ::close(fd);
+            return false;
+        }
+        p = mmap(NULL, sizeof(shm_segment), writer ? PROT_READ | PROT_WRITE : PROT_READ,
+                 MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED) return false;
+#else
+        const char* n = name[0] == '/' ? name + 1 : name;
+        handle = writer
+               ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(shm_segment), n)
+               : OpenFileMappingA(FILE_MAP_READ, FALSE, n);
+        if(handle == NULL){
+            std::cout << "Ephemeris segment can not be opened: " << name << std::endl;
+            return false;
+        }
+        p = MapViewOfFile(handle, writer ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, sizeof(shm_segment));
+        if(p == NULL){ CloseHandle(handle); handle = NULL; return false; }
+#endif
+        seg = (shm_segment*)p;
+        return true;
+    }
+
+};
+
+
+#endif
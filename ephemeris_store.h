@@ -0,0 +1,254 @@
+/****************************************
+ *
+ *   Ephemeris store
+ *   Assembled ephemerides of gps
+ *   satellites 1 - 32 indexed by toe
+ *   Best ephemeris lookup for (PRN, t)
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef EPH_STORE_H
+#define EPH_STORE_H
+
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <cmath>
+
+#include "gpstime.h"
+
+#define MAXPRN        32         /* gps satellites 1 - 32 */
+#define EPH_FIT_HOURS 3          /* cnav curve fit interval (h) */
+#define EPH_HEALTH_UNKNOWN 0xFF  /* sv_health of an upload without one */
+#define EPH_URA_MAX   15         /* 4 bit ura index, no accuracy prediction */
+
+
+/*
+ * Ephemeris Message
+ */
+
+typedef struct{
+
+    double clock_bias;
+    double clock_drift;
+    double clock_rate;
+    double IODE;
+    double Crs;
+    double delta_n;
+    double M0;
+    double Cuc;
+    double eccentricity;
+    double Cus;
+    double sqrtA;
+    double TOE ;
+    double Cic;
+    double OMEGA;
+    double Cis;
+    double I0;
+    double Crc;
+    double omega;
+    double OMEGA_DOT;
+    double IDOT;
+    double l2_codes;
+    double week;
+    double l2_p_flag;
+    uint8_t sv_acc;        /* 4 bit ura index */
+    uint8_t sv_health;     /* cnav l1 << 2 | l2 << 1 | l5, lnav 6 bit code */
+    double tgd;
+    double IODC;
+    uint32_t trans_time;
+    uint8_t fit_interval;
+    double Adot;           /* cnav semi major ax change rate */
+    double delta_n_dot;    /* cnav rate of mean motion difference */
+    double toc;            /* clock data reference time */
+
+} eph;
+
+
+/* gps seconds -----------------------------------------------------------------
+* seconds since gps time reference
+* args   : gtime_t t        I   gtime_t struct
+* return : seconds since 1980/1/6 00:00:00 gpst
+*-----------------------------------------------------------------------------*/
+inline double gpst_seconds(gtime_t t)
+{
+    static const time_t t0 = epoch2time(gpst0).time;
+    return (double)(t.time - t0) + t.sec;
+}
+
+/* 4 bit ura index of a cnav URA_ED index -16 - 15. Negative
+ * indices are better than 2.4 m, the best the 4 bit index
+ * holds, so they clamp to 0 */
+inline uint8_t ura_index_ed(int ura_ed)
+{
+    if(ura_ed < 0) return 0;
+    return ura_ed > EPH_URA_MAX ? EPH_URA_MAX : (uint8_t)ura_ed;
+}
+
+
+/*___________________________________________________
+   EphemerisStore Class:
+        :toe: per PRN toe keys, sorted ascending
+        :ephs: per PRN ephemerides, same order
+        :gen: per PRN generation, bumped on insert
+        :member functions:::::::::::::::::::::
+            -insert: add or replace an upload
+            -replace: overwrite an upload in place
+            -find: best ephemeris for (PRN, t)
+            -generation: change counter of PRN
+_____________________________________________________
+
+*/
+class EphemerisStore{
+
+    public:
+
+    /*
+        Add an assembled ephemeris, an upload
+        with an existing toe replaces it
+        @param prn: 1 - 32
+        @param e: assembled ephemeris
+    */
+    void insert(int prn, const eph& e)
+    {
+        if(prn < 1 || prn > MAXPRN) return;
+
+        std::vector<double>& keys = toe[prn];
+        double key = gpst_seconds(gpst2time((int)e.week, e.TOE));
+
+        size_t i = lower(keys, key);
+        if(i < keys.size() && keys[i] == key)
+            ephs[prn][i] = e;
+        else{
+            keys.insert(keys.begin() + i, key);
+            ephs[prn].insert(ephs[prn].begin() + i, e);
+        }
+        gen[prn]++;
+    }
+
+    /*
+        Overwrite an upload already in the store,
+        toe key and order are kept, only PRN's
+        generation changes
+        @param index: position in ephemerides(prn)
+    */
+    void replace(int prn, size_t index, const eph& e)
+    {
+        if(prn < 1 || prn > MAXPRN || index >= ephs[prn].size()) return;
+
+        ephs[prn][index] = e;
+        gen[prn]++;
+    }
+
+    /*
+        Ephemeris whose toe is closest to t and
+        whose fit interval covers t
+        @param prn: 1 - 32
+        @param t: gps time
+        @return NULL if none is valid, pointer
+                is stable until next insert
+    */
+    const eph* find(int prn, gtime_t t) const
+    {
+        if(prn < 1 || prn > MAXPRN) return NULL;
+
+        const std::vector<double>& keys = toe[prn];
+        if(keys.empty()) return NULL;
+
+        double sec = gpst_seconds(t);
+
+        /* steady state: same ephemeris as last query */
+        last_hit& hit = cache()[prn];
+        if(hit.store == id && hit.gen == gen[prn]
+           && closest(keys, hit.index, sec) && valid(prn, hit.index, sec))
+            return &ephs[prn][hit.index];
+
+        /* neighbours of t, prefer the later one on ties */
+        size_t i = lower(keys, sec), best, other;
+        if(i == keys.size())                       { best = i - 1; other = best; }
+        else if(i == 0)                            { best = 0;     other = best; }
+        else if(keys[i] - sec <= sec - keys[i-1])  { best = i;     other = i - 1; }
+        else                                       { best = i - 1; other = i; }
+
+        if(!valid(prn, best, sec)){
+            if(other == best || !valid(prn, other, sec)) return NULL;
+            best = other;
+        }
+        else{
+            hit.store = id;
+            hit.gen = gen[prn];
+            hit.index = best;
+        }
+        return &ephs[prn][best];
+    }
+
+    /* ephemerides of PRN sorted by toe */
+    const std::vector<eph>& ephemerides(int prn) const { return ephs[prn]; }
+
+    /* changes every time PRN gets an upload */
+    uint32_t generation(int prn) const { return gen[prn]; }
+
+    EphemerisStore()
+    {
+        static std::atomic<uint64_t> stores(0);
+        id = ++stores;
+        for(int i = 0 ; i <= MAXPRN ; i++) gen[i] = 0;
+    }
+
+    private:
+
+    /* per thread result of the last lookup */
+    struct last_hit
+    {
+        uint64_t store = 0;
+        uint32_t gen = 0;
+        size_t index = 0;
+    };
+
+    std::vector<double> toe[MAXPRN + 1];
+    std::vector<eph> ephs[MAXPRN + 1];
+    uint32_t gen[MAXPRN + 1];
+    uint64_t id;
+
+    static last_hit* cache()
+    {
+        static thread_local last_hit hits[MAXPRN + 1];
+        return hits;
+    }
+
+    /* first index with key >= sec */
+    static size_t lower(const std::vector<double>& keys, double sec)
+    {
+        size_t lo = 0, n = keys.size();
+        while(n > 0){
+            size_t half = n / 2;
+            if(keys[lo + half] < sec){ lo += half + 1; n -= half + 1; }
+            else n = half;
+        }
+        return lo;
+    }
+
+    /* is index the one the binary search would pick */
+    static bool closest(const std::vector<double>& keys, size_t i, double sec)
+    {
+        if(i >= keys.size()) return false;
+        double d = sec - keys[i];
+        if(d > 0) return i + 1 == keys.size() || keys[i+1] - sec > d;
+        return i == 0 || sec - keys[i-1] >= -d;
+    }
+
+    bool valid(int prn, size_t i, double sec) const
+    {
+        int hours = ephs[prn][i].fit_interval ? ephs[prn][i].fit_interval
+                                              : EPH_FIT_HOURS;
+        return fabs(sec - toe[prn][i]) <= hours * 3600 / 2.0;
+    }
+
+};
+
+
+#endif
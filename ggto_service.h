@@ -0,0 +1,202 @@
+/****************************************
+ *
+ *   GGTO service
+ *   GPS to other gnss time conversion
+ *   from the gps/gnss time offset of
+ *   message 35
+ *   IS-GPS-200 30.3.3.8
+ *
+ *   One set of parameters per gnss id,
+ *   a conversion is a polynomial and an
+ *   integer offset, O(1) per timestamp
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef GGTO_SERVICE_H
+#define GGTO_SERVICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cmath>
+
+#include "gps_l2_satellite.h"
+#include "time_service.h"
+
+#define GGTO_NONE     0          /* no data */
+#define GGTO_GAL      1          /* galileo system time */
+#define GGTO_GLO      2          /* glonass time, utc(su) + 3 h */
+#define GGTO_SYSTEMS  8          /* 3 bit gnss id */
+#define GLO_UTC_OFS   10800      /* glonass time - utc(su) (s) */
+
+
+/*
+___________________________________________________
+   GGTO Struct:
+        polynomial of one gnss, gps - gnss =
+        A0 + A1 dt + A2 dt^2, dt = t - t_ref
+        t_ref in gps seconds since gps epoch
+___________________________________________________
+
+*/
+typedef struct
+{
+    bool valid;
+    double A0;
+    double A1;
+    double A2;
+    double t_ref;
+    uint32_t tow;
+
+} ggto_t;
+
+
+/*___________________________________________________
+   GgtoService Class:
+        :sys: latest parameters by gnss id
+        :utc: leap seconds for glonass time
+        :member functions:::::::::::::::::::::
+            -update: take a decoded message 35
+            -collect: every message 35 of a file
+            -offset: gps - gnss at gps time (s)
+            -gps2gnss, gnss2gps: single and batch
+_____________________________________________________
+
+*/
+class GgtoService{
+
+    public:
+
+    ggto_t sys[GGTO_SYSTEMS];
+    TimeService utc;
+
+    GgtoService()
+    {
+        for(int i = 0 ; i < GGTO_SYSTEMS ; i++) sys[i] = ggto_t();
+    }
+
+    /* newer reference time wins per gnss */
+    void update(const Msg_Type_35& m)
+    {
+        if(m.GNSSID == GGTO_NONE || m.GNSSID >= GGTO_SYSTEMS) return;
+
+        double t_ref = full_week(m.WNGGTO) * 604800.0 + m.tGGTO;
+        ggto_t& g = sys[m.GNSSID];
+        if(g.valid && t_ref < g.t_ref) return;
+
+        g.valid = true;
+        g.A0 = m.A0GGTO;
+        g.A1 = m.A1GGTO;
+        g.A2 = m.A2GGTO;
+        g.t_ref = t_ref;
+        g.tow = m.TOW;
+    }
+
+    void collect(const SatelliteFile& file)
+    {
+        for(int i = 1 ; i <= MAXPRN ; i++)
+            for(const auto& m: file.satellite[i]->m35) update(m);
+    }
+
+    /*
+        Gps - gnss time (s) at gps seconds t, whole
+        seconds of the time scale included, the
+        fraction is 0 until the gnss has a message
+    */
+    double offset(int gnss, double t) const
+    {
+        return whole(gnss, t) + fraction(gnss, t);
+    }
+
+    /*
+        Gps to gnss time, both in seconds since the
+        gps epoch, gnss time on its own scale
+    */
+    double gps2gnss(int gnss, double t) const
+    {
+        return t - offset(gnss, t);
+    }
+
+    /* offset is taken at gps time, two fixed point steps */
+    double gnss2gps(int gnss, double t) const
+    {
+        double g = t + offset(gnss, t);
+        return t + offset(gnss, g);
+    }
+
+    /*
+        Batch gps to gnss of n times, constant whole
+        seconds over the batch are a single vector loop
+        @param t: gps seconds since gps epoch
+        @param out: gnss seconds since gps epoch
+    */
+    void gps2gnss(int gnss, const double* t, size_t n, double* out) const
+    {
+        convert(gnss, t, n, out, -1.0);
+    }
+
+    void gnss2gps(int gnss, const double* t, size_t n, double* out) const
+    {
+        convert(gnss, t, n, out, 1.0);
+    }
+
+    private:
+
+    /* integer part of gps - gnss, glonass follows utc */
+    double whole(int gnss, double t) const
+    {
+        return gnss == GGTO_GLO ? utc.leap_seconds(t) - GLO_UTC_OFS : 0.0;
+    }
+
+    double fraction(int gnss, double t) const
+    {
+        if(gnss < 0 || gnss >= GGTO_SYSTEMS || !sys[gnss].valid) return 0;
+
+        const ggto_t& g = sys[gnss];
+        double dt = t - g.t_ref;
+        return g.A0 + dt * (g.A1 + dt * g.A2);
+    }
+
+    void convert(int gnss, const double* t, size_t n, double* out, double sign) const
+    {
+        if(n == 0) return;
+
+        double lo = t[0], hi = t[0];
+        OMP_SIMD(reduction(min:lo) reduction(max:hi))
+        for(size_t i = 0 ; i < n ; i++){
+            lo = t[i] < lo ? t[i] : lo;
+            hi = t[i] > hi ? t[i] : hi;
+        }
+
+        bool ok = gnss >= 0 && gnss < GGTO_SYSTEMS && sys[gnss].valid;
+        double a0 = ok ? sys[gnss].A0 : 0, a1 = ok ? sys[gnss].A1 : 0;
+        double a2 = ok ? sys[gnss].A2 : 0, t0 = ok ? sys[gnss].t_ref : 0;
+
+        /* the leap count may change inside the batch for glonass */
+        double w = whole(gnss, lo);
+        if(w != whole(gnss, hi) || w != whole(gnss, lo + sign * w)
+           || w != whole(gnss, hi + sign * w))
+        {
+            for(size_t i = 0 ; i < n ; i++)
+                out[i] = sign > 0 ? gnss2gps(gnss, t[i]) : gps2gnss(gnss, t[i]);
+            return;
+        }
+
+        /* gnss2gps takes the polynomial at t + offset, gps time */
+        double at = sign > 0 ? 1.0 : 0.0;
+        double tr = t0 - at * (w + a0);
+
+        OMP_SIMD()
+        for(size_t i = 0 ; i < n ; i++){
+            double dt = t[i] - tr;
+            out[i] = t[i] + sign * (w + a0 + dt * (a1 + dt * a2));
+        }
+    }
+
+};
+
+
+#endif
\ No newline at end of file
@@ -24,6 +24,9 @@
 #include <vector>
 
 #include "gps_l2_satellite.h"
+#include "ndjson_sink.h"
+#include "rtcm_caster.h"
+#include "ephemeris_shm.h"
 #include "bit.h" 
 #include "binaryfile.h"
 #include "crc24q.h"
@@ -86,18 +89,18 @@ bool Satellite::check_sum(uint32_t* words)
 
     ck checksum;
 
-        calculate(checksum,data->msgClass); 
-        calculate(checksum,data->msgID);    
-        calculate(checksum,data->length);  
+        calculate(checksum,data.msgClass); 
+        calculate(checksum,data.msgID);    
+        calculate(checksum,data.length);  
 
-        calculate(checksum,data->gnssId);   
-        calculate(checksum,data->svId);     
-        calculate(checksum,data->reserved0);
-        calculate(checksum,data->freqId);   
-        calculate(checksum,data->numWords); 
-        calculate(checksum,data->chn);      
-        calculate(checksum,data->version);  
-        calculate(checksum,data->reserved1);
+        calculate(checksum,data.gnssId);   
+        calculate(checksum,data.svId);     
+        calculate(checksum,data.reserved0);
+        calculate(checksum,data.freqId);   
+        calculate(checksum,data.numWords); 
+        calculate(checksum,data.chn);      
+        calculate(checksum,data.version);  
+        calculate(checksum,data.reserved1);
 
         for(int i=0; i<10; i++)
             for(int j=0; j<4; j++)
@@ -107,12 +110,12 @@ bool Satellite::check_sum(uint32_t* words)
     //std::cout << "calculated checks" << (unsigned int)checksum.ck_a 
     //<< " " << (unsigned int)checksum.ck_b << std::endl;
 
-    //std::cout << "CK_A" << (unsigned int)this->data->CK_A <<
-    //"CK_B" << (unsigned int)this->data->CK_B  << std::endl;
+    //std::cout << "CK_A" << (unsigned int)this->data.CK_A <<
+    //"CK_B" << (unsigned int)this->data.CK_B  << std::endl;
     
     /* check summations */
-    return (this->data->CK_A == checksum.ck_a);
-            //&& this->data->CK_B == checksum.ck_b);
+    return (this->data.CK_A == checksum.ck_a);
+            //&& this->data.CK_B == checksum.ck_b);
 }
 
 /*
@@ -131,13 +134,47 @@ void Satellite::decode_gps_l2c(std::ifstream& binfile){
 
     std::cout <<  "Msg ID" << (unsigned)C.msgTypeId << std::endl;
 
-    read_from_file(binfile, data->CK_A);
-    read_from_file(binfile, data->CK_B);
+    read_from_file(binfile, data.CK_A);
+    read_from_file(binfile, data.CK_B);
 
-    /* check sums */
-    if(check_sum(dwrd))
+    uint32_t bad = crc_bad;
+    decode_words(dwrd);
+    if(crc_bad != bad) std::cout << "Crc does not match" << std::endl;
+    else if(!last_msg) std::cout << "Checksums do not hold" << std::endl;
+}
+
+/*
+* Keep py as the frame of the satellite
+* @param py: frame header with CK_A and CK_B
+*/
+void Satellite::take(const UbxFrame& py){
+
+    data = py;
+    flag = true;
+}
+
+/*
+* Checksum and decode of words whose frame
+* is in data, CK_A and CK_B included
+* @param dwrd: 10 words of the frame
+*/
+void Satellite::decode_words(uint32_t* dwrd){
+
+    common C;
+    C.word = dwrd[0];
+    memcpy(words, dwrd, sizeof words);
+
+    /* check sums, a message failing its crc24q is counted, not kept */
+    bool valid = check_sum(dwrd);
+    if(valid && crc_check(dwrd) != crc_sent(dwrd)){
+        valid = false;
+        crc_bad++;
+    }
+
+    if(valid)
     {
         int ID = C.msgTypeId;
+        last_msg = ID;
         
         /*decode unique message type*/
         switch(ID)
@@ -158,7 +195,8 @@ void Satellite::decode_gps_l2c(std::ifstream& binfile){
         };
     
     }
-    else std::cout << "Checksums do not hold" << std::endl;
+    else
+        last_msg = 0;
 
 
 }
@@ -181,6 +219,90 @@ void SatelliteFile::gps_file(std::string& file_name){
     }
 }
 
+/*
+* Decode a gps l2 frame and pass its results to
+* the store, corrections, sink, caster and shm.
+* Satellite keeps a copy of py as its data
+* @param py: frame header with CK_A and CK_B
+* @param dwrd: 10 words of the frame
+* @return true if the frame completed an upload
+*/
+bool SatelliteFile::decode_frame(const UbxFrame& py, uint32_t* dwrd){
+
+    Satellite* s = satellite[py.svId];
+    s->take(py);
+    s->decode_words(dwrd);
+
+    if (sink && s->last_msg)
+        sink->message(py.svId, *s, s->last_msg);
+
+    /* completed upload goes to the store */
+    bool stored = s->eph_updated;
+    if (s->eph_updated)
+    {
+        ephemerides.insert(py.svId, s->eph_mssg);
+        if (sink) sink->ephemeris(py.svId, s->eph_mssg);
+        corrections.apply(py.svId);
+        s->eph_updated = false;
+    }
+
+    /* dc packets correct the PRNs they carry */
+    switch (s->dc_msg)
+    {
+        case 13: corrections.update(s->m13.back()); break;
+        case 14: corrections.update(s->m14.back()); break;
+        case 34: corrections.update(s->m34.back()); break;
+    }
+    s->dc_msg = 0;
+
+    /* new and corrected uploads go out at once */
+    if (caster) caster->publish(ephemerides);
+    if (shm)
+    {
+        shm->publish(ephemerides);
+        if (s->last_msg == 30) shm->publish(s->m30.back());
+    }
+
+    /* long lived streams keep only the latest messages */
+    s->trim(retain);
+    return stored;
+}
+
+/*
+* Store, corrections and publishers of a frame
+* whose satellite was decoded by the worker
+* owning its PRN
+* @param id: message id, 0 if the checksum failed
+* @param dwrd: 10 words of the frame
+* @param upload: upload the frame completed, NULL if none
+*/
+void SatelliteFile::merge_frame(int prn, int id, uint32_t* dwrd, const eph* upload){
+
+    if (sink && id) sink->message(prn, id, dwrd);
+
+    if (upload)
+    {
+        ephemerides.insert(prn, *upload);
+        if (sink) sink->ephemeris(prn, *upload);
+        corrections.apply(prn);
+    }
+
+    /* dc messages hold vectors, they are decoded again here */
+    switch (id)
+    {
+        case 13: { Msg_Type_13 d; d.decode(dwrd); corrections.update(d); break; }
+        case 14: { Msg_Type_14 d; d.decode(dwrd); corrections.update(d); break; }
+        case 34: { Msg_Type_34 d; d.decode(dwrd); corrections.update(d); break; }
+    }
+
+    if (caster) caster->publish(ephemerides);
+    if (shm)
+    {
+        shm->publish(ephemerides);
+        if (id == 30) { Msg_Type_30 k; k.decode(dwrd); shm->publish(k); }
+    }
+}
+
 /* 
     UBX-RXM-SFRBX 
     Gnss Identifier: 
@@ -197,59 +319,59 @@ void SatelliteFile::gps_file(std::string& file_name){
 */
  bool SatelliteFile::find_message(){
 
-    UbxFrame* py;
-    py = new UbxFrame;
+    UbxFrame py;
 
     do
     {
-        read_from_file(binfile,py->preamble1);
+        read_from_file(binfile,py.preamble1);
 
 
         /* first header */
-        if(py->preamble1 == H1){
-                read_from_file(binfile,py->preamble2);
-                read_from_file(binfile,py->msgClass);
-                read_from_file(binfile,py->msgID);
+        if(py.preamble1 == H1){
+                read_from_file(binfile,py.preamble2);
+                read_from_file(binfile,py.msgClass);
+                read_from_file(binfile,py.msgID);
 
         /* broadcast msg or not */
         if(
-            py->preamble2 == H2 &&
-            py->msgClass == BRD_CLASS &&
-            py->msgID == BRD_ID)
+            py.preamble2 == H2 &&
+            py.msgClass == BRD_CLASS &&
+            py.msgID == BRD_ID)
         {           
 
-                read_from_file(binfile,py->length);
-                read_from_file(binfile,py->gnssId);
-                read_from_file(binfile,py->svId);
-                read_from_file(binfile,py->reserved0);
-                read_from_file(binfile,py->freqId);
-                read_from_file(binfile,py->numWords);
-                read_from_file(binfile,py->chn);
-                read_from_file(binfile,py->version);
-                read_from_file(binfile,py->reserved1);
+                read_from_file(binfile,py.length);
+                read_from_file(binfile,py.gnssId);
+                read_from_file(binfile,py.svId);
+                read_from_file(binfile,py.reserved0);
+                read_from_file(binfile,py.freqId);
+                read_from_file(binfile,py.numWords);
+                read_from_file(binfile,py.chn);
+                read_from_file(binfile,py.version);
+                read_from_file(binfile,py.reserved1);
 
 
                 /* gps and l2 freq */
-                if((int)py->gnssId == GNSS_ID
-                     && (int)py->reserved0== signal
-                     && py->length == LENGTH) 
+                if((int)py.gnssId == GNSS_ID
+                     && (int)py.reserved0== signal
+                     && py.length == LENGTH) 
                 { 
-                    std::cout << "Satellite ID: " << (unsigned) py->svId << std::endl;
-
-                    //If satellites first message ever
-                    if (!satellite[py->svId]->flag)
-                   {
-                        satellite[py->svId]->data = py;
-                        satellite[py->svId]->decode_gps_l2c(binfile);
-                        satellite[py->svId]->flag = true;
-
-                    }
-                    else{
-                    
-                        free(satellite[py->svId]->data);
-                        satellite[py->svId]->data = py;
-                        satellite[py->svId]->decode_gps_l2c(binfile);
-                    }
+                    std::cout << "Satellite ID: " << (unsigned) py.svId << std::endl;
+
+                    uint32_t dwrd[10];
+                    satellite[py.svId]->read_words(dwrd, binfile);
+                    read_from_file(binfile, py.CK_A);
+                    read_from_file(binfile, py.CK_B);
+
+                    common C;
+                    C.word = dwrd[0];
+                    std::cout <<  "Msg ID" << (unsigned)C.msgTypeId << std::endl;
+
+                    uint32_t bad = satellite[py.svId]->crc_bad;
+                    decode_frame(py, dwrd);
+                    if(satellite[py.svId]->crc_bad != bad)
+                        std::cout << "Crc does not match" << std::endl;
+                    else if(!satellite[py.svId]->last_msg)
+                        std::cout << "Checksums do not hold" << std::endl;
                     
                     return true;
 
@@ -259,7 +381,6 @@ void SatelliteFile::gps_file(std::string& file_name){
 
     } while( binfile.good() && !binfile.eof() );
 
-    free(py);
     return false;
 }
 
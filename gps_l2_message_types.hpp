@@ -36,19 +36,43 @@ std::cout << c << std::endl;}
 /* Semi circles to radian */
 #define PI 3.1415926535898
 
+/* omp simd hint with its clauses, only when built with openmp */
+#ifdef _OPENMP
+#define OMP_PRAGMA(x) _Pragma(#x)
+#define OMP_SIMD(...) OMP_PRAGMA(omp simd __VA_ARGS__)
+#else
+#define OMP_SIMD(...)
+#endif
+
 /* Scaling factors */
+#define P2_5  0.03125                /* 2^(-5)  */
 #define P2_8  0.00390625           /* 2^(-8)  */
 #define P2_9  0.001953125          /* 2^(-9)  */
+#define P2_11 4.8828125E-4         /* 2^(-11) */
+#define P2_19 1.9073486328125E-6   /* 2^(-19) */
+#define P2_20 9.5367431640625E-7   /* 2^(-20) */
 #define P2_21 4.76837158203125E-7  /* 2^(-21) */
-#define P2_30 9.5367431640625E-7   /* 2^(-30) */
+#define P2_23 1.192092895507813E-7 /* 2^(-23) */
+#define P2_24 5.960464477539063E-8 /* 2^(-24) */
+#define P2_25 2.980232238769531E-8 /* 2^(-25) */
+#define P2_27 7.450580596923828E-9 /* 2^(-27) */
+#define P2_29 1.862645149230957E-9 /* 2^(-29) */
+#define P2_30 9.313225746154785E-10 /* 2^(-30) */
+#define P2_31 4.656612873077393E-10 /* 2^(-31) */
 #define P2_32 2.328306436538E-10   /* 2^(-32) */
+#define P2_33 1.164153218269348E-10 /* 2^(-33) */
 #define P2_34 5.820766091346E-11   /* 2^(-34) */
 #define P2_35 2.910383045673E-11   /* 2^(-35) */
+#define P2_38 3.637978807091713E-12 /* 2^(-38) */
+#define P2_43 1.136868377216160E-13 /* 2^(-43) */
 #define P2_44 5.684341886080E-14   /* 2^(-44) */
 #define P2_48 3.552713678800E-15   /* 2^(-48) */
+#define P2_50  8.881784197001252E-16 /* 2^(-50) */
 #define P2_51  4.440892098500E-16  /* 2^(-51) */
+#define P2_55 2.775557561562891E-17 /* 2^(-55) */
 #define P2_57 6.938893903907E-18   /* 2^(-57) */
 #define P2_60 8.673617379884E-19   /* 2^(-60) */
+#define P2_68 3.388131789017E-21   /* 2^(-68) */
 
 #define AREF          26559710              /* Semi major axis reference */
 #define OMEGADOTREF  -2.6E-9                /* Right ascension reference */
@@ -270,12 +294,7 @@ public:
         toe = w3.toe * 300;
         URAi = concatbin_signed_32(w3.URAindex,0,5,0);
         Adot = concatbin_signed_64(w4.Adot,w5.Adot,21,4) * P2_21;
-        bit32(w6.M0n);
-        bit32(w6.word)
-        bit32(w6.M0n);
-        bit32(w6.word);
         delntan0 = concatbin_signed_32(w5.deltan0,0,17,0);
-        std::cout << "deln " << delntan0;
         delntan0 *= P2_44;
         deln0dot = concatbin_signed_32(w5.deln0dot,w6.deln0dot,11,12) * P2_57;
         M0n = concatbin_signed_64(w6.M0n,w7.M0n,20,13) * P2_32;
@@ -470,7 +489,7 @@ public:
         toe         = w2.toe * 300;
         omega0n     = concatbin_signed_64(w2.omega0n,w3.omega0n,15,18)* P2_32;
         i0n         = concatbin_signed_64(w3.i0n,w4.i0n,14,19)* P2_32;
-        delomegadot = concatbin_signed_64(w4.deltaomega,w4.deltaomega,13,4)* P2_44;
+        delomegadot = concatbin_signed_64(w4.deltaomega,w5.deltaomega,13,4)* P2_44;
         i0nDOT      = concatbin_signed_32(w5.i0nDOT,0,15,0)* P2_44;
         cisn        = concatbin_signed_32(w5.cisn,w6.cisn,13,3) * P2_30;
         cicn        = concatbin_signed_32(w6.cicn,0,16,0)* P2_30  ;
@@ -647,9 +666,9 @@ public:
         uint8_t L5;
         uint8_t L2;
         uint8_t L1;
-        int8_t phi_0; /* argument of latitude at ref time */
-        int8_t omega_0; /* longtitude of ascending node */
-        int8_t sigma_A; /* semi major ax correction */
+        double phi_0;   /* argument of latitude at ref time */
+        double omega_0; /* longtitude of ascending node */
+        double sigma_A; /* semi major ax correction */
         uint8_t PRNa;
     } reduced_almanac;
 
@@ -701,16 +720,23 @@ public:
 
 
     void scale_alm(raw_reduced_almanac in)
+    {
+        redalm.push_back(scale(in));
+    }
+
+    /* 31 bit packet, shared with message 31 */
+    static reduced_almanac scale(raw_reduced_almanac in)
     {
         reduced_almanac red;
         red.L1 = in.L1;
         red.L2 = in.L2;
         red.L5 = in.L5;
-        red.omega_0 = in.omega_0 * pow(2,-6); 
-        red.phi_0  = in.phi_0 * pow(2,-6);
-        red.sigma_A = in.sigma_A* pow(2,9);
-        
-        redalm.push_back(red);
+        red.PRNa = in.PRNa;
+        red.omega_0 = concatbin_signed_32(in.omega_0,0,7,0) * pow(2,-6);
+        red.phi_0  = concatbin_signed_32(in.phi_0,0,7,0) * pow(2,-6);
+        red.sigma_A = concatbin_signed_32(in.sigma_A,0,8,0) * pow(2,9);
+
+        return red;
     }
 
 
@@ -748,7 +774,6 @@ struct Msg_Type_13 {
             uint32_t Dc_1_type     :  1;
             uint32_t tOD          : 11;
             uint32_t topD         : 11;
-            uint32_t toe        : 11;
             uint32_t alert      :  1;
             uint32_t TOW       :   5;
         };
@@ -856,11 +881,11 @@ struct Msg_Type_13 {
 
     typedef struct{
 
-        int16_t daf0;
-        int16_t daf1;
+        double daf0;          /* clock bias correction (s) */
+        double daf1;          /* clock drift correction (s/s) */
         int8_t UDRA;
         uint8_t prn;
-        uint8_t type;
+        uint8_t type;         /* 0 cnav, 1 lnav */
 
     } CDC_scaled;
 
@@ -878,6 +903,8 @@ struct Msg_Type_13 {
     std::vector<CDC_scaled> ClockDifs;
     uint32_t TOW;
     uint32_t CRC;
+    uint32_t topD;            /* data predict time of week (s) */
+    uint32_t tOD;             /* dc data reference time (s) */
 
     void decode(uint32_t* wrd)
     {
@@ -893,7 +920,7 @@ struct Msg_Type_13 {
         w10.word = wrd[9];
 
         /* bind clockdifs */
-        cdc clockdif_correction[7];
+        cdc clockdif_correction[6];
         clockdif_correction[0].word = concatbin(w2.CDC_1m, w3.CDC_1l, 31); //packet 1
         clockdif_correction[1].word = concatbin(w4.CDC_2m, w5.CDC_2l, 2);  //packet 2
         clockdif_correction[2].word = concatbin(w5.CDC_3m, w6.CDC_3l, 5);  //packet 3
@@ -901,30 +928,34 @@ struct Msg_Type_13 {
         clockdif_correction[4].word = concatbin(w7.CDC_5m, w8.CDC_5l, 11); //packet 5
         clockdif_correction[5].word = concatbin(w8.CDC_6m, w9.CDC_6m, 14); //packet 6
 
-        /* scale clock corrections */
-        for(auto& it: clockdif_correction)
-        {
-            CDC_scaled temp;
-            temp.daf1 = it.daf1 * P2_51;
-            temp.daf0 = it.daf0 * P2_35;
-            temp.prn = it.prn;
-            temp.UDRA = it.UDRA;
-
-            ClockDifs.push_back(temp);
-
-        }
+        uint8_t type[6] = { (uint8_t)w2.Dc_1_type, (uint8_t)w3.Dc_2_type,
+                            (uint8_t)w5.Dc_3_type, (uint8_t)w6.Dc_4_type,
+                            (uint8_t)w7.Dc_5_type, (uint8_t)w8.Dc_6_type };
 
-        ClockDifs[0].type = w2.Dc_1_type;
-        ClockDifs[1].type = w3.Dc_2_type;
-        ClockDifs[2].type = w5.Dc_3_type;
-        ClockDifs[3].type = w6.Dc_4_type;
-        ClockDifs[4].type = w7.Dc_5_type;
-        ClockDifs[5].type = w8.Dc_6_type;
+        /* scale clock corrections */
+        ClockDifs.clear();
+        for(int i = 0 ; i < 6 ; i++)
+            ClockDifs.push_back(scale(clockdif_correction[i], type[i]));
 
         TOW = concatbin(w1.TOW, w2.TOW, 5);
         CRC = concatbin(w9.CRC,w10.CRC,12);
+        topD = w2.topD * 300;
+        tOD = w2.tOD * 300;
+
+
+    }
 
+    /* 34 bit packet, shared with message 34 */
+    static CDC_scaled scale(cdc in, uint8_t type)
+    {
+        CDC_scaled temp;
+        temp.daf0 = concatbin_signed_32(in.daf0,0,13,0) * P2_35;
+        temp.daf1 = concatbin_signed_32(in.daf1,0,8,0) * P2_51;
+        temp.prn = in.prn;
+        temp.UDRA = concatbin_signed_32(in.UDRA,0,5,0);
+        temp.type = type;
 
+        return temp;
     }
 
 };
@@ -1062,12 +1093,13 @@ struct Msg_Type_14 {
     struct EDC
             {
         uint8_t prn;
-        int16_t delalph;
-        int16_t delbeta;
-        int16_t delgamm;
-        int16_t deli;
-        int16_t delomg;
-        int16_t delA;
+        uint8_t type;         /* 0 cnav, 1 lnav */
+        double delalph;       /* e cos(omega) */
+        double delbeta;       /* e sin(omega) */
+        double delgamm;       /* M0 + omega (semi-circles) */
+        double deli;          /* semi-circles */
+        double delomg;        /* OMEGA0 (semi-circles) */
+        double delA;          /* m */
         int8_t UDRAdot;
 
             };
@@ -1085,6 +1117,8 @@ struct Msg_Type_14 {
 
         uint32_t TOW;
         uint32_t CRC;
+        uint32_t topD;        /* data predict time of week (s) */
+        uint32_t tOD;         /* dc data reference time (s) */
 
         std::vector<EDC> ephdif_corrections;
 
@@ -1103,31 +1137,34 @@ struct Msg_Type_14 {
 
         TOW = concatbin(w1.TOW, w2.TOW, 5);
         CRC = concatbin(w9.CRC,w10.CRC,12);
+        topD = w2.topD * 300;
+        tOD = w2.tOD * 300;
 
-        EDC edc_1, edc_2;
-
-        edc_1.prn = concatbin(w2.EDC_msb, extractbit(w3.EDC_msb0,0,4), 5);
-        edc_1.delalph = extractbit(w3.EDC_msb0, 5, 18) * P2_34;
-        edc_1.delbeta = concatbin(extractbit(w3.EDC_msb0, 19, 31), extractbit(w4.EDC_msb1, 0, 0), 1) * P2_34;
-        edc_1.delgamm = extractbit(w4.EDC_msb1, 1, 15) * P2_32;
-        edc_1.deli = extractbit(w4.EDC_msb1, 16, 27) * P2_32;
-        edc_1.delomg = concatbin(extractbit(w4.EDC_msb1, 28, 31), extractbit(w5.EDC_lsb, 0, 7), 8) * P2_32;
-        edc_1.delA = extractbit(w5.EDC_lsb, 8, 19) * P2_9;
-        edc_1.UDRAdot = extractbit(w5.EDC_lsb, 20, 24);
-
-        ephdif_corrections.push_back(edc_1);
+        /* two packets of dc data type and 92 bit edc */
+        ephdif_corrections.clear();
+        ephdif_corrections.push_back(packet(wrd, 60));
+        ephdif_corrections.push_back(packet(wrd, 153));
 
-        edc_1.prn = concatbin(w5.EDC_msb, extractbit(w6.EDC_msb0, 0, 1), 2);
-        edc_1.delalph = extractbit(w6.EDC_msb0, 2, 15) * P2_34;
-        edc_1.delbeta = extractbit(w6.EDC_msb0, 16, 29) * P2_34;
-        edc_1.delgamm = concatbin(extractbit(w6.EDC_msb0, 30, 31), extractbit(w7.EDC_msb1, 0, 12), 13) * P2_32;
-        edc_1.deli = extractbit(w7.EDC_msb1, 13, 24) * P2_32;
-        edc_1.delomg = concatbin(extractbit(w7.EDC_msb1, 25, 31), extractbit(w8.EDC_lsb, 0, 4), 5) * P2_32;
-        edc_1.delA = extractbit(w8.EDC_lsb, 5, 16) * P2_9;
-        edc_1.UDRAdot = extractbit(w8.EDC_lsb, 17, 21);
-
-        ephdif_corrections.push_back(edc_2);
+    }
 
+    /*
+        Edc packet, shared with message 34
+        @param pos: bit of the dc data type flag
+    */
+    static EDC packet(const uint32_t* wrd, int pos)
+    {
+        EDC e;
+        e.type    = getbitu(wrd, pos, 1);
+        e.prn     = getbitu(wrd, pos + 1, 8);
+        e.delalph = getbits(wrd, pos + 9, 14) * P2_34;
+        e.delbeta = getbits(wrd, pos + 23, 14) * P2_34;
+        e.delgamm = getbits(wrd, pos + 37, 15) * P2_32;
+        e.deli    = getbits(wrd, pos + 52, 12) * P2_32;
+        e.delomg  = getbits(wrd, pos + 64, 12) * P2_32;
+        e.delA    = getbits(wrd, pos + 76, 12) * P2_9;
+        e.UDRAdot = getbits(wrd, pos + 88, 5);
+
+        return e;
     }
     
 };
@@ -1336,7 +1373,7 @@ typedef class {
         {   
             uint32_t ISCL2C    : 7;
             uint32_t ISCL1CA   : 13;
-            uint32_t TGD       :  11;
+            uint32_t TGD       :  12;
             
             
         };
@@ -1421,12 +1458,23 @@ typedef class {
 
     public:
 
+        uint32_t TOW;
         uint32_t CRC;
         long double TGD;
+        long double ISCL1CA;
+        long double ISCL2C;
+        long double ISCL5I5;
+        long double ISCL5Q5;
         long double af0;
         long double af1;
         long double af2;
         uint32_t toc;
+        uint32_t top;         /* data predict time of week (s) */
+        int8_t URANED0;       /* non elevation dependent accuracy indices */
+        uint8_t URANED1;
+        uint8_t URANED2;
+        double alpha[4];      /* klobuchar, s, s/sc, s/sc^2, s/sc^3 */
+        double beta[4];       /* klobuchar, s, s/sc, s/sc^2, s/sc^3 */
 
         void decode(uint32_t* wrd)
         {
@@ -1441,12 +1489,31 @@ typedef class {
             w9.word = wrd[8];
             w10.word = wrd[9];
 
+            TOW = concatbin(w1.TOW, w2.TOW, 5);
             CRC = concatbin(w9.CRC, w10.CRC, 12);
-            TGD = concatbin(w4.TGD, w5.TGD, 12) * P2_35;
+            TGD = concatbin_signed_32(w4.TGD, w5.TGD, 1, 12) * P2_35;
+            ISCL1CA = concatbin_signed_32(w5.ISCL1CA, 0, 13, 0) * P2_35;
+            ISCL2C = concatbin_signed_32(w5.ISCL2C, w6.ISCL2C, 7, 6) * P2_35;
+            ISCL5I5 = concatbin_signed_32(w6.ISCL5I5, 0, 13, 0) * P2_35;
+            ISCL5Q5 = concatbin_signed_32(w6.ISCL5Q5, 0, 13, 0) * P2_35;
+
+            alpha[0] = concatbin_signed_32(w7.a0, 0, 8, 0) * P2_30;
+            alpha[1] = concatbin_signed_32(w7.a1, 0, 8, 0) * P2_27;
+            alpha[2] = concatbin_signed_32(w7.a2, 0, 8, 0) * P2_24;
+            alpha[3] = concatbin_signed_32(w7.a3, 0, 8, 0) * P2_24;
+            beta[0] = concatbin_signed_32(w8.b0, 0, 8, 0) * 2048.0;
+            beta[1] = concatbin_signed_32(w8.b1, 0, 8, 0) * 16384.0;
+            beta[2] = concatbin_signed_32(w8.b2, 0, 8, 0) * 65536.0;
+            beta[3] = concatbin_signed_32(w8.b3, 0, 8, 0) * 65536.0;
+
             af0 = concatbin_signed_32(w3.af0n,w4.af0n,25, 1) * P2_35;
             af1 = concatbin_signed_32(w4.af1n,0,20,0) * P2_48;
             af2 = concatbin_signed_32(w4.af2n,0,10,0) * P2_60;
             toc = concatbin(w2.toc, w3.toc, 7) * 300 ;
+            top = w2.top * 300;
+            URANED0 = concatbin_signed_32(w2.URANED0, 0, 5, 0);
+            URANED1 = w2.URANED1;
+            URANED2 = w2.URANED2;
 
         }
 
@@ -1501,7 +1568,7 @@ typedef struct {
         {
         
             uint32_t af0n      : 25;
-            uint32_t toc       : 11;
+            uint32_t toc       : 7;
         };
         uint32_t word;
     
@@ -1526,7 +1593,7 @@ typedef struct {
         {   
             uint32_t redAlm1   : 12; 
             uint32_t toa       :  8; 
-            uint32_t WNan      : 13; 
+            uint32_t WNan      : 12; 
             
             
         };
@@ -1605,6 +1672,50 @@ typedef struct {
     Word9   w9;
     Word10 w10;
     
+    /* Interface */
+    uint32_t TOW;
+    uint32_t CRC;
+    uint32_t toc;              /* clock data reference time */
+    long double af0;
+    long double af1;
+    long double af2;
+    uint16_t WNan;             /* almanac week number */
+    uint8_t  toa;              /* time of almanac */
+    std::vector<Msg_Type_12::reduced_almanac> redalm; /* 4 reduced almanacs */
+
+    void decode(uint32_t* wrd)
+    {
+        w1.word  = wrd[0];
+        w2.word  = wrd[1];
+        w3.word  = wrd[2];
+        w4.word  = wrd[3];
+        w5.word  = wrd[4];
+        w6.word  = wrd[5];
+        w7.word  = wrd[6];
+        w8.word  = wrd[7];
+        w9.word  = wrd[8];
+        w10.word = wrd[9];
+
+        TOW = concatbin(w1.TOW, w2.TOW, 5);
+        CRC = concatbin(w9.CRC, w10.CRC, 12);
+        af0 = concatbin_signed_32(w3.af0n,w4.af0n,25, 1) * P2_35;
+        af1 = concatbin_signed_32(w4.af1n,0,20,0) * P2_48;
+        af2 = concatbin_signed_32(w4.af2n,0,10,0) * P2_60;
+        toc = concatbin(w2.toc, w3.toc, 7) * 300;
+        WNan = concatbin(w4.WNan, w5.WNan, 12);
+        toa = w5.toa;
+
+        /* bind reduced almanac packets */
+        Msg_Type_12::raw_reduced_almanac red_alm[4];
+        red_alm[0].packet = concatbin(w5.redAlm1, w6.redAlm1, 19); //packet 1
+        red_alm[1].packet = concatbin(w6.redAlm2, w7.redAlm2, 18); //packet 2
+        red_alm[2].packet = concatbin(w7.redAlm3, w8.redAlm3, 17); //packet 3
+        red_alm[3].packet = concatbin(w8.redAlm4, w9.redAlm4, 16); //packet 4
+
+        for(auto& it: red_alm)
+            redalm.push_back(Msg_Type_12::scale(it));
+    }
+
 } Msg_Type_31;
  
 
@@ -1653,7 +1764,7 @@ typedef struct {
         struct
         {
             uint32_t af0n      : 25;
-            uint32_t toc       : 11;
+            uint32_t toc       :  7;
         
         };
         uint32_t word;
@@ -1688,6 +1799,7 @@ typedef struct {
     {
         struct
         {
+            uint32_t PM_Y         : 13;
             uint32_t PM_Xdot      : 15; 
             uint32_t PM_X         : 4; 
         };
@@ -1754,7 +1866,9 @@ typedef struct {
 
     public:
 
+        uint32_t TOW;
         uint32_t CRC;
+        uint32_t toc;
         long double af0;
         long double af1;
         long double af2;
@@ -1762,6 +1876,15 @@ typedef struct {
         long double URANED1;
         long double URANED2;
 
+        /* earth orientation parameters */
+        uint32_t tEOP;        /* eop data reference time (s) */
+        double PM_X;          /* polar motion x (arcsec) */
+        double PM_Xdot;       /* (arcsec/day) */
+        double PM_Y;          /* polar motion y (arcsec) */
+        double PM_Ydot;       /* (arcsec/day) */
+        double deltaUTGPS;    /* ut1 - gps (s) */
+        double deltaUTGPSdot; /* (s/day) */
+
         void decode(uint32_t* wrd)
         {
             w1.word  = wrd[0];
@@ -1775,12 +1898,20 @@ typedef struct {
             w9.word  = wrd[8];
             w10.word = wrd[9];
 
+            TOW = concatbin(w1.TOW, w2.TOW, 5);
             CRC = concatbin(w9.CRC, w10.CRC, 12);
-            af0 = concatbin(w3.af0n, w4.af0n, 1);
-
-            af1 = w4.af1n * P2_48;
-            af2 = w4.af2n * P2_60;
-            af0 *= P2_35;
+            toc = concatbin(w2.toc, w3.toc, 7) * 300;
+            af0 = concatbin_signed_32(w3.af0n, w4.af0n, 25, 1) * P2_35;
+            af1 = concatbin_signed_32(w4.af1n, 0, 20, 0) * P2_48;
+            af2 = concatbin_signed_32(w4.af2n, 0, 10, 0) * P2_60;
+
+            tEOP = concatbin(w4.tEOP, w5.tEOP, 15) * 16;
+            PM_X = concatbin_signed_32(w5.PM_X, w6.PM_X, 17, 4) * P2_20;
+            PM_Xdot = concatbin_signed_32(w6.PM_Xdot, 0, 15, 0) * P2_21;
+            PM_Y = concatbin_signed_32(w6.PM_Y, w7.PM_Y, 13, 8) * P2_20;
+            PM_Ydot = concatbin_signed_32(w7.PM_Ydot, 0, 15, 0) * P2_21;
+            deltaUTGPS = concatbin_signed_32(w7.deltaUTGPS, w8.deltaUTGPS, 9, 22) * P2_24;
+            deltaUTGPSdot = concatbin_signed_32(w8.deltaUTGPSdot, w9.deltaUTGPSdot, 10, 9) * P2_25;
 
             URANED0 = w2.URANED0;
             URANED1 = w2.URANED1;
@@ -1835,7 +1966,7 @@ typedef struct {
         struct
         {
             uint32_t af0n      : 25;
-            uint32_t toc       : 11;
+            uint32_t toc       : 7;
         
         };
         uint32_t word;
@@ -1942,10 +2073,21 @@ typedef struct {
 
     public:
 
+        uint32_t TOW;
         uint32_t CRC;
+        uint32_t toc;
         long double af0;
         long double af1;
         long double af2;
+        double A0;            /* utc bias (s) */
+        double A1;            /* utc drift (s/s) */
+        double A2;            /* utc drift rate (s/s^2) */
+        int deltatLS;         /* current leap seconds */
+        uint32_t tot;         /* utc reference time of week (s) */
+        uint32_t WNot;        /* utc reference week */
+        uint32_t WNLSF;       /* week of leap second event */
+        uint32_t DN;          /* day of week of event, 1 - 7 */
+        int deltatLSF;        /* leap seconds after event */
 
         void decode(uint32_t* wrd)
         {
@@ -1960,10 +2102,22 @@ typedef struct {
             w9.word  = wrd[8];
             w10.word = wrd[9];
 
+            TOW = concatbin(w1.TOW, w2.TOW, 5);
             CRC = concatbin(w9.CRC, w10.CRC, 12);
-            af0 = concatbin(w3.af0n,w4.af0n,1) * P2_35;
-            af1 = w4.af1n * P2_48;
-            af2 = w4.af2n * P2_60;
+            toc = concatbin(w2.toc, w3.toc, 7) * 300;
+            af0 = concatbin_signed_32(w3.af0n,w4.af0n,25, 1) * P2_35;
+            af1 = concatbin_signed_32(w4.af1n,0,20,0) * P2_48;
+            af2 = concatbin_signed_32(w4.af2n,0,10,0) * P2_60;
+
+            A0 = concatbin_signed_32(w4.A0n, w5.A0n, 1, 15) * P2_35;
+            A1 = concatbin_signed_32(w5.A1n, 0, 13, 0) * P2_51;
+            A2 = concatbin_signed_32(w5.A2n, w6.A2n, 4, 3) * P2_68;
+            deltatLS = concatbin_signed_32(w6.deltatLS, 0, 8, 0);
+            tot = w6.tot * 16;
+            WNot = concatbin(w6.WNot, w7.WNot, 8);
+            WNLSF = w7.WNLSF;
+            DN = w7.DN;
+            deltatLSF = concatbin_signed_32(w7.deltatLSF, w8.deltatLSF, 7, 1);
         }
 
 } Msg_Type_33;
@@ -2012,7 +2166,7 @@ typedef struct {
         struct
         {
             uint32_t af0n      : 25;
-            uint32_t toc       : 11;
+            uint32_t toc       : 7;
         
         };
         uint32_t word;
@@ -2113,11 +2267,16 @@ typedef struct {
     
     cdc ClockDifCor;
 
+    uint32_t TOW;
     uint32_t CRC;
-    int16_t daf0;
-    int16_t daf1;
-    int8_t UDRA;
-    uint8_t prn;
+    uint32_t toc;
+    long double af0;
+    long double af1;
+    long double af2;
+    uint32_t topD;            /* data predict time of week (s) */
+    uint32_t tOD;             /* dc data reference time (s) */
+    Msg_Type_13::CDC_scaled clockdif;
+    Msg_Type_14::EDC ephdif;
 
     /* which satellite is subject to cdc */
     void decode(uint32_t* wrd)
@@ -2133,11 +2292,20 @@ typedef struct {
         w9.word  = wrd[8]; 
         w10.word = wrd[9];
         
-        ClockDifCor.word = concatbin(w5.CDC_1, w5.CDC_1, 24);
+        TOW = concatbin(w1.TOW, w2.TOW, 5);
         CRC = concatbin(w9.CRC, w10.CRC, 12);
-        prn = ClockDifCor.prn;
-        daf0 = ClockDifCor.daf0 * P2_35;
-        daf1 = ClockDifCor.daf1 * P2_51;
+        toc = concatbin(w2.toc, w3.toc, 7) * 300;
+        af0 = concatbin_signed_32(w3.af0n,w4.af0n,25, 1) * P2_35;
+        af1 = concatbin_signed_32(w4.af1n,0,20,0) * P2_48;
+        af2 = concatbin_signed_32(w4.af2n,0,10,0) * P2_60;
+        topD = concatbin(w4.topD, w5.topD, 10) * 300;
+        tOD = w5.tOD * 300;
+
+        /* one dc data type for both packets */
+        ClockDifCor.word = concatbin(w5.CDC_1, w6.CDC_1, 24);
+        clockdif = Msg_Type_13::scale(ClockDifCor, w5.Dc_1_type);
+        ephdif = Msg_Type_14::packet(wrd, 183);
+        ephdif.type = w5.Dc_1_type;
 
 
     }
@@ -2191,7 +2359,7 @@ typedef struct {
         struct
         {
             uint32_t af0n      : 25;
-            uint32_t toc       : 11;
+            uint32_t toc       :  7;
         
         };
         uint32_t word;
@@ -2283,6 +2451,49 @@ typedef struct {
     Word8   w8;
     Word9   w9;
     Word10 w10;
+
+    uint32_t TOW;
+    uint32_t CRC;
+    uint32_t toc;
+    long double af0;
+    long double af1;
+    long double af2;
+
+    /* gps - gnss time offset */
+    uint32_t tGGTO;           /* ggto reference time of week (s) */
+    uint32_t WNGGTO;          /* ggto reference week, mod 8192 */
+    uint8_t GNSSID;           /* 0 no data, 1 galileo, 2 glonass */
+    double A0GGTO;            /* bias (s) */
+    double A1GGTO;            /* drift (s/s) */
+    double A2GGTO;            /* drift rate (s/s^2) */
+
+    void decode(uint32_t* wrd)
+    {
+        w1.word  = wrd[0];
+        w2.word  = wrd[1];
+        w3.word  = wrd[2];
+        w4.word  = wrd[3];
+        w5.word  = wrd[4];
+        w6.word  = wrd[5];
+        w7.word  = wrd[6];
+        w8.word  = wrd[7];
+        w9.word  = wrd[8];
+        w10.word = wrd[9];
+
+        TOW = concatbin(w1.TOW, w2.TOW, 5);
+        CRC = concatbin(w9.CRC, w10.CRC, 12);
+        toc = concatbin(w2.toc, w3.toc, 7) * 300;
+        af0 = concatbin_signed_32(w3.af0n, w4.af0n, 25, 1) * P2_35;
+        af1 = concatbin_signed_32(w4.af1n, 0, 20, 0) * P2_48;
+        af2 = concatbin_signed_32(w4.af2n, 0, 10, 0) * P2_60;
+
+        tGGTO = concatbin(w4.tGGTO, w5.tGGTO, 15) * 16;
+        WNGGTO = w5.WNGGTO;
+        GNSSID = w5.GNSSID;
+        A0GGTO = concatbin_signed_32(w5.A0GGTO, w6.A0GGTO, 1, 15) * P2_35;
+        A1GGTO = concatbin_signed_32(w6.A1GGTO, 0, 13, 0) * P2_51;
+        A2GGTO = concatbin_signed_32(w6.A2GGTO, w7.A2GGTO, 4, 3) * P2_68;
+    }
     
 } Msg_Type_35;
 
@@ -2463,7 +2674,7 @@ typedef struct {
         struct
         {
             uint32_t af0n      : 25;
-            uint32_t toc       : 11;
+            uint32_t toc       : 7;
         
         };
         uint32_t word;
@@ -2489,7 +2700,7 @@ typedef struct {
             uint32_t L15         :1;
             uint32_t L2         :1;          
             uint32_t L1         :1;  
-            uint32_t PRNa        : 16;
+            uint32_t PRNa        : 6;
             uint32_t tob       : 8;
             uint32_t Wnan      : 12; 
 
@@ -2548,8 +2759,8 @@ typedef struct {
     {
         struct
         {
-            uint32_t CRC        : 12;
             uint32_t pad        : 20;
+            uint32_t CRC        : 12;
         };
         uint32_t word;
     } Word10;
@@ -2565,6 +2776,67 @@ typedef struct {
     Word9   w9;
     Word10 w10;
     
+    /* Interface */
+    uint32_t TOW;
+    uint32_t CRC;
+    uint32_t toc;              /* clock data reference time */
+    long double af0;
+    long double af1;
+    long double af2;
+    uint16_t WNan;             /* almanac week number */
+    uint8_t  toa;              /* time of almanac */
+    uint8_t  PRNa;             /* almanac satellite */
+    uint8_t  L1_health;
+    uint8_t  L2_health;
+    uint8_t  L5_health;
+    double e;                  /* eccentricity */
+    double delta_i;            /* inclination relative to 0.30 (semi-circles) */
+    double OMEGA_DOT;          /* rate of right ascension (semi-circles/s) */
+    double sqrtA;              /* square root of semi major ax */
+    double OMEGA0;             /* longitude of ascending node (semi-circles) */
+    double omega;              /* argument of perigee (semi-circles) */
+    double M0;                 /* mean anomaly (semi-circles) */
+    double af0a;               /* almanac clock bias */
+    double af1a;               /* almanac clock drift */
+
+    void decode(uint32_t* wrd)
+    {
+        w1.word  = wrd[0];
+        w2.word  = wrd[1];
+        w3.word  = wrd[2];
+        w4.word  = wrd[3];
+        w5.word  = wrd[4];
+        w6.word  = wrd[5];
+        w7.word  = wrd[6];
+        w8.word  = wrd[7];
+        w9.word  = wrd[8];
+        w10.word = wrd[9];
+
+        TOW = concatbin(w1.TOW, w2.TOW, 5);
+        CRC = concatbin(w9.CRC, w10.CRC, 12);
+        af0 = concatbin_signed_32(w3.af0n,w4.af0n,25, 1) * P2_35;
+        af1 = concatbin_signed_32(w4.af1n,0,20,0) * P2_48;
+        af2 = concatbin_signed_32(w4.af2n,0,10,0) * P2_60;
+        toc = concatbin(w2.toc, w3.toc, 7) * 300;
+
+        WNan = concatbin(w4.Wnan, w5.Wnan, 12);
+        toa = w5.tob;
+        PRNa = w5.PRNa;
+        L1_health = w5.L1;
+        L2_health = w5.L2;
+        L5_health = w5.L15;
+
+        e         = concatbin(w5.e, w6.e, 8) * pow(2,-16);
+        delta_i   = concatbin_signed_32(w6.delta,0,11,0) * pow(2,-14);
+        OMEGA_DOT = concatbin_signed_32(w6.omegadot,0,11,0) * pow(2,-33);
+        sqrtA     = concatbin(w6.Asqrt, w7.Asqrt, 15) * pow(2,-4);
+        OMEGA0    = concatbin_signed_32(w7.omegadot,0,16,0) * pow(2,-15);
+        omega     = concatbin_signed_32(w7.W, w8.W, 1, 15) * pow(2,-15);
+        M0        = concatbin_signed_32(w8.M0,0,16,0) * pow(2,-15);
+        af0a      = concatbin_signed_32(w8.af0, w9.af0, 1, 10) * pow(2,-20);
+        af1a      = concatbin_signed_32(w9.af1,0,10,0) * pow(2,-37);
+    }
+
 } Msg_Type_37;
 
 
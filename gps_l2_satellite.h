@@ -16,6 +16,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fstream>
 #include <iostream>
 #include <vector>
@@ -24,6 +25,13 @@
 
 #include "gps_l2_message_types.hpp"
 #include "crc24q.h"
+#include "ephemeris_store.h"
+#include "dc_corrections.h"
+#include "gpstime_ns.h"
+
+class NdjsonSink;
+class RtcmCaster;
+class EphemerisShm;
 
 /*
 * UBX data types
@@ -32,6 +40,8 @@
 #define U2 uint16_t
 #define U4 uint32_t
 
+#define STREAM_RETAIN 8          /* messages kept per type on long lived streams */
+
 /*
 * checksum struct
 */
@@ -74,45 +84,6 @@ typedef struct
 } UbxFrame;
 
 
-/*
- * Ephemeris Message
- */
-
-typedef struct{
-
-    double clock_bias;
-    double clock_drift;
-    double clock_rate;
-    double IODE;
-    double Crs;
-    double delta_n;
-    double M0;
-    double Cuc;
-    double eccentricity;
-    double Cus;
-    double sqrtA;
-    double TOE ;
-    double Cic;
-    double OMEGA;
-    double Cis;
-    double I0;
-    double Crc;
-    double omega;
-    double OMEGA_DOT;
-    double IDOT;
-    double l2_codes;
-    double week;
-    double l2_p_flag;
-    uint8_t sv_acc;
-    uint8_t sv_health;
-    double tgd;
-    double IODC;
-    uint32_t trans_time;
-    uint8_t fit_interval;
-
-} eph;
-
-
 /*___________________________________________________
    Satellite Class:
         :binfile: stream of binary input file
@@ -120,10 +91,21 @@ typedef struct{
         :flag: if satellite sent a msg
         :eph_completed: if ephemeris msg is gathered
         :eph_mssg: ephemeris message of satellite
+        :eph_updated: new upload since last store
+        :dc_msg: 13, 14 or 34 if a dc message is
+                 not passed to corrections yet
+        :last_msg: id of the latest message that
+                   passed the checksum and crc,
+                   0 if none
+        :crc_bad: messages failing their crc24q
+        :words: 10 words of the latest frame
         :mX vectors: container for message types 
         :msgX pointers: msgX struct's ptr
         :member functions::::::::::::::::::::: 
             -sumchecks: end of msg checksums
+            -take: keep a frame as data
+            -trim: drop all but the latest
+             messages of each type
             -dec_msgX: X's unique attributes
 _____________________________________________________
 
@@ -132,9 +114,14 @@ class Satellite{
 
     public: 
     
-    UbxFrame* data;
+    UbxFrame data;
     bool flag;
     bool eph_completed;
+    bool eph_updated;
+    uint8_t dc_msg;
+    uint8_t last_msg;
+    uint32_t crc_bad;
+    uint32_t words[10];
     eph eph_mssg;
 
     std::vector<Msg_Type_10> m10;
@@ -154,6 +141,8 @@ class Satellite{
 
 
     void decode_gps_l2c(std::ifstream&);
+    void decode_words(uint32_t*);
+    void take(const UbxFrame&);
     void read_words(uint32_t*, std::ifstream& binfile);
     bool check_sum(uint32_t*);
 
@@ -170,6 +159,23 @@ class Satellite{
     void dec_msg35(uint32_t*);
     void dec_msg36(uint32_t*);
     void dec_msg37(uint32_t*);
+
+    /* keep the last n messages of each type, 0 keeps all */
+    void trim(size_t n)
+    {
+        if(n == 0) return;
+        keep_last(m10, n); keep_last(m11, n); keep_last(m12, n);
+        keep_last(m13, n); keep_last(m14, n); keep_last(m15, n);
+        keep_last(m30, n); keep_last(m31, n); keep_last(m32, n);
+        keep_last(m33, n); keep_last(m34, n); keep_last(m35, n);
+        keep_last(m36, n); keep_last(m37, n);
+    }
+
+    template <class T>
+    static void keep_last(std::vector<T>& v, size_t n)
+    {
+        if(v.size() > n) v.erase(v.begin(), v.end() - n);
+    }
     
     /*
         Time of week to time in d h m s
@@ -177,7 +183,8 @@ class Satellite{
     */
     inline void tell_time(int index = 0) const
     {
-        uint32_t sec =  m11[index].TOW*1.5*4;
+        GpsTime t = GpsTime::tow_count(0, m11[index].TOW);
+        uint32_t sec = (uint32_t)(t.tow_ns() / NS_PER_SEC);
         uint16_t end_sec = sec%60; 
         uint32_t min = sec/60;
         uint16_t end_min = min%60;
@@ -214,15 +221,18 @@ class Satellite{
     /* crc24q check 276 - 300 bits */
     uint32_t crc_check(uint32_t* wrd)
     {
-        uint8_t* bytes = new uint8_t[40];
+        uint8_t bytes[40];
         for(int i=0;i<10;i++)
          for(int j=0;j<4;j++)
              bytes[i*4 + j] = extractbit(wrd[i], j*8, (j+1)*8 - 1);
 
-        uint8_t extracted = extractbit(bytes[34], 0, 3);
-        uint32_t crc = crc24q_bits(bytes,276,false);
-        free(bytes);
-        return crc;
+        return crc24q_bits(bytes,276,false);
+    }
+
+    /* crc broadcast in bits 276 - 300 */
+    static uint32_t crc_sent(const uint32_t* wrd)
+    {
+        return (wrd[8] & 0xFFF) << 12 | wrd[9] >> 20;
     }
 
     /* print parameters of rinex format */
@@ -249,7 +259,7 @@ class Satellite{
         output << std::scientific << 
                
                /* SV / EPOCH / SV CLK */
-                "Satellite: G" << (unsigned)msg.data->svId  << std::endl
+                "Satellite: G" << (unsigned)msg.data.svId  << std::endl
 
                << "SV clock bias: " << msg.m30[index_30].af0        << std::endl
                << "SV clock drift: " << msg.m30[index_30].af1       << std::endl
@@ -320,11 +330,7 @@ class Satellite{
      * message 10, 11, 30          */
     void get_ephemeris(){
 
-        int index_11 =m11.size()-1,
-        index_10 = m10.size()-1,
-        index_30 = m30.size()-1;
-
-        std::cout << "Satellite: G" << (unsigned) data->svId  << std::endl;
+        std::cout << "Satellite: G" << (unsigned) data.svId  << std::endl;
 
         /* is ephemeris completed? */
         if(m10.size() == 0)
@@ -335,34 +341,69 @@ class Satellite{
             std::cout << "Clock parameters not received!" << std::endl;
         else{
                 std::cout << "Ephemeris data collected" << std::endl;
+                assemble_ephemeris(eph_mssg);
                 eph_completed = true;
-                eph_mssg.clock_bias = m30[index_30].af0;
-                eph_mssg.clock_drift = m30[index_30].af1;
-                eph_mssg.clock_rate = m30[index_30].af2;
-                eph_mssg.IODE = 0;
-                eph_mssg.Crs = m11[index_11].crsn;
-                eph_mssg.delta_n = m10[index_10].delntan0 * PI;
-                eph_mssg.M0 = m10[index_10].M0n * PI;
-                eph_mssg.Cuc = m11[index_11].cucn;
-                eph_mssg.eccentricity = m10[index_10].en;
-                eph_mssg.Cus = m11[index_11].cusn;
-                eph_mssg.sqrtA = sqrt(m10[index_10].deltaA + AREF);
-                eph_mssg.TOE = m10[index_10].toe;
-                eph_mssg.Cic = m11[index_11].cicn;
-                eph_mssg.OMEGA = m11[index_11].omega0n * PI;
-                eph_mssg.Cis = m11[index_11].cisn;
-                eph_mssg.I0 = m11[index_11].i0n * PI;
-                eph_mssg.Crc = m11[index_11].crcn;
-                eph_mssg.omega = m10[index_10].omegan * PI;
-                eph_mssg.OMEGA_DOT = (m11[index_11].delomegadot + OMEGADOTREF) * PI;
-                eph_mssg.IDOT = m11[index_11].i0nDOT * PI;
-                eph_mssg.week = m10[index_10].WN;
-                eph_mssg.l2_p_flag = 0;
-                eph_mssg.tgd = m30[index_30].TGD;
-                eph_mssg.IODC = 0;
         }
     }
 
+    /* fill ephemeris from latest
+     * message 10, 11, 30          */
+    void assemble_ephemeris(eph& e) const
+    {
+        int index_11 =m11.size()-1,
+        index_10 = m10.size()-1,
+        index_30 = m30.size()-1;
+
+        e.clock_bias = m30[index_30].af0;
+        e.clock_drift = m30[index_30].af1;
+        e.clock_rate = m30[index_30].af2;
+        e.IODE = 0;
+        e.Crs = m11[index_11].crsn;
+        e.delta_n = m10[index_10].delntan0 * PI;
+        e.M0 = m10[index_10].M0n * PI;
+        e.Cuc = m11[index_11].cucn;
+        e.eccentricity = m10[index_10].en;
+        e.Cus = m11[index_11].cusn;
+        e.sqrtA = sqrt(m10[index_10].deltaA + AREF);
+        e.TOE = m10[index_10].toe;
+        e.Cic = m11[index_11].cicn;
+        e.OMEGA = m11[index_11].omega0n * PI;
+        e.Cis = m11[index_11].cisn;
+        e.I0 = m11[index_11].i0n * PI;
+        e.Crc = m11[index_11].crcn;
+        e.omega = m10[index_10].omegan * PI;
+        e.OMEGA_DOT = (m11[index_11].delomegadot + OMEGADOTREF) * PI;
+        e.IDOT = m11[index_11].i0nDOT * PI;
+        e.week = m10[index_10].WN;
+        e.l2_p_flag = 0;
+        e.sv_acc = ura_index_ed(m10[index_10].URAi);
+        e.sv_health = m10[index_10].L1_health << 2 | m10[index_10].L2_health << 1
+                    | m10[index_10].L5_health;
+        e.tgd = m30[index_30].TGD;
+        e.IODC = 0;
+        e.fit_interval = EPH_FIT_HOURS;
+        e.Adot = m10[index_10].Adot;
+        e.delta_n_dot = m10[index_10].deln0dot * PI;
+        e.toc = m30[index_30].toc;
+    }
+
+    /* a new upload is complete when message
+     * 10 and 11 of the same toe and a 30 are
+     * received                               */
+    void update_ephemeris()
+    {
+        if(m10.empty() || m11.empty() || m30.empty()) return;
+        if(m10.back().toe != m11.back().toe) return;
+
+        eph e = eph();
+        assemble_ephemeris(e);
+        if(!eph_completed || e.TOE != eph_mssg.TOE || e.week != eph_mssg.week)
+            eph_updated = true;
+
+        eph_mssg = e;
+        eph_completed = true;
+    }
+
     /* write to file in rinex 3.04 format */
     void rinex_formatter(std::string output_file)
     {
@@ -381,7 +422,7 @@ class Satellite{
 
                     fileStream
                     //<< "G"
-                    << (unsigned) data->svId << " " <<
+                    << (unsigned) data.svId << " " <<
                     21 << " " << 13 << " " << 7 << " " << 12 << " " << 0 << " " << 0 << " "
                     << std::setprecision(12) << std::scientific
                     << eph_mssg.clock_bias
@@ -421,13 +462,14 @@ class Satellite{
 
 
     Satellite(){
-        data = NULL;
+        memset(&data, 0, sizeof data);
         flag = false;
         eph_completed = false;
-    }
-
-    ~Satellite(){
-        free(data);
+        eph_updated = false;
+        dc_msg = 0;
+        last_msg = 0;
+        crc_bad = 0;
+        memset(words, 0, sizeof words);
     }
 
     
@@ -437,10 +479,24 @@ class Satellite{
    SatelliteFile Class:
         :binfile: stream of binary input file
         :satellite: 1-32 gps satellites array
+        :ephemerides: every completed upload by PRN
+        :corrections: cdc/edc applied to ephemerides
+        :sink: json lines of every decoded message
+               and upload, NULL for none
+        :caster: rtcm 1019 of each store change,
+                 NULL for none
+        :shm: shared memory of the latest uploads
+              and message 30, NULL for none
+        :retain: messages of each type a satellite
+                 keeps after a frame, 0 keeps all
         :mX vectors: container for message types
         :member functions:::::::::::::::::::::
             -gps_file: extract from binary file
             -find_msg: find gps msgs in binary
+            -decode_frame: decode a frame already
+             in memory and publish its results
+            -merge_frame: publish a frame whose
+             satellite a worker decoded
             -msg_count: msg count of satellites
 ___________________________________________________
 
@@ -449,11 +505,19 @@ class SatelliteFile{
 
     public:
     Satellite* satellite[33];
+    EphemerisStore ephemerides;
+    DcCorrections corrections;
+    NdjsonSink* sink;
+    RtcmCaster* caster;
+    EphemerisShm* shm;
+    size_t retain;
     std::ifstream binfile;
     void gps_file(std::string&);
     bool find_message();
+    bool decode_frame(const UbxFrame&, uint32_t*);
+    void merge_frame(int, int, uint32_t*, const eph*);
 
-    SatelliteFile()
+    SatelliteFile() : corrections(ephemerides), sink(NULL), caster(NULL), shm(NULL), retain(0)
     {
         for (int i = 1 ; i <= 32 ; i++)
             satellite[i] = new Satellite();
@@ -462,14 +526,14 @@ class SatelliteFile{
     ~SatelliteFile(){
         for (int i = 1 ; i <= 32 ; i++)
         {
-            free(satellite[i]);
+            delete satellite[i];
             satellite[i] = NULL;
         }
     }
 
     void msg_count(int sat)
     {
-        std::cout << "Satellite: " << (unsigned)satellite[sat]->data->svId << std::endl;
+        std::cout << "Satellite: " << (unsigned)satellite[sat]->data.svId << std::endl;
         std::cout << "Count 10 " << satellite[sat]->m10.size() << std::endl;
         std::cout << "Count 11 " << satellite[sat]->m11.size() << std::endl;
         std::cout << "Count 15 " << satellite[sat]->m15.size() << std::endl;
@@ -490,9 +554,7 @@ void Satellite::dec_msg10(uint32_t* wrd)
     Msg_Type_10 m;
     m.decode(wrd);    
     m10.push_back(m);
-
-    uint32_t crc = crc_check(wrd);
-    if(m.CRC != crc) std::cout << "Crc does not match" << std::endl;
+    update_ephemeris();
 
 }
 
@@ -505,9 +567,7 @@ void Satellite::dec_msg11(uint32_t* wrd)
     Msg_Type_11 m;
     m.decode(wrd);
     m11.push_back(m);
-
-    uint32_t crc = crc_check(wrd);
-    if(m.CRC != crc) std::cout << "Crc does not match" << std::endl;
+    update_ephemeris();
 
 }
 
@@ -521,9 +581,6 @@ void Satellite::dec_msg12(uint32_t* wrd)
     Msg_Type_12 m;
     m.decode(wrd);    
     m12.push_back(m);
-
-    uint32_t crc = crc_check(wrd);
-    if(m.CRC != crc) std::cout << "Crc does not match" << std::endl;
 }
 
 /*
@@ -535,9 +592,7 @@ void Satellite::dec_msg13(uint32_t* wrd)
     Msg_Type_13 m;
     m.decode(wrd);
     m13.push_back(m);
-
-    uint32_t crc = crc_check(wrd);
-    if(m.CRC != crc) std::cout << "Crc does not match" << std::endl;
+    dc_msg = 13;
 }
 
 /*
@@ -547,17 +602,9 @@ void Satellite::dec_msg13(uint32_t* wrd)
 void Satellite::dec_msg14(uint32_t* wrd){
 
     Msg_Type_14 m;
-    m.w1.word = wrd[0];
-    m.w2.word = wrd[1];
-    m.w3.word = wrd[2];
-    m.w4.word = wrd[3];
-    m.w5.word = wrd[4];
-    m.w6.word = wrd[5];
-    m.w7.word = wrd[6];
-    m.w8.word = wrd[7];
-    m.w9.word = wrd[8]; 
-    m.w10.word = wrd[9];    
-    m14.push_back(m); 
+    m.decode(wrd);
+    m14.push_back(m);
+    dc_msg = 14;
 
 }
 
@@ -569,10 +616,8 @@ void Satellite::dec_msg30(uint32_t* wrd)
 {
     Msg_Type_30 m;
     m.decode(wrd);
-    m30.push_back(m); 
-
-    uint32_t crc = crc_check(wrd);
-    if(m.CRC != crc) std::cout << "Crc does not match" << std::endl;
+    m30.push_back(m);
+    update_ephemeris(); 
 
 }
 
@@ -583,17 +628,8 @@ void Satellite::dec_msg30(uint32_t* wrd)
 void Satellite::dec_msg31(uint32_t* wrd)
 {
     Msg_Type_31 m;
-    m.w1.word = wrd[0];
-    m.w2.word = wrd[1];
-    m.w3.word = wrd[2];
-    m.w4.word = wrd[3];
-    m.w5.word = wrd[4];
-    m.w6.word = wrd[5];
-    m.w7.word = wrd[6];
-    m.w8.word = wrd[7];
-    m.w9.word = wrd[8]; 
-    m.w10.word = wrd[9];
-    m31.push_back(m); 
+    m.decode(wrd);
+    m31.push_back(m);
 
 }
 
@@ -606,8 +642,6 @@ void Satellite::dec_msg32(uint32_t* wrd){
     Msg_Type_32 m;
     m.decode(wrd);
     m32.push_back(m); 
-    uint32_t crc = crc_check(wrd);
-    if(m.CRC != crc) std::cout << "Crc does not match" << std::endl;
 }
 
 /*
@@ -619,8 +653,6 @@ void Satellite::dec_msg33(uint32_t* wrd)
     Msg_Type_33 m;
     m.decode(wrd);
     m33.push_back(m); 
-    uint32_t crc = crc_check(wrd);
-    if(m.CRC != crc) std::cout << "Crc does not match" << std::endl;
 
 }
 
@@ -632,10 +664,8 @@ void Satellite::dec_msg34(uint32_t* wrd)
 {
     Msg_Type_34 m;
     m.decode(wrd);
-    m34.push_back(m); 
-    
-    uint32_t crc = crc_check(wrd);
-    if(m.CRC != crc) std::cout << "Crc does not match" << std::endl;
+    m34.push_back(m);
+    dc_msg = 34;
 
 }
 
@@ -646,16 +676,7 @@ void Satellite::dec_msg34(uint32_t* wrd)
 void Satellite::dec_msg35(uint32_t* wrd)
 {
     Msg_Type_35 m;
-    m.w1.word = wrd[0];
-    m.w2.word = wrd[1];
-    m.w3.word = wrd[2];
-    m.w4.word = wrd[3];
-    m.w5.word = wrd[4];
-    m.w6.word = wrd[5];
-    m.w7.word = wrd[6];
-    m.w8.word = wrd[7];
-    m.w9.word = wrd[8]; 
-    m.w10.word = wrd[9];
+    m.decode(wrd);
     m35.push_back(m); 
 
 }
@@ -688,17 +709,8 @@ void Satellite::dec_msg36(uint32_t* wrd)
 void Satellite::dec_msg37(uint32_t* wrd)
 {
     Msg_Type_37 m;
-    m.w1.word = wrd[0];
-    m.w2.word = wrd[1];
-    m.w3.word = wrd[2];
-    m.w4.word = wrd[3];
-    m.w5.word = wrd[4];
-    m.w6.word = wrd[5];
-    m.w7.word = wrd[6];
-    m.w8.word = wrd[7];
-    m.w9.word = wrd[8]; 
-    m.w10.word = wrd[9];    
-    m37.push_back(m); 
+    m.decode(wrd);
+    m37.push_back(m);
 
 }
 
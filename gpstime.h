@@ -1,3 +1,6 @@
+#ifndef GPS_TIME_H
+#define GPS_TIME_H
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -16,9 +19,9 @@ static double timeoffset_=0.0;        /* time offset (s) */
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-#endif
-
+#else
 #include <windows.h>
+#endif
 #include <stdio.h>
 
 typedef struct {        /* time struct */
@@ -73,6 +76,31 @@ extern gtime_t epoch2time(const double *ep)
     return time;
 }
 
+/* time to calendar day/time -------------------------------------------------
+* convert gtime_t struct to calendar day/time
+* args   : gtime_t t        I   gtime_t struct
+*          double *ep       O   day/time {year,month,day,hour,min,sec}
+* return : none
+* notes  : proper in 1970-2037 or 1970-2099 (64bit time_t)
+*-----------------------------------------------------------------------------*/
+extern void time2epoch(gtime_t t, double *ep)
+{
+    const int mday[]={ /* # of days in a month */
+        31,28,31,30,31,30,31,31,30,31,30,31,31,28,31,30,31,30,31,31,30,31,30,31,
+        31,29,31,30,31,30,31,31,30,31,30,31,31,28,31,30,31,30,31,31,30,31,30,31
+    };
+    int days,sec,mon,day;
+    
+    /* leap year if year%4==0 in 1901-2099 */
+    days=(int)(t.time/86400);
+    sec=(int)(t.time-(time_t)days*86400);
+    for (day=days%1461,mon=0;mon<48;mon++) {
+        if (day>=mday[mon]) day-=mday[mon]; else break;
+    }
+    ep[0]=1970+days/1461*4+mon/12; ep[1]=mon%12+1; ep[2]=day+1;
+    ep[3]=sec/3600; ep[4]=sec%3600/60; ep[5]=sec%60+t.sec;
+}
+
 /* gps time to time ------------------------------------------------------------
 * convert week and tow in gps time to gtime_t struct
 * args   : int    week      I   week number in gps time
@@ -166,6 +194,23 @@ extern gtime_t timeget(void)
 }
 
 
+/* session gps week ------------------------------------------------------------
+* gps week number of cpu time, read once per session
+* return : gps week number
+*-----------------------------------------------------------------------------*/
+static int cpuweek(void)
+{
+    int w;
+    (void)time2gpst(utc2gpst(timeget()),&w);
+    if (w<1560) w=1560; /* use 2009/12/1 if time is earlier than 2009/12/1 */
+    return w;
+}
+extern int sessionweek(void)
+{
+    static const int w=cpuweek();
+    return w;
+}
+
 /* adjust gps week number ------------------------------------------------------
 * adjust gps week number using cpu time
 * args   : int   week       I   not-adjusted gps week number
@@ -173,8 +218,8 @@ extern gtime_t timeget(void)
 *-----------------------------------------------------------------------------*/
 extern int adjgpsweek(int week)
 {
-    int w;
-    (void)time2gpst(utc2gpst(timeget()),&w);
-    if (w<1560) w=1560; /* use 2009/12/1 if time is earlier than 2009/12/1 */
+    int w=sessionweek();
     return week+(w-week+512)/1024*1024;
-}
\ No newline at end of file
+}
+
+#endif
\ No newline at end of file
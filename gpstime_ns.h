@@ -0,0 +1,148 @@
+/****************************************
+ *
+ *   Nanosecond gps time
+ *   Gps time as int64 nanoseconds since
+ *   1980/1/6 00:00:00 gpst, with week/tow
+ *   construction at compile time and
+ *   integer arithmetic
+ *
+ *   Truncated week numbers are resolved
+ *   against a week taken from the system
+ *   clock once per session
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef GPS_TIME_NS_H
+#define GPS_TIME_NS_H
+
+#include <stdint.h>
+
+#include "gpstime.h"
+
+#define NS_PER_SEC    1000000000LL
+#define NS_PER_DAY    (86400LL * NS_PER_SEC)
+#define NS_PER_WEEK   (604800LL * NS_PER_SEC)
+#define CNAV_TOW_NS   (6LL * NS_PER_SEC)       /* cnav tow count unit */
+
+
+/* seconds to ns, rounded */
+constexpr int64_t gps_ns(double sec)
+{
+    return (int64_t)(sec * 1E9 + (sec < 0 ? -0.5 : 0.5));
+}
+
+
+/*___________________________________________________
+   GpsTime Class:
+        :ns: nanoseconds since the gps epoch
+        :member functions:::::::::::::::::::::
+            -week_tow, week_sec, tow_count: build
+             from week and time of week
+            -week, tow_ns, tow: split back
+            -seconds: seconds since the gps epoch
+            -to_gtime, from_gtime: gtime_t bridge
+_____________________________________________________
+
+*/
+class GpsTime{
+
+    public:
+
+    int64_t ns;
+
+    constexpr GpsTime() : ns(0) {}
+    constexpr explicit GpsTime(int64_t nanos) : ns(nanos) {}
+
+    /* week and time of week (ns) */
+    static constexpr GpsTime week_tow(int week, int64_t tow_ns)
+    {
+        return GpsTime(week * NS_PER_WEEK + tow_ns);
+    }
+
+    /* week and time of week (s), rounded to ns */
+    static constexpr GpsTime week_sec(int week, double sec)
+    {
+        return GpsTime(week * NS_PER_WEEK + gps_ns(sec));
+    }
+
+    /* week and cnav tow count (6 s units) */
+    static constexpr GpsTime tow_count(int week, uint32_t count)
+    {
+        return GpsTime(week * NS_PER_WEEK + count * CNAV_TOW_NS);
+    }
+
+    /* floor division, no branch on the sign */
+    constexpr int week() const
+    {
+        int64_t q = ns / NS_PER_WEEK;
+        return (int)(q - (ns % NS_PER_WEEK < 0));
+    }
+
+    constexpr int64_t tow_ns() const
+    {
+        int64_t r = ns % NS_PER_WEEK;
+        return r + NS_PER_WEEK * (r < 0);
+    }
+
+    constexpr double tow() const { return tow_ns() * 1E-9; }
+
+    constexpr double seconds() const
+    {
+        /* whole and fraction apart, keeps ns resolution in the double */
+        return (double)(ns / NS_PER_SEC) + (double)(ns % NS_PER_SEC) * 1E-9;
+    }
+
+    gtime_t to_gtime() const
+    {
+        static const time_t t0 = epoch2time(gpst0).time;
+        int64_t s = ns / NS_PER_SEC, f = ns % NS_PER_SEC;
+        s -= (f < 0);
+        f += NS_PER_SEC * (f < 0);
+
+        gtime_t t;
+        t.time = t0 + (time_t)s;
+        t.sec = f * 1E-9;
+        return t;
+    }
+
+    static GpsTime from_gtime(gtime_t t)
+    {
+        static const time_t t0 = epoch2time(gpst0).time;
+        return GpsTime((int64_t)(t.time - t0) * NS_PER_SEC + gps_ns(t.sec));
+    }
+
+    constexpr GpsTime operator+(int64_t d) const { return GpsTime(ns + d); }
+    constexpr GpsTime operator-(int64_t d) const { return GpsTime(ns - d); }
+    constexpr int64_t operator-(GpsTime o) const { return ns - o.ns; }
+    constexpr GpsTime& operator+=(int64_t d) { ns += d; return *this; }
+    constexpr GpsTime& operator-=(int64_t d) { ns -= d; return *this; }
+
+    constexpr bool operator==(GpsTime o) const { return ns == o.ns; }
+    constexpr bool operator!=(GpsTime o) const { return ns != o.ns; }
+    constexpr bool operator< (GpsTime o) const { return ns <  o.ns; }
+    constexpr bool operator<=(GpsTime o) const { return ns <= o.ns; }
+    constexpr bool operator> (GpsTime o) const { return ns >  o.ns; }
+    constexpr bool operator>=(GpsTime o) const { return ns >= o.ns; }
+
+};
+
+
+/* full gps week ---------------------------------------------------------------
+* resolve a week number broadcast modulo 2^bits against the session week,
+* the cpu time is read on the first call only
+* args   : int   week       I   truncated week number
+*          int   bits       I   broadcast width, 13 cnav, 10 lnav
+* return : full week number
+*-----------------------------------------------------------------------------*/
+inline int full_week(int week, int bits = 13)
+{
+    int mod = 1 << bits;
+    return week + (sessionweek() - week + mod / 2) / mod * mod;
+}
+
+
+#endif
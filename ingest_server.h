@@ -0,0 +1,431 @@
+/****************************************
+ *
+ *   Ingest server
+ *   One epoll loop serving the receivers
+ *   of a site, each streaming UBX over
+ *   tcp or udp
+ *
+ *   Every stream owns a byte ring, a
+ *   framer and a SatelliteFile, tcp bytes
+ *   are read straight into the ring. Udp
+ *   streams are told apart by sender and
+ *   dropped once the sender goes quiet.
+ *   Listeners set SO_REUSEPORT, servers on
+ *   several threads bound to one port
+ *   share its connections
+ *
+ *   Linux only
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef INGEST_SERVER_H
+#define INGEST_SERVER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "ubx_framer.h"
+#include "decode_queue.h"
+
+#define INGEST_EVENTS 256        /* events per epoll_wait */
+#define INGEST_DGRAM  65536      /* largest udp datagram */
+#define INGEST_IDLE   60000      /* udp sender silence before its stream goes (ms) */
+
+
+/*___________________________________________________
+   IngestStream Struct:
+        :fd: tcp socket, the shared udp
+             socket for udp senders
+        :peer: sender address, ip:port
+        :bytes: bytes received
+        :last: steady ms of the last datagram
+        :file: decoded stream, satellites keep
+               the latest STREAM_RETAIN messages
+               of each type
+_____________________________________________________
+
+*/
+struct IngestStream{
+
+    int fd;
+    bool udp;
+    std::string peer;
+    size_t bytes;
+    int64_t last;
+    ByteRing ring;
+    UbxFramer framer;
+    SatelliteFile file;
+
+    IngestStream(int fd, bool udp, const sockaddr_in& addr, size_t ring_bytes)
+        : fd(fd), udp(udp), bytes(0), last(0), ring(ring_bytes)
+    {
+        file.retain = STREAM_RETAIN;
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof ip);
+        peer = std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
+    }
+
+};
+
+
+/*___________________________________________________
+   IngestServer Class:
+        Single threaded, one instance per
+        shard
+        :queue: if set, frames wait in it and
+                each poll decodes up to its
+                budget by priority, otherwise
+                they are decoded as read
+        :udp_idle_ms: silence after which a udp
+                      sender's stream is dropped,
+                      a restarted receiver comes
+                      back from a new port
+        :member functions:::::::::::::::::::::
+            -tcp, udp: listen on host:port
+            -poll: one epoll wait, reads and
+             decodes every ready stream
+            -streams: open streams
+            -close
+_____________________________________________________
+
+*/
+class IngestServer{
+
+    public:
+
+    DecodeQueue<IngestStream>* queue;
+    int64_t udp_idle_ms;
+
+    explicit IngestServer(size_t ring_bytes = RING_BYTES)
+        : queue(NULL), udp_idle_ms(INGEST_IDLE), ring_bytes(ring_bytes),
+          ep(epoll_create1(EPOLL_CLOEXEC)), dgram(NULL), swept(0)
+    {
+        /* room for a whole frame after every scan */
+        if(this->ring_bytes < 2 * (UBX_HEAD + UBX_MAXLEN + 2))
+            this->ring_bytes = 2 * (UBX_HEAD + UBX_MAXLEN + 2);
+    }
+
+    ~IngestServer()
+    {
+        close();
+        ::close(ep);
+        delete[] dgram;
+    }
+
+    /* @return port bound, 0 on failure, port 0 picks one */
+    int tcp(int port, const char* host = "127.0.0.1")
+    {
+        int s = bound(SOCK_STREAM, port, host);
+        if(s < 0) return 0;
+        if(::listen(s, SOMAXCONN) != 0){ ::close(s); return 0; }
+        watch(s, EPOLLIN);
+        listeners.push_back(s);
+        return local_port(s);
+    }
+
+    int udp(int port, const char* host = "127.0.0.1")
+    {
+        int s = bound(SOCK_DGRAM, port, host);
+        if(s < 0) return 0;
+        if(dgram == NULL) dgram = new uint8_t[INGEST_DGRAM];
+        watch(s, EPOLLIN);
+        udp_sockets.push_back(s);
+        return local_port(s);
+    }
+
+    /*
+        Wait up to timeout for ready sockets and
+        decode what they brought
+        @param decoded: called as decoded(stream, prn)
+                        after each decoded frame
+        @return frames decoded, -1 on epoll error
+    */
+    template <class F>
+    int poll(int timeout_ms, F decoded)
+    {
+        epoll_event ev[INGEST_EVENTS];
+        int k = epoll_wait(ep, ev, INGEST_EVENTS, queue && !queue->empty() ? 0 : timeout_ms);
+        if(k < 0) return errno == EINTR ? 0 : -1;
+
+        int n = 0;
+        for(int i = 0 ; i < k ; i++)
+        {
+            int fd = ev[i].data.fd;
+            if(is_listener(fd)) accept_all(fd);
+            else if(is_udp(fd)) n += datagrams(fd, decoded);
+            else{
+                auto it = tcp_streams.find(fd);
+                if(it != tcp_streams.end()) n += receive(it->second, decoded);
+            }
+        }
+        if(queue) n += drain(decoded);
+        expire();
+        if(queue) reap();
+        return n;
+    }
+
+    int poll(int timeout_ms)
+    {
+        return poll(timeout_ms, [](IngestStream&, int){});
+    }
+
+    size_t streams() const { return tcp_streams.size() + udp_streams.size(); }
+
+    void close()
+    {
+        if(queue){
+            for(auto& it: tcp_streams) queue->purge(it.second);
+            for(auto& it: udp_streams) queue->purge(it.second);
+        }
+        for(auto& it: tcp_streams){ ::close(it.first); delete it.second; }
+        for(auto& it: udp_streams) delete it.second;
+        for(IngestStream* st: closing){ if(queue) queue->purge(st); delete st; }
+        for(int s: listeners) ::close(s);
+        for(int s: udp_sockets) ::close(s);
+        tcp_streams.clear();
+        udp_streams.clear();
+        closing.clear();
+        listeners.clear();
+        udp_sockets.clear();
+    }
+
+    private:
+
+    size_t ring_bytes;
+    int ep;
+    uint8_t* dgram;
+    std::vector<int> listeners;
+    std::vector<int> udp_sockets;
+    std::unordered_map<int, IngestStream*> tcp_streams;
+    std::unordered_map<uint64_t, IngestStream*> udp_streams;   /* socket, ip, port */
+    std::vector<IngestStream*> closing;                        /* hung up, frames queued */
+    int64_t swept;                                             /* ms of the last idle sweep */
+
+    static int64_t now_ms()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void nonblocking(int s)
+    {
+        fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    static int local_port(int s)
+    {
+        sockaddr_in addr;
+        socklen_t len = sizeof addr;
+        getsockname(s, (sockaddr*)&addr, &len);
+        return ntohs(addr.sin_port);
+    }
+
+    int bound(int type, int port, const char* host)
+    {
+        int s = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+        if(s < 0) return -1;
+
+        int on = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+        setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &on, sizeof on);
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        inet_pton(AF_INET, host, &addr.sin_addr);
+
+        if(bind(s, (sockaddr*)&addr, sizeof addr) != 0){
+            std::cout << "Ingest can not bind " << host << ":" << port << std::endl;
+            ::close(s);
+            return -1;
+        }
+        nonblocking(s);
+        return s;
+    }
+
+    void watch(int fd, uint32_t events)
+    {
+        epoll_event ev;
+        memset(&ev, 0, sizeof ev);
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    bool is_listener(int fd) const
+    {
+        for(int s: listeners) if(s == fd) return true;
+        return false;
+    }
+
+    bool is_udp(int fd) const
+    {
+        for(int s: udp_sockets) if(s == fd) return true;
+        return false;
+    }
+
+    void accept_all(int server)
+    {
+        sockaddr_in addr;
+        socklen_t len = sizeof addr;
+        int c;
+        while((c = accept4(server, (sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+        {
+            int on = 1;
+            setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+            tcp_streams[c] = new IngestStream(c, false, addr, ring_bytes);
+            watch(c, EPOLLIN | EPOLLRDHUP);
+            len = sizeof addr;
+        }
+    }
+
+    /*
+        One readv into the ring's free space per
+        event, level triggered so a busy receiver
+        can not starve the others
+    */
+    template <class F>
+    int receive(IngestStream* st, F& decoded)
+    {
+        uint8_t* p[2];
+        size_t len[2];
+        int blocks = st->ring.spans(p, len);
+
+        iovec iov[2];
+        for(int i = 0 ; i < blocks ; i++){ iov[i].iov_base = p[i]; iov[i].iov_len = len[i]; }
+
+        ssize_t k = readv(st->fd, iov, blocks);
+        if(k == 0 || (k < 0 && errno != EAGAIN && errno != EINTR)){
+            drop(st);
+            return 0;
+        }
+        if(k < 0) return 0;
+
+        st->ring.commit((size_t)k);
+        st->bytes += (size_t)k;
+        return frames(st, decoded);
+    }
+
+    /* a stream with queued frames lives until they are decoded */
+    void drop(IngestStream* st)
+    {
+        epoll_ctl(ep, EPOLL_CTL_DEL, st->fd, NULL);
+        ::close(st->fd);
+        tcp_streams.erase(st->fd);
+        if(queue && queue->waiting(st)) closing.push_back(st);
+        else delete st;
+    }
+
+    /* udp streams whose sender was quiet for udp_idle_ms, once a second */
+    void expire()
+    {
+        if(udp_streams.empty()) return;
+        int64_t t = now_ms();
+        if(t - swept < 1000) return;
+        swept = t;
+
+        for(auto it = udp_streams.begin() ; it != udp_streams.end() ; )
+        {
+            IngestStream* st = it->second;
+            if(t - st->last < udp_idle_ms){ ++it; continue; }
+            it = udp_streams.erase(it);
+            if(queue && queue->waiting(st)) closing.push_back(st);
+            else delete st;
+        }
+    }
+
+    void reap()
+    {
+        for(size_t i = 0 ; i < closing.size() ; )
+        {
+            if(queue->waiting(closing[i])){ i++; continue; }
+            delete closing[i];
+            closing[i] = closing.back();
+            closing.pop_back();
+        }
+    }
+
+    /* every queued datagram, each to the stream of its sender */
+    template <class F>
+    int datagrams(int s, F& decoded)
+    {
+        int n = 0;
+        sockaddr_in addr;
+        socklen_t len = sizeof addr;
+        ssize_t k;
+        while((k = recvfrom(s, dgram, INGEST_DGRAM, 0, (sockaddr*)&addr, &len)) >= 0)
+        {
+            uint64_t key = (uint64_t)s << 48 | (uint64_t)ntohl(addr.sin_addr.s_addr) << 16
+                         | ntohs(addr.sin_port);
+            IngestStream*& st = udp_streams[key];
+            if(st == NULL) st = new IngestStream(s, true, addr, ring_bytes);
+            st->last = now_ms();
+
+            for(size_t at = 0 ; at < (size_t)k ; )
+            {
+                size_t m = st->ring.space() < (size_t)k - at ? st->ring.space() : (size_t)k - at;
+                st->ring.write(dgram + at, m);
+                at += m;
+                n += frames(st, decoded);
+            }
+            st->bytes += (size_t)k;
+            len = sizeof addr;
+        }
+        return n;
+    }
+
+    /* complete frames of a ring, decoded now or queued */
+    template <class F>
+    int frames(IngestStream* st, F& decoded)
+    {
+        if(queue == NULL)
+            return st->framer.scan(st->ring, st->file, [&](int prn){ decoded(*st, prn); });
+
+        st->framer.each(st->ring, [&](const uint8_t* f, size_t len)
+        {
+            frame_view v;
+            if(UbxFramer::view(f, len, v)) queue->push(st, v);
+        });
+        return 0;
+    }
+
+    /* up to the policy budget, highest class first */
+    template <class F>
+    int drain(F& decoded)
+    {
+        int n = 0;
+        IngestStream* st;
+        frame_view v;
+        while((size_t)n < queue->policy.budget && queue->pop(st, v))
+        {
+            st->file.decode_frame(v.head, v.words);
+            st->framer.frames++;
+            n++;
+            decoded(*st, (int)v.head.svId);
+        }
+        return n;
+    }
+
+};
+
+
+#endif
@@ -0,0 +1,226 @@
+/****************************************
+ *
+ *   Iono engine
+ *   Broadcast klobuchar ionospheric
+ *   delay from message 30 parameters
+ *   IS-GPS-200 20.3.3.5.2.5
+ *
+ *   Observations are passed as arrays
+ *   of latitude, longitude, azimuth,
+ *   elevation and time so the model
+ *   loop vectorizes across them
+ *   (build with -O3 -fopenmp-simd and
+ *   -mavx2 or better)
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef IONO_ENGINE_H
+#define IONO_ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include <cmath>
+
+#include "gps_l2_satellite.h"
+#include "orbit_engine.h"
+
+#define CLIGHT        299792458.0       /* speed of light (m/s) */
+#define FREQ_L1       1575.42E6         /* L1 frequency (Hz) */
+#define FREQ_L2       1227.60E6         /* L2 frequency (Hz) */
+#define IONO_L2_SCALE 1.6469444444444   /* (f1/f2)^2, L1 delay to L2 */
+#define IONO_TECU     1.0E16            /* electrons/m^2 per tec unit */
+
+
+/*___________________________________________________
+   IonoEngine Class:
+        :alpha, beta: klobuchar coefficients of the
+                      latest message 30
+        :tow: tow count of that message
+        :member functions:::::::::::::::::::::
+            -update: take a decoded message 30
+            -collect: latest message 30 of a file
+            -delay: slant L1 delays of observations
+            -vtec_map: vertical tec on a lat/lon grid
+_____________________________________________________
+
+*/
+class IonoEngine{
+
+    public:
+
+    double alpha[4];
+    double beta[4];
+    uint32_t tow;
+    bool valid;
+
+    IonoEngine()
+    {
+        for(int i = 0 ; i < 4 ; i++){ alpha[i] = 0; beta[i] = 0; }
+        tow = 0;
+        valid = false;
+    }
+
+    void update(const Msg_Type_30& m)
+    {
+        for(int i = 0 ; i < 4 ; i++){
+            alpha[i] = m.alpha[i];
+            beta[i] = m.beta[i];
+        }
+        tow = m.TOW;
+        valid = true;
+    }
+
+    /* message 30 with the latest tow count */
+    void collect(const SatelliteFile& file)
+    {
+        const Msg_Type_30* latest = NULL;
+        for(int i = 1 ; i <= MAXPRN ; i++)
+        {
+            const Satellite* s = file.satellite[i];
+            if(s->m30.empty()) continue;
+            if(latest == NULL || s->m30.back().TOW > latest->TOW)
+                latest = &s->m30.back();
+        }
+        if(latest) update(*latest);
+    }
+
+    /*
+        Slant L1 delay of n observations, scale by
+        IONO_L2_SCALE for L2
+        @param lat, lon: receiver geodetic (rad)
+        @param az, el: satellite azimuth, elevation (rad)
+        @param t: gps seconds since gps epoch
+        @param out: n delays (m)
+    */
+    void delay(const double* lat, const double* lon, const double* az,
+               const double* el, const double* t, size_t n, double* out) const
+    {
+        const double a0 = alpha[0], a1 = alpha[1], a2 = alpha[2], a3 = alpha[3];
+        const double b0 = beta[0],  b1 = beta[1],  b2 = beta[2],  b3 = beta[3];
+
+        OMP_SIMD()
+        for(size_t i = 0 ; i < n ; i++)
+        {
+            /* semi circles */
+            double E = el[i] * (1.0 / PI);
+            double sA, cA;
+            fast_sincos(az[i], &sA, &cA);
+
+            /* earth centred angle and ionospheric pierce point */
+            double psi = 0.0137 / (E + 0.11) - 0.022;
+            double phi = lat[i] * (1.0 / PI) + psi * cA;
+            phi = pick(phi > 0.416, 0.416, pick(phi < -0.416, -0.416, phi));
+
+            double sp, cp;
+            fast_sincos(phi * PI, &sp, &cp);
+            double lam = lon[i] * (1.0 / PI) + psi * sA / cp;
+
+            /* obliquity factor */
+            double f = 0.53 - E;
+            double F = 1.0 + 16.0 * f * f * f;
+
+            out[i] = F * vertical(phi, lam, t[i], a0, a1, a2, a3, b0, b1, b2, b3)
+                   * CLIGHT;
+        }
+    }
+
+    /* delay of a single observation (m) */
+    double delay(double lat, double lon, double az, double el, double t) const
+    {
+        double out;
+        delay(&lat, &lon, &az, &el, &t, 1, &out);
+        return out;
+    }
+
+    /*
+        Vertical tec map at t, rows from north to
+        south, columns from west to east, grid
+        points taken as pierce points
+        @param t: gps seconds since gps epoch
+        @param dlat, dlon: grid spacing (deg)
+        @param map: nlat * nlon values (tecu)
+        @param nlat, nlon: grid size
+    */
+    void vtec_map(double t, double dlat, double dlon, std::vector<float>& map,
+                  int& nlat, int& nlon) const
+    {
+        const double a0 = alpha[0], a1 = alpha[1], a2 = alpha[2], a3 = alpha[3];
+        const double b0 = beta[0],  b1 = beta[1],  b2 = beta[2],  b3 = beta[3];
+
+        nlat = (int)floor(180.0 / dlat) + 1;
+        nlon = (int)floor(360.0 / dlon) + 1;
+        map.resize((size_t)nlat * nlon);
+
+        /* delay (s) to tec units on L1 */
+        const double tecu = CLIGHT * FREQ_L1 * FREQ_L1 / 40.3 / IONO_TECU;
+
+        for(int r = 0 ; r < nlat ; r++)
+        {
+            double lat = (90.0 - r * dlat) / 180.0;
+            float* row = &map[(size_t)r * nlon];
+
+            OMP_SIMD()
+            for(int c = 0 ; c < nlon ; c++){
+                double lon = (-180.0 + c * dlon) / 180.0;
+                row[c] = (float)(vertical(lat, lon, t, a0, a1, a2, a3,
+                                          b0, b1, b2, b3) * tecu);
+            }
+        }
+    }
+
+    private:
+
+    /* a if c else b on the bits, a plain select lets the compiler split
+     * the loop body into branches and then it no longer vectorizes   */
+    static double pick(bool c, double a, double b)
+    {
+        uint64_t ua, ub, m = 0 - (uint64_t)c;
+        memcpy(&ua, &a, sizeof ua);
+        memcpy(&ub, &b, sizeof ub);
+        ua = (ua & m) | (ub & ~m);
+        memcpy(&a, &ua, sizeof a);
+        return a;
+    }
+
+    /* vertical delay (s) at pierce point phi, lam (semi circles) */
+    static double vertical(double phi, double lam, double t,
+                           double a0, double a1, double a2, double a3,
+                           double b0, double b1, double b2, double b3)
+    {
+        const double ROUND = 6755399441055744.0;     /* 1.5 * 2^52 */
+
+        /* geomagnetic latitude */
+        double sm, cm;
+        fast_sincos((lam - 1.617) * PI, &sm, &cm);
+        double pm = phi + 0.064 * cm;
+
+        /* local time in [0, 86400), days rounded without floor() */
+        double lt = 43200.0 * lam + t;
+        double big = lt * (1.0 / 86400) + ROUND;
+        int64_t k;
+        memcpy(&k, &big, sizeof k);
+        lt -= 86400.0 * (double)(int32_t)k;
+        lt += pick(lt < 0, 86400.0, 0.0);
+
+        double amp = a0 + pm * (a1 + pm * (a2 + pm * a3));
+        double per = b0 + pm * (b1 + pm * (b2 + pm * b3));
+        amp = pick(amp < 0, 0.0, amp);
+        per = pick(per < 72000, 72000.0, per);
+
+        double x = 2.0 * PI * (lt - 50400.0) / per;
+        double x2 = x * x;
+        double day = amp * (1.0 - x2 * (0.5 - x2 * (1.0 / 24)));
+
+        return 5.0E-9 + pick(fabs(x) < 1.57, day, 0.0);
+    }
+
+};
+
+
+#endif
@@ -0,0 +1,549 @@
+/****************************************
+ *
+ *   NDJSON sink
+ *   Decoded cnav messages and assembled
+ *   ephemerides as JSON lines
+ *
+ *   Lines are formatted with std::to_chars
+ *   into one buffer allocated up front and
+ *   written with fwrite when it fills, to
+ *   a file, a pipe or an open stream
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef NDJSON_SINK_H
+#define NDJSON_SINK_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <charconv>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "gps_l2_satellite.h"
+
+#define NDJSON_BUFFER (4 << 20)  /* output buffer (bytes) */
+#define NDJSON_RECORD 4096       /* longest line */
+
+#ifdef WIN32
+#define popen  _popen
+#define pclose _pclose
+#endif
+
+
+/*___________________________________________________
+   NdjsonSink Class:
+        :lines: lines written since open
+        :member functions:::::::::::::::::::::
+            -open: file target
+            -pipe: command reading stdin
+            -attach: stream owned by the caller
+            -message: one decoded message
+            -ephemeris: one assembled upload
+            -flush, close
+_____________________________________________________
+
+*/
+class NdjsonSink{
+
+    public:
+
+    size_t lines;
+
+    explicit NdjsonSink(size_t capacity = NDJSON_BUFFER)
+        : lines(0), fp(NULL), piped(false), owned(false)
+    {
+        buf.resize(capacity < 4 * NDJSON_RECORD ? 4 * NDJSON_RECORD : capacity);
+        p = buf.data();
+    }
+
+    ~NdjsonSink() { close(); }
+
+    bool open(const std::string& path)
+    {
+        close();
+        fp = fopen(path.c_str(), "wb");
+        if(fp == NULL){
+            std::cout << "Ndjson file can not be opened: " << path << std::endl;
+            return false;
+        }
+        return target(false, true);
+    }
+
+    /* lines go to the stdin of command */
+    bool pipe(const std::string& command)
+    {
+        close();
+        fp = popen(command.c_str(), "w");
+        if(fp == NULL){
+            std::cout << "Ndjson pipe can not be opened: " << command << std::endl;
+            return false;
+        }
+        return target(true, true);
+    }
+
+    /* stdout or a stream opened elsewhere, left open on close */
+    bool attach(FILE* stream)
+    {
+        close();
+        fp = stream;
+        return fp != NULL && target(false, false);
+    }
+
+    void flush()
+    {
+        size_t n = p - buf.data();
+        if(fp && n){
+            fwrite(buf.data(), 1, n, fp);
+            fflush(fp);
+        }
+        p = buf.data();
+    }
+
+    void close()
+    {
+        if(fp == NULL) return;
+        flush();
+        if(owned) piped ? pclose(fp) : fclose(fp);
+        fp = NULL;
+    }
+
+    /* latest message of the id a satellite decoded */
+    void message(int prn, const Satellite& s, int id)
+    {
+        switch(id)
+        {
+            case 10: if(!s.m10.empty()) message(prn, s.m10.back()); break;
+            case 11: if(!s.m11.empty()) message(prn, s.m11.back()); break;
+            case 12: if(!s.m12.empty()) message(prn, s.m12.back()); break;
+            case 13: if(!s.m13.empty()) message(prn, s.m13.back()); break;
+            case 14: if(!s.m14.empty()) message(prn, s.m14.back()); break;
+            case 15: if(!s.m15.empty()) message(prn, s.m15.back()); break;
+            case 30: if(!s.m30.empty()) message(prn, s.m30.back()); break;
+            case 31: if(!s.m31.empty()) message(prn, s.m31.back()); break;
+            case 32: if(!s.m32.empty()) message(prn, s.m32.back()); break;
+            case 33: if(!s.m33.empty()) message(prn, s.m33.back()); break;
+            case 34: if(!s.m34.empty()) message(prn, s.m34.back()); break;
+            case 35: if(!s.m35.empty()) message(prn, s.m35.back()); break;
+            case 36: if(!s.m36.empty()) message(prn, s.m36.back()); break;
+            case 37: if(!s.m37.empty()) message(prn, s.m37.back()); break;
+        }
+    }
+
+    /* message of its words, decoded here for a sink on its own thread */
+    void message(int prn, int id, uint32_t* wrd)
+    {
+        switch(id)
+        {
+            case 10: { Msg_Type_10 m; m.decode(wrd); message(prn, m); break; }
+            case 11: { Msg_Type_11 m; m.decode(wrd); message(prn, m); break; }
+            case 12: { Msg_Type_12 m; m.decode(wrd); message(prn, m); break; }
+            case 13: { Msg_Type_13 m; m.decode(wrd); message(prn, m); break; }
+            case 14: { Msg_Type_14 m; m.decode(wrd); message(prn, m); break; }
+            case 30: { Msg_Type_30 m; m.decode(wrd); message(prn, m); break; }
+            case 31: { Msg_Type_31 m; m.decode(wrd); message(prn, m); break; }
+            case 32: { Msg_Type_32 m; m.decode(wrd); message(prn, m); break; }
+            case 33: { Msg_Type_33 m; m.decode(wrd); message(prn, m); break; }
+            case 34: { Msg_Type_34 m; m.decode(wrd); message(prn, m); break; }
+            case 35: { Msg_Type_35 m; m.decode(wrd); message(prn, m); break; }
+            case 36: { Msg_Type_36 m; m.w1.word = wrd[0]; m.w2.word = wrd[1]; message(prn, m); break; }
+            case 37: { Msg_Type_37 m; m.decode(wrd); message(prn, m); break; }
+        }
+    }
+
+    void message(int prn, const Msg_Type_10& m)
+    {
+        start(10, prn, m.TOW);
+        num("WN", m.WN);
+        num("top", m.top);
+        num("toe", m.toe);
+        num("URAi", m.URAi);
+        num("L1_health", m.L1_health);
+        num("L2_health", m.L2_health);
+        num("L5_health", m.L5_health);
+        num("alert", m.alert);
+        num("deltaA", m.deltaA);
+        num("Adot", m.Adot);
+        num("delntan0", m.delntan0);
+        num("deln0dot", m.deln0dot);
+        num("en", m.en);
+        num("M0n", m.M0n);
+        num("omegan", m.omegan);
+        num("integ_flag", m.integ_flag);
+        num("L2C_phasing", m.L2C_phasing);
+        end();
+    }
+
+    void message(int prn, const Msg_Type_11& m)
+    {
+        start(11, prn, m.TOW);
+        num("toe", m.toe);
+        num("omega0n", m.omega0n);
+        num("i0n", m.i0n);
+        num("delomegadot", m.delomegadot);
+        num("i0nDOT", m.i0nDOT);
+        num("cisn", m.cisn);
+        num("cicn", m.cicn);
+        num("crsn", m.crsn);
+        num("crcn", m.crcn);
+        num("cusn", m.cusn);
+        num("cucn", m.cucn);
+        end();
+    }
+
+    void message(int prn, const Msg_Type_12& m)
+    {
+        start(12, prn, m.TOW);
+        num("WNan", m.WNan);
+        num("toa", m.toa);
+        almanacs(m.redalm);
+        end();
+    }
+
+    void message(int prn, const Msg_Type_13& m)
+    {
+        start(13, prn, m.TOW);
+        num("topD", m.topD);
+        num("tOD", m.tOD);
+        key("cdc");
+        *p++ = '[';
+        for(size_t i = 0 ; i < m.ClockDifs.size() ; i++){
+            if(i) *p++ = ',';
+            cdc(m.ClockDifs[i]);
+        }
+        *p++ = ']';
+        end();
+    }
+
+    void message(int prn, const Msg_Type_14& m)
+    {
+        start(14, prn, m.TOW);
+        num("topD", m.topD);
+        num("tOD", m.tOD);
+        key("edc");
+        *p++ = '[';
+        for(size_t i = 0 ; i < m.ephdif_corrections.size() ; i++){
+            if(i) *p++ = ',';
+            edc(m.ephdif_corrections[i]);
+        }
+        *p++ = ']';
+        end();
+    }
+
+    /* parameters of 15 and 36 are not decoded */
+    void message(int prn, const Msg_Type_15& m)
+    {
+        start(15, prn, raw_tow(m.w1.word, m.w2.word));
+        end();
+    }
+
+    void message(int prn, const Msg_Type_36& m)
+    {
+        start(36, prn, raw_tow(m.w1.word, m.w2.word));
+        end();
+    }
+
+    void message(int prn, const Msg_Type_30& m)
+    {
+        start(30, prn, m.TOW);
+        clock(m.toc, m.af0, m.af1, m.af2);
+        num("top", m.top);
+        num("URANED0", m.URANED0);
+        num("URANED1", m.URANED1);
+        num("URANED2", m.URANED2);
+        num("TGD", m.TGD);
+        num("ISCL1CA", m.ISCL1CA);
+        num("ISCL2C", m.ISCL2C);
+        num("ISCL5I5", m.ISCL5I5);
+        num("ISCL5Q5", m.ISCL5Q5);
+        list("alpha", m.alpha, 4);
+        list("beta", m.beta, 4);
+        end();
+    }
+
+    void message(int prn, const Msg_Type_31& m)
+    {
+        start(31, prn, m.TOW);
+        clock(m.toc, m.af0, m.af1, m.af2);
+        num("WNan", m.WNan);
+        num("toa", m.toa);
+        almanacs(m.redalm);
+        end();
+    }
+
+    void message(int prn, const Msg_Type_32& m)
+    {
+        start(32, prn, m.TOW);
+        clock(m.toc, m.af0, m.af1, m.af2);
+        num("tEOP", m.tEOP);
+        num("PM_X", m.PM_X);
+        num("PM_Xdot", m.PM_Xdot);
+        num("PM_Y", m.PM_Y);
+        num("PM_Ydot", m.PM_Ydot);
+        num("deltaUTGPS", m.deltaUTGPS);
+        num("deltaUTGPSdot", m.deltaUTGPSdot);
+        end();
+    }
+
+    void message(int prn, const Msg_Type_33& m)
+    {
+        start(33, prn, m.TOW);
+        clock(m.toc, m.af0, m.af1, m.af2);
+        num("A0", m.A0);
+        num("A1", m.A1);
+        num("A2", m.A2);
+        num("deltatLS", m.deltatLS);
+        num("tot", m.tot);
+        num("WNot", m.WNot);
+        num("WNLSF", m.WNLSF);
+        num("DN", m.DN);
+        num("deltatLSF", m.deltatLSF);
+        end();
+    }
+
+    void message(int prn, const Msg_Type_34& m)
+    {
+        start(34, prn, m.TOW);
+        clock(m.toc, m.af0, m.af1, m.af2);
+        num("topD", m.topD);
+        num("tOD", m.tOD);
+        key("cdc");
+        cdc(m.clockdif);
+        key("edc");
+        edc(m.ephdif);
+        end();
+    }
+
+    void message(int prn, const Msg_Type_35& m)
+    {
+        start(35, prn, m.TOW);
+        clock(m.toc, m.af0, m.af1, m.af2);
+        num("tGGTO", m.tGGTO);
+        num("WNGGTO", m.WNGGTO);
+        num("GNSSID", m.GNSSID);
+        num("A0GGTO", m.A0GGTO);
+        num("A1GGTO", m.A1GGTO);
+        num("A2GGTO", m.A2GGTO);
+        end();
+    }
+
+    void message(int prn, const Msg_Type_37& m)
+    {
+        start(37, prn, m.TOW);
+        clock(m.toc, m.af0, m.af1, m.af2);
+        num("WNan", m.WNan);
+        num("toa", m.toa);
+        num("PRNa", m.PRNa);
+        num("L1_health", m.L1_health);
+        num("L2_health", m.L2_health);
+        num("L5_health", m.L5_health);
+        num("e", m.e);
+        num("delta_i", m.delta_i);
+        num("OMEGA_DOT", m.OMEGA_DOT);
+        num("sqrtA", m.sqrtA);
+        num("OMEGA0", m.OMEGA0);
+        num("omega", m.omega);
+        num("M0", m.M0);
+        num("af0a", m.af0a);
+        num("af1a", m.af1a);
+        end();
+    }
+
+    void ephemeris(int prn, const eph& e)
+    {
+        reserve();
+        text("{\"kind\":\"eph\"");
+        num("prn", prn);
+        num("week", e.week);
+        num("toe", e.TOE);
+        num("toc", e.toc);
+        num("af0", e.clock_bias);
+        num("af1", e.clock_drift);
+        num("af2", e.clock_rate);
+        num("IODE", e.IODE);
+        num("IODC", e.IODC);
+        num("Crs", e.Crs);
+        num("Crc", e.Crc);
+        num("Cus", e.Cus);
+        num("Cuc", e.Cuc);
+        num("Cis", e.Cis);
+        num("Cic", e.Cic);
+        num("delta_n", e.delta_n);
+        num("delta_n_dot", e.delta_n_dot);
+        num("M0", e.M0);
+        num("e", e.eccentricity);
+        num("sqrtA", e.sqrtA);
+        num("Adot", e.Adot);
+        num("OMEGA", e.OMEGA);
+        num("OMEGA_DOT", e.OMEGA_DOT);
+        num("i0", e.I0);
+        num("IDOT", e.IDOT);
+        num("omega", e.omega);
+        num("tgd", e.tgd);
+        num("sv_acc", e.sv_acc);
+        num("sv_health", e.sv_health);
+        num("fit_interval", e.fit_interval);
+        num("trans_time", e.trans_time);
+        end();
+    }
+
+    private:
+
+    FILE* fp;
+    bool piped;
+    bool owned;
+    char* p;
+    std::vector<char> buf;
+
+    bool target(bool is_pipe, bool is_owned)
+    {
+        piped = is_pipe;
+        owned = is_owned;
+        lines = 0;
+        /* the buffer here is the only one, a stream of the
+           caller keeps its buffering, flush() empties it */
+        if(owned) setvbuf(fp, NULL, _IONBF, 0);
+        return true;
+    }
+
+    /* room for the longest line */
+    void reserve()
+    {
+        if((size_t)(buf.data() + buf.size() - p) < NDJSON_RECORD) flush();
+    }
+
+    /* 17 bit tow count over words 1 and 2 */
+    static uint32_t raw_tow(uint32_t w1, uint32_t w2)
+    {
+        return (w1 & 0xFFF) << 5 | w2 >> 27;
+    }
+
+    void start(int id, int prn, uint32_t tow)
+    {
+        reserve();
+        text("{\"kind\":\"cnav\"");
+        num("msg", id);
+        num("prn", prn);
+        num("tow", tow);
+    }
+
+    void end()
+    {
+        *p++ = '}';
+        *p++ = '\n';
+        lines++;
+    }
+
+    void text(const char* s)
+    {
+        size_t n = strlen(s);
+        memcpy(p, s, n);
+        p += n;
+    }
+
+    void key(const char* name)
+    {
+        *p++ = ',';
+        *p++ = '"';
+        text(name);
+        *p++ = '"';
+        *p++ = ':';
+    }
+
+    /* shortest round trip, json has no inf or nan */
+    void value(double v)
+    {
+        if(!std::isfinite(v)){ text("null"); return; }
+        p = std::to_chars(p, p + 32, v).ptr;
+    }
+
+    void value(long v)
+    {
+        p = std::to_chars(p, p + 24, v).ptr;
+    }
+
+    void num(const char* name, double v)       { key(name); value(v); }
+    void num(const char* name, long double v)  { key(name); value((double)v); }
+    void num(const char* name, int v)          { key(name); value((long)v); }
+    void num(const char* name, uint32_t v)     { key(name); value((long)v); }
+    void num(const char* name, uint16_t v)     { key(name); value((long)v); }
+    void num(const char* name, uint8_t v)      { key(name); value((long)v); }
+    void num(const char* name, int8_t v)       { key(name); value((long)v); }
+
+    void list(const char* name, const double* v, int n)
+    {
+        key(name);
+        *p++ = '[';
+        for(int i = 0 ; i < n ; i++){
+            if(i) *p++ = ',';
+            value(v[i]);
+        }
+        *p++ = ']';
+    }
+
+    void clock(uint32_t toc, long double af0, long double af1, long double af2)
+    {
+        num("toc", toc);
+        num("af0", af0);
+        num("af1", af1);
+        num("af2", af2);
+    }
+
+    void cdc(const Msg_Type_13::CDC_scaled& c)
+    {
+        *p++ = '{';
+        text("\"prn\":");
+        value((long)c.prn);
+        num("type", c.type);
+        num("daf0", c.daf0);
+        num("daf1", c.daf1);
+        num("UDRA", c.UDRA);
+        *p++ = '}';
+    }
+
+    void edc(const Msg_Type_14::EDC& e)
+    {
+        *p++ = '{';
+        text("\"prn\":");
+        value((long)e.prn);
+        num("type", e.type);
+        num("delalph", e.delalph);
+        num("delbeta", e.delbeta);
+        num("delgamm", e.delgamm);
+        num("deli", e.deli);
+        num("delomg", e.delomg);
+        num("delA", e.delA);
+        num("UDRAdot", e.UDRAdot);
+        *p++ = '}';
+    }
+
+    void almanacs(const std::vector<Msg_Type_12::reduced_almanac>& a)
+    {
+        key("almanacs");
+        *p++ = '[';
+        for(size_t i = 0 ; i < a.size() ; i++){
+            if(i) *p++ = ',';
+            *p++ = '{';
+            text("\"PRNa\":");
+            value((long)a[i].PRNa);
+            num("L1", a[i].L1);
+            num("L2", a[i].L2);
+            num("L5", a[i].L5);
+            num("phi_0", a[i].phi_0);
+            num("omega_0", a[i].omega_0);
+            num("sigma_A", a[i].sigma_A);
+            *p++ = '}';
+        }
+        *p++ = ']';
+    }
+
+};
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,449 @@
+/****************************************
+ *
+ *   Orbit engine
+ *   Satellite position, velocity and
+ *   clock from cnav ephemeris
+ *   IS-GPS-200 Table 30-II, 30-III
+ *
+ *   Queries are evaluated in blocks of
+ *   ORBIT_LANES satellites laid out as
+ *   structure of arrays, so the loops
+ *   vectorize across satellites
+ *   (build with -O3 -fopenmp-simd and
+ *   -mavx2 or better)
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef ORBIT_ENGINE_H
+#define ORBIT_ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include <cmath>
+
+#include "gps_l2_message_types.hpp"
+#include "ephemeris_store.h"
+
+#define MU_GPS        3.986005E14       /* earth gravitational constant */
+#define OMEGA_E       7.2921151467E-5   /* earth rotation rate (rad/s) */
+#define F_REL        -4.442807633E-10   /* relativistic constant */
+#define KEPLER_ITER   2                 /* newton steps on kepler */
+#define ORBIT_LANES   8                 /* satellites per block */
+
+
+/* sine and cosine -------------------------------------------------------------
+* branch free sin/cos for the lane loops, argument reduced by pi/2 in
+* three parts then taylor series on [-pi/4, pi/4], error below 1e-16
+* args   : double x         I   angle (rad), |x| < 1e9
+*          double *s, *c    O   sin(x), cos(x)
+*-----------------------------------------------------------------------------*/
+inline void fast_sincos(double x, double* s, double* c)
+{
+    const double PIO2_HI  = 1.57079632673412561417E+00;
+    const double PIO2_MID = 6.07710050650619224932E-11;
+    const double PIO2_LO  = 2.02226624879595063154E-21;
+    const double ROUND    = 6755399441055744.0;     /* 1.5 * 2^52 */
+
+    /* quadrant lands in the low mantissa bits, no floor() call */
+    double big = x * 0.63661977236758134308 + ROUND;
+    int64_t n;
+    memcpy(&n, &big, sizeof n);
+    double q = (double)(int32_t)n;
+
+    double r = ((x - q * PIO2_HI) - q * PIO2_MID) - q * PIO2_LO;
+    double r2 = r * r;
+
+    double sr = r + r * r2 * (-1.0/6 + r2 * (1.0/120 + r2 * (-1.0/5040
+              + r2 * (1.0/362880 + r2 * (-1.0/39916800 + r2 * (1.0/6227020800
+              + r2 * (-1.0/1307674368000 + r2 * (1.0/355687428096000))))))));
+    double cr = 1.0 + r2 * (-0.5 + r2 * (1.0/24 + r2 * (-1.0/720
+              + r2 * (1.0/40320 + r2 * (-1.0/3628800 + r2 * (1.0/479001600
+              + r2 * (-1.0/87178291200 + r2 * (1.0/20922789888000))))))));
+
+    /* odd quadrants swap sin and cos, signs follow the quadrant; done
+     * on the bits since selects get turned into branches when the
+     * caller uses one output only                                  */
+    uint64_t k = (uint64_t)n, sb, cb, swap;
+    memcpy(&sb, &sr, sizeof sb);
+    memcpy(&cb, &cr, sizeof cb);
+    swap = (sb ^ cb) & (0 - (k & 1));
+    sb ^= swap ^ ((k & 2) << 62);
+    cb ^= swap ^ (((k + 1) & 2) << 62);
+    memcpy(s, &sb, sizeof sb);
+    memcpy(c, &cb, sizeof cb);
+}
+
+/* small angle sine and cosine ---------------------------------------------------
+* series without reduction, error below 1e-18 for |x| <= 0.1
+* args   : double x         I   angle (rad)
+*          double *s, *c    O   sin(x), cos(x)
+*-----------------------------------------------------------------------------*/
+inline void small_sincos(double x, double* s, double* c)
+{
+    double x2 = x * x;
+    *s = x + x * x2 * (-1.0/6 + x2 * (1.0/120 + x2 * (-1.0/5040
+       + x2 * (1.0/362880))));
+    *c = 1.0 + x2 * (-0.5 + x2 * (1.0/24 + x2 * (-1.0/720
+       + x2 * (1.0/40320 + x2 * (-1.0/3628800)))));
+}
+
+
+/*
+___________________________________________________
+   Satellite State Struct:
+        ecef position (m), velocity (m/s)
+        clock correction (s), rate (s/s)
+___________________________________________________
+
+*/
+typedef struct
+{
+    double pos[3];
+    double vel[3];
+    double clk;
+    double clk_rate;
+    bool valid;
+
+} sat_state;
+
+
+/*___________________________________________________
+   OrbitEngine Class:
+        :store: ephemerides looked up per query
+        :params: per ephemeris precomputed terms
+        :member functions:::::::::::::::::::::
+            -evaluate: states of (PRN, t) pairs
+            -epoch: states of all PRNs at t
+_____________________________________________________
+
+*/
+class OrbitEngine{
+
+    public:
+
+    explicit OrbitEngine(const EphemerisStore& eph_store) : store(eph_store)
+    {
+        for(int i = 0 ; i <= MAXPRN ; i++) gen[i] = ~0u;
+    }
+
+    /*
+        States for n (PRN, t) pairs
+        @param prn: 1 - 32
+        @param t: gps seconds since gps epoch
+        @param out: n states, invalid when no
+                    ephemeris covers t
+        @return number of valid states
+    */
+    size_t evaluate(const int* prn, const double* t, size_t n, sat_state* out)
+    {
+        size_t count = 0;
+        block b;
+
+        for(size_t i = 0 ; i < n ; i += ORBIT_LANES)
+        {
+            size_t lanes = n - i < ORBIT_LANES ? n - i : ORBIT_LANES;
+            int slot[ORBIT_LANES];
+            int used = 0;
+
+            /* gather ephemeris terms into lanes */
+            for(size_t l = 0 ; l < lanes ; l++)
+            {
+                const orbit_params* p = lookup(prn[i + l], t[i + l]);
+                out[i + l].valid = (p != NULL);
+                if(p == NULL) continue;
+
+                b.load(used, *p, t[i + l]);
+                slot[used++] = (int)(i + l);
+            }
+
+            if(used == 0) continue;
+            for(int l = used ; l < ORBIT_LANES ; l++) b.pad(l);
+
+            b.solve();
+
+            for(int l = 0 ; l < used ; l++)
+                b.store(l, out[slot[l]]);
+
+            count += used;
+        }
+
+        return count;
+    }
+
+    /* evaluate with gtime_t */
+    size_t evaluate(const int* prn, const gtime_t* t, size_t n, sat_state* out)
+    {
+        std::vector<double> sec(n);
+        for(size_t i = 0 ; i < n ; i++) sec[i] = gpst_seconds(t[i]);
+        return evaluate(prn, sec.data(), n, out);
+    }
+
+    /*
+        States of satellites 1 - 32 at t
+        @param out: MAXPRN + 1 states, by PRN
+    */
+    size_t epoch(double t, sat_state* out)
+    {
+        int prn[MAXPRN];
+        double tt[MAXPRN];
+        for(int i = 0 ; i < MAXPRN ; i++){ prn[i] = i + 1; tt[i] = t; }
+
+        out[0].valid = false;
+        return evaluate(prn, tt, MAXPRN, out + 1);
+    }
+
+    private:
+
+    /* time independent terms of one ephemeris */
+    struct orbit_params
+    {
+        double toe, toc, toe_sow;
+        double A0, sqrtA0, Adot, n0, dn0, dn0dot;
+        double M0, e, sqrt1e2, sin_w, cos_w;
+        double Cus, Cuc, Crs, Crc, Cis, Cic;
+        double sin_i0, cos_i0, idot, OMEGA0, OMEGA_DOT;
+        double af0, af1, af2;
+    };
+
+    /* lane arrays, one satellite per lane */
+    struct block
+    {
+        double tk[ORBIT_LANES], tc[ORBIT_LANES];
+        double A0[ORBIT_LANES], sqrtA0[ORBIT_LANES], Adot[ORBIT_LANES];
+        double n0[ORBIT_LANES];
+        double dn0[ORBIT_LANES], dn0dot[ORBIT_LANES];
+        double M0[ORBIT_LANES], e[ORBIT_LANES], sqrt1e2[ORBIT_LANES];
+        double sin_w[ORBIT_LANES], cos_w[ORBIT_LANES];
+        double Cus[ORBIT_LANES], Cuc[ORBIT_LANES], Crs[ORBIT_LANES];
+        double Crc[ORBIT_LANES], Cis[ORBIT_LANES], Cic[ORBIT_LANES];
+        double sin_i0[ORBIT_LANES], cos_i0[ORBIT_LANES], idot[ORBIT_LANES];
+        double OMEGA0[ORBIT_LANES], OMEGA_DOT[ORBIT_LANES], toe_sow[ORBIT_LANES];
+        double af0[ORBIT_LANES], af1[ORBIT_LANES], af2[ORBIT_LANES];
+
+        double x[ORBIT_LANES], y[ORBIT_LANES], z[ORBIT_LANES];
+        double vx[ORBIT_LANES], vy[ORBIT_LANES], vz[ORBIT_LANES];
+        double clk[ORBIT_LANES], clk_rate[ORBIT_LANES];
+
+        void load(int l, const orbit_params& p, double t)
+        {
+            tk[l] = t - p.toe;      tc[l] = t - p.toc;
+            A0[l] = p.A0;           sqrtA0[l] = p.sqrtA0;
+            Adot[l] = p.Adot;
+            n0[l] = p.n0;           dn0[l] = p.dn0;
+            dn0dot[l] = p.dn0dot;   M0[l] = p.M0;
+            e[l] = p.e;             sqrt1e2[l] = p.sqrt1e2;
+            sin_w[l] = p.sin_w;     cos_w[l] = p.cos_w;
+            Cus[l] = p.Cus;         Cuc[l] = p.Cuc;
+            Crs[l] = p.Crs;         Crc[l] = p.Crc;
+            Cis[l] = p.Cis;         Cic[l] = p.Cic;
+            sin_i0[l] = p.sin_i0;   cos_i0[l] = p.cos_i0;
+            idot[l] = p.idot;
+            OMEGA0[l] = p.OMEGA0;   OMEGA_DOT[l] = p.OMEGA_DOT;
+            toe_sow[l] = p.toe_sow;
+            af0[l] = p.af0;         af1[l] = p.af1;
+            af2[l] = p.af2;
+        }
+
+        /* unused lanes get a harmless circular orbit */
+        void pad(int l)
+        {
+            orbit_params p = orbit_params();
+            p.A0 = AREF; p.sqrtA0 = sqrt((double)AREF);
+            p.n0 = sqrt(MU_GPS / ((double)AREF * AREF * AREF));
+            p.sqrt1e2 = 1; p.cos_w = 1; p.cos_i0 = 1;
+            load(l, p, 0);
+        }
+
+        /* cnav user algorithm, no branches per lane */
+        void solve()
+        {
+            OMP_SIMD()
+            for(int l = 0 ; l < ORBIT_LANES ; l++)
+            {
+                double t = tk[l];
+
+                /* corrected mean motion and semi major axis */
+                double A  = A0[l] + Adot[l] * t;
+                double nA = n0[l] + dn0[l] + 0.5 * dn0dot[l] * t;
+                double Mdot = n0[l] + dn0[l] + dn0dot[l] * t;
+                double M  = M0[l] + nA * t;
+
+                /* kepler, fixed newton steps from a second order guess,
+                 * sin/cos of E follow by rotating those of M            */
+                double sinM, cosM, sd, cd;
+                fast_sincos(M, &sinM, &cosM);
+
+                double d = e[l] * sinM * (1.0 + e[l] * cosM);
+                small_sincos(d, &sd, &cd);
+                double E = M + d;
+                double sinE = sinM * cd + cosM * sd;
+                double cosE = cosM * cd - sinM * sd;
+
+                for(int k = 0 ; k < KEPLER_ITER ; k++)
+                {
+                    double dE = (E - e[l] * sinE - M) / (1.0 - e[l] * cosE);
+                    small_sincos(dE, &sd, &cd);
+                    E -= dE;
+                    double s0 = sinE;
+                    sinE = s0 * cd - cosE * sd;
+                    cosE = cosE * cd + s0 * sd;
+                }
+
+                double den = 1.0 - e[l] * cosE;
+                double Edot = Mdot / den;
+
+                /* true anomaly and argument of latitude without atan2 */
+                double sin_v = sqrt1e2[l] * sinE / den;
+                double cos_v = (cosE - e[l]) / den;
+                double vdot  = Edot * sqrt1e2[l] / den;
+
+                double sin_p = sin_v * cos_w[l] + cos_v * sin_w[l];
+                double cos_p = cos_v * cos_w[l] - sin_v * sin_w[l];
+                double s2p = 2.0 * sin_p * cos_p;
+                double c2p = cos_p * cos_p - sin_p * sin_p;
+
+                /* second harmonic perturbations */
+                double du = Cus[l] * s2p + Cuc[l] * c2p;
+                double dr = Crs[l] * s2p + Crc[l] * c2p;
+                double di = Cis[l] * s2p + Cic[l] * c2p;
+
+                /* du is a few 1e-5 rad */
+                double sin_du, cos_du;
+                small_sincos(du, &sin_du, &cos_du);
+                double sin_u = sin_p * cos_du + cos_p * sin_du;
+                double cos_u = cos_p * cos_du - sin_p * sin_du;
+
+                double r = A * den + dr;
+
+                /* inclination moves a few 1e-6 rad from i0 over the fit */
+                double dinc = idot[l] * t + di;
+                double sin_d, cos_d;
+                small_sincos(dinc, &sin_d, &cos_d);
+                double si = sin_i0[l] * cos_d + cos_i0[l] * sin_d;
+                double ci = cos_i0[l] * cos_d - sin_i0[l] * sin_d;
+
+                double udot = vdot + 2.0 * vdot * (Cus[l] * c2p - Cuc[l] * s2p);
+                double rdot = A * e[l] * sinE * Edot + Adot[l] * den
+                            + 2.0 * vdot * (Crs[l] * c2p - Crc[l] * s2p);
+                double idt  = idot[l] + 2.0 * vdot * (Cis[l] * c2p - Cic[l] * s2p);
+
+                /* orbital plane */
+                double xp = r * cos_u, yp = r * sin_u;
+                double xpdot = rdot * cos_u - r * udot * sin_u;
+                double ypdot = rdot * sin_u + r * udot * cos_u;
+
+                /* corrected longitude of ascending node */
+                double Wdot = OMEGA_DOT[l] - OMEGA_E;
+                double W = OMEGA0[l] + Wdot * t - OMEGA_E * toe_sow[l];
+                double sW, cW;
+                fast_sincos(W, &sW, &cW);
+
+                x[l] = xp * cW - yp * ci * sW;
+                y[l] = xp * sW + yp * ci * cW;
+                z[l] = yp * si;
+
+                vx[l] = -xp * Wdot * sW + xpdot * cW - ypdot * sW * ci
+                      - yp * (Wdot * cW * ci - idt * sW * si);
+                vy[l] =  xp * Wdot * cW + xpdot * sW + ypdot * cW * ci
+                      - yp * (Wdot * sW * ci + idt * cW * si);
+                vz[l] =  ypdot * si + yp * idt * ci;
+
+                /* clock polynomial and relativistic term, Adot moves
+                 * A by under 1e-7 of itself so sqrt(A) needs no call */
+                double x_A = Adot[l] * t / A0[l];
+                double sqrtA = sqrtA0[l] * (1.0 + 0.5 * x_A - 0.125 * x_A * x_A);
+                double c = tc[l];
+                clk[l] = af0[l] + af1[l] * c + af2[l] * c * c
+                       + F_REL * e[l] * sqrtA * sinE;
+                clk_rate[l] = af1[l] + 2.0 * af2[l] * c
+                            + F_REL * e[l] * sqrtA * cosE * Edot;
+            }
+        }
+
+        void store(int l, sat_state& s) const
+        {
+            s.pos[0] = x[l];  s.pos[1] = y[l];  s.pos[2] = z[l];
+            s.vel[0] = vx[l]; s.vel[1] = vy[l]; s.vel[2] = vz[l];
+            s.clk = clk[l];   s.clk_rate = clk_rate[l];
+            s.valid = true;
+        }
+    };
+
+    const EphemerisStore& store;
+    std::vector<orbit_params> params[MAXPRN + 1];
+    uint32_t gen[MAXPRN + 1];
+
+    /* precomputed terms of the ephemeris valid at t */
+    const orbit_params* lookup(int prn, double t)
+    {
+        if(prn < 1 || prn > MAXPRN) return NULL;
+
+        gtime_t tt;
+        static const time_t t0 = epoch2time(gpst0).time;
+        double whole = floor(t);
+        tt.time = t0 + (time_t)whole;
+        tt.sec = t - whole;
+
+        const eph* e = store.find(prn, tt);
+        if(e == NULL) return NULL;
+
+        if(gen[prn] != store.generation(prn)) rebuild(prn);
+        return &params[prn][e - store.ephemerides(prn).data()];
+    }
+
+    void rebuild(int prn)
+    {
+        const std::vector<eph>& ephs = store.ephemerides(prn);
+        params[prn].resize(ephs.size());
+
+        for(size_t i = 0 ; i < ephs.size() ; i++)
+        {
+            const eph& e = ephs[i];
+            orbit_params& p = params[prn][i];
+            double week = e.week * 604800.0;
+
+            p.toe = week + e.TOE;
+            p.toc = week + e.toc;
+            if(p.toc - p.toe >  302400) p.toc -= 604800;
+            if(p.toc - p.toe < -302400) p.toc += 604800;
+
+            p.A0 = e.sqrtA * e.sqrtA;
+            p.sqrtA0 = e.sqrtA;
+            p.Adot = e.Adot;
+            p.n0 = sqrt(MU_GPS / (p.A0 * p.A0 * p.A0));
+            p.dn0 = e.delta_n;
+            p.dn0dot = e.delta_n_dot;
+            p.M0 = e.M0;
+            p.e = e.eccentricity;
+            p.sqrt1e2 = sqrt(1.0 - p.e * p.e);
+            p.sin_w = sin(e.omega);
+            p.cos_w = cos(e.omega);
+            p.Cus = e.Cus; p.Cuc = e.Cuc;
+            p.Crs = e.Crs; p.Crc = e.Crc;
+            p.Cis = e.Cis; p.Cic = e.Cic;
+            p.sin_i0 = sin(e.I0);
+            p.cos_i0 = cos(e.I0);
+            p.idot = e.IDOT;
+            p.OMEGA0 = e.OMEGA;
+            p.OMEGA_DOT = e.OMEGA_DOT;
+            p.af0 = e.clock_bias;
+            p.af1 = e.clock_drift;
+            p.af2 = e.clock_rate;
+
+            /* toe of the week for the earth rotation term */
+            p.toe_sow = e.TOE;
+        }
+
+        gen[prn] = store.generation(prn);
+    }
+
+};
+
+
+#endif
@@ -10,6 +10,7 @@
 #include "binaryfile.h"
 #include "crc24q.h"
 #include "gpstime.h"
+#include "gpstime_ns.h"
 
 #define uLOG(x) std::cout << (unsigned)x << std::endl;
 #define sLOG(x) std::cout <<           x << std::endl;
@@ -31,10 +32,11 @@ int main(int argv, char** argc)
             std::cout << *(m.satellite[i]) ;
             //m.msg_count(i);
 
-    gtime_t x = gpst2time(m.satellite[1]->m10[0].w2.WN,
-                              m.satellite[1]->m10[0].TOW);
+    GpsTime x = GpsTime::tow_count(full_week(m.satellite[1]->m10[0].WN),
+                                   m.satellite[1]->m10[0].TOW);
+    gtime_t t = x.to_gtime();
 
-    printf ( "Time %s", ctime (&x.time) );;
+    printf ( "Time %s", ctime (&t.time) );;
 
 
 
@@ -0,0 +1,507 @@
+/****************************************
+ *
+ *   Decode pipeline
+ *   Reader, framer, decoder and sink of a
+ *   binary file on their own threads,
+ *   joined by single producer single
+ *   consumer rings
+ *
+ *   Reader blocks circulate between the
+ *   reader and the framer, the framer
+ *   passes gps l2 frame views, the decoder
+ *   passes messages and uploads to the sink
+ *   which formats them. A stage waits only
+ *   on a full or empty ring, throughput is
+ *   that of the slowest stage
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#ifndef WIN32
+#include <pthread.h>
+#include <sched.h>
+#else
+#include <windows.h>
+#endif
+
+#include "gps_l2_cnav_decode.h"
+#include "ubx_framer.h"
+#include "ndjson_sink.h"
+
+#define PIPE_LINE     64         /* cache line */
+#define PIPE_SPIN     64         /* polls before a waiting stage yields */
+#define PIPE_STAGES   4
+
+enum { STAGE_READER, STAGE_FRAMER, STAGE_DECODER, STAGE_SINK };
+
+
+/*___________________________________________________
+   SpscRing Class:
+        Bounded ring of one producer and one
+        consumer thread, head and tail on their
+        own lines, each side caches the other's
+        index and reloads it only when the ring
+        looks full or empty
+        :fill, samples: ring size summed at each
+                        pop, mean occupancy
+        :member functions:::::::::::::::::::::
+            -push, pop: false when full / empty
+_____________________________________________________
+
+*/
+template <class T>
+class SpscRing{
+
+    public:
+
+    explicit SpscRing(size_t n) : fill(0), samples(0)
+    {
+        cap = 1;
+        while(cap < n) cap <<= 1;
+        mask = cap - 1;
+        slots.resize(cap);
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        head_cache = tail_cache = 0;
+    }
+
+    bool push(const T& v)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h - tail_cache == cap){
+            tail_cache = tail.load(std::memory_order_acquire);
+            if(h - tail_cache == cap) return false;
+        }
+        slots[h & mask] = v;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& v)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if(head_cache == t){
+            head_cache = head.load(std::memory_order_acquire);
+            if(head_cache == t) return false;
+        }
+        fill += head_cache - t;
+        samples++;
+        v = slots[t & mask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return cap; }
+
+    /* consumer side, mean share of the ring in use */
+    double occupancy() const { return samples ? (double)fill / samples / cap : 0; }
+
+    private:
+
+    alignas(PIPE_LINE) std::atomic<size_t> head;
+    size_t tail_cache;                               /* producer's copy */
+    alignas(PIPE_LINE) std::atomic<size_t> tail;
+    size_t head_cache;                               /* consumer's copy */
+    size_t fill;
+    size_t samples;
+    alignas(PIPE_LINE) std::vector<T> slots;
+    size_t cap;
+    size_t mask;
+
+};
+
+
+/* reader block of the pool, len 0 ends the stream */
+typedef struct{
+
+    int slot;
+    size_t len;
+
+} pipe_block;
+
+/* decoder output, a message of its words or an upload */
+typedef struct{
+
+    uint8_t kind;          /* PIPE_MESSAGE, PIPE_UPLOAD, PIPE_FRAME, PIPE_END */
+    uint8_t prn;
+    uint8_t id;            /* message id, 0 if the checksum failed */
+    uint8_t stored;        /* frame of a worker completed upload e */
+    uint32_t words[10];
+    eph e;
+
+} pipe_item;
+
+enum { PIPE_MESSAGE, PIPE_UPLOAD, PIPE_FRAME, PIPE_END };
+
+
+/*___________________________________________________
+   Pipeline Class:
+        With one decoder the decoder stage runs
+        decode_frame. With K workers the framer
+        routes each frame by PRN hash, a worker
+        decodes only the satellites it owns and
+        the sink stage merges what crosses PRNs,
+        store, dc corrections and publishers
+        :cpu: core of each stage, -1 unpinned,
+              workers take consecutive cores
+        :workers: decoder threads
+        :items: items each stage handled
+        :wait: seconds each stage waited on
+               its rings, mean of the workers
+        :active: seconds until each stage ended
+        :elapsed: seconds of the last run
+        :member functions:::::::::::::::::::::
+            -pin: core of a stage
+            -run: decode a binary file into a
+             SatelliteFile, its sink on the
+             sink stage
+            -report: stage busy shares and
+             ring occupancy
+_____________________________________________________
+
+*/
+class Pipeline{
+
+    public:
+
+    int cpu[PIPE_STAGES];
+    const int workers;
+    size_t items[PIPE_STAGES];
+    double wait[PIPE_STAGES];
+    double active[PIPE_STAGES];
+    double elapsed;
+
+    /*
+        @param block_bytes: reader block
+        @param blocks: blocks in flight
+        @param depth: slots of each frame and sink ring
+        @param k: decoder workers
+    */
+    Pipeline(size_t block_bytes = 1 << 20, int blocks = 8, size_t depth = 4096, int k = 1)
+        : workers(k < 1 ? 1 : k), elapsed(0), block_bytes(block_bytes), pool(blocks),
+          free_blocks(blocks), full_blocks(blocks)
+    {
+        for(int i = 0 ; i < PIPE_STAGES ; i++){ cpu[i] = -1; items[i] = 0; wait[i] = 0; active[i] = 0; }
+        for(std::vector<uint8_t>& b: pool) b.resize(block_bytes);
+        for(int w = 0 ; w < workers ; w++){
+            frames.emplace_back(new SpscRing<frame_view>(depth));
+            out.emplace_back(new SpscRing<pipe_item>(depth));
+        }
+    }
+
+    void pin(int stage, int core) { if(stage >= 0 && stage < PIPE_STAGES) cpu[stage] = core; }
+
+    /*
+        Same results as gps_file over the whole file,
+        the sink of file is fed by the sink stage.
+        Workers keep the order of each PRN, not the
+        order across PRNs
+        @return false if path can not be opened
+    */
+    bool run(const std::string& path, SatelliteFile& file)
+    {
+        FILE* fp = fopen(path.c_str(), "rb");
+        if(fp == NULL){
+            std::cout << "File can not be opened: " << path << std::endl;
+            return false;
+        }
+
+        /* a single decoder leaves formatting to the sink stage */
+        NdjsonSink* sink = file.sink;
+        if(workers == 1) file.sink = NULL;
+        for(int i = 0 ; i < (int)pool.size() ; i++) free_blocks.push(pipe_block{ i, 0 });
+
+        /* reader, framer, sink, then the workers */
+        int n = 3 + workers;
+        counts.assign(n, 0);
+        waits.assign(n, 0);
+        ends.assign(n, 0);
+
+        t0 = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        threads.emplace_back([&]{ reader(fp); ended(0); });
+        threads.emplace_back([&]{ framer(); ended(1); });
+        threads.emplace_back([&]{ drain(file, sink); ended(2); });
+        for(int w = 0 ; w < workers ; w++)
+            threads.emplace_back([&, w]{
+                if(workers == 1) decoder(file, sink != NULL);
+                else worker(w, file);
+                ended(3 + w);
+            });
+
+        pin_thread(threads[0], cpu[STAGE_READER]);
+        pin_thread(threads[1], cpu[STAGE_FRAMER]);
+        pin_thread(threads[2], cpu[STAGE_SINK]);
+        for(int w = 0 ; w < workers ; w++)
+            pin_thread(threads[3 + w], cpu[STAGE_DECODER] < 0 ? -1 : cpu[STAGE_DECODER] + w);
+        for(std::thread& t: threads) t.join();
+
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        const int slot[3] = { STAGE_READER, STAGE_FRAMER, STAGE_SINK };
+        for(int i = 0 ; i < 3 ; i++){
+            items[slot[i]] = counts[i];
+            wait[slot[i]] = waits[i];
+            active[slot[i]] = ends[i];
+        }
+        items[STAGE_DECODER] = 0;
+        wait[STAGE_DECODER] = active[STAGE_DECODER] = 0;
+        for(int w = 0 ; w < workers ; w++){
+            items[STAGE_DECODER] += counts[3 + w];
+            wait[STAGE_DECODER] += waits[3 + w] / workers;
+            active[STAGE_DECODER] += ends[3 + w] / workers;
+        }
+
+        pipe_block b;
+        while(free_blocks.pop(b)) {}
+        fclose(fp);
+        file.sink = sink;
+        if(sink) sink->flush();
+        return true;
+    }
+
+    void report(std::ostream& os) const
+    {
+        static const char* names[PIPE_STAGES] = { "reader", "framer", "decoder", "sink" };
+
+        double decoded = 0, merged = 0;
+        for(int w = 0 ; w < workers ; w++){
+            decoded += frames[w]->occupancy() / workers;
+            merged += out[w]->occupancy() / workers;
+        }
+        const double occ[PIPE_STAGES] = {
+            free_blocks.occupancy(), full_blocks.occupancy(), decoded, merged
+        };
+
+        os << std::fixed << std::setprecision(1);
+        for(int i = 0 ; i < PIPE_STAGES ; i++)
+        {
+            double busy = elapsed > 0 ? 100.0 * (active[i] - wait[i]) / elapsed : 0;
+            os << std::setw(8) << names[i] << "  items " << std::setw(10) << items[i]
+               << "  busy " << std::setw(5) << (busy < 0 ? 0 : busy) << "%"
+               << "  input ring " << std::setw(5) << 100.0 * occ[i] << "%" << std::endl;
+        }
+        os << "workers " << workers << ", elapsed " << std::setprecision(3) << elapsed << " s" << std::endl;
+    }
+
+    private:
+
+    size_t block_bytes;
+    std::chrono::steady_clock::time_point t0;
+    std::vector<std::vector<uint8_t>> pool;
+    SpscRing<pipe_block> free_blocks;                          /* framer to reader */
+    SpscRing<pipe_block> full_blocks;                          /* reader to framer */
+    std::vector<std::unique_ptr<SpscRing<frame_view>>> frames; /* framer to each decoder */
+    std::vector<std::unique_ptr<SpscRing<pipe_item>>> out;     /* each decoder to sink */
+    std::vector<size_t> counts;                                /* per thread */
+    std::vector<double> waits;
+    std::vector<double> ends;
+
+    static void pin_thread(std::thread& t, int core)
+    {
+        if(core < 0) return;
+#ifndef WIN32
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        pthread_setaffinity_np(t.native_handle(), sizeof set, &set);
+#else
+        SetThreadAffinityMask((HANDLE)t.native_handle(), (DWORD_PTR)1 << core);
+#endif
+    }
+
+    void ended(int thread)
+    {
+        ends[thread] = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    /* spin, then yield, waited time goes to the thread */
+    template <class Try>
+    void until(int thread, Try attempt)
+    {
+        if(attempt()) return;
+
+        auto t1 = std::chrono::steady_clock::now();
+        for(int spin = 0 ; !attempt() ; spin++)
+            if(spin >= PIPE_SPIN) std::this_thread::yield();
+        waits[thread] += std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+    }
+
+    /* fibonacci hash, neighbouring PRNs spread over workers */
+    int route(int prn) const
+    {
+        return (int)(((uint32_t)prn * 2654435761u >> 16) % (uint32_t)workers);
+    }
+
+    void reader(FILE* fp)
+    {
+        for(;;)
+        {
+            pipe_block b;
+            until(0, [&]{ return free_blocks.pop(b); });
+
+            b.len = fread(pool[b.slot].data(), 1, block_bytes, fp);
+            until(0, [&]{ return full_blocks.push(b); });
+            if(b.len == 0) return;
+            counts[0]++;
+        }
+    }
+
+    void framer()
+    {
+        ByteRing ring(block_bytes + UBX_HEAD + UBX_MAXLEN + 2);
+        UbxFramer f;
+
+        for(;;)
+        {
+            pipe_block b;
+            until(1, [&]{ return full_blocks.pop(b); });
+
+            if(b.len == 0){
+                frame_view end;
+                end.head.length = 0;
+                for(int w = 0 ; w < workers ; w++)
+                    until(1, [&]{ return frames[w]->push(end); });
+                return;
+            }
+
+            ring.write(pool[b.slot].data(), b.len);
+            until(1, [&]{ return free_blocks.push(b); });
+
+            f.each(ring, [&](const uint8_t* frame, size_t len)
+            {
+                frame_view v;
+                if(!UbxFramer::view(frame, len, v)) return;
+                SpscRing<frame_view>& r = *frames[route(v.head.svId)];
+                until(1, [&]{ return r.push(v); });
+                counts[1]++;
+            });
+        }
+    }
+
+    /* single decoder, the whole decode_frame */
+    void decoder(SatelliteFile& file, bool sink)
+    {
+        SpscRing<frame_view>& in = *frames[0];
+        SpscRing<pipe_item>& to = *out[0];
+        for(;;)
+        {
+            frame_view v;
+            until(3, [&]{ return in.pop(v); });
+
+            if(v.head.length == 0){
+                pipe_item end;
+                end.kind = PIPE_END;
+                until(3, [&]{ return to.push(end); });
+                return;
+            }
+
+            int prn = v.head.svId;
+            bool stored = file.decode_frame(v.head, v.words);
+            counts[3]++;
+            if(!sink) continue;
+
+            const Satellite* s = file.satellite[prn];
+            pipe_item m;
+            m.prn = (uint8_t)prn;
+            if(s->last_msg){
+                m.kind = PIPE_MESSAGE;
+                m.id = s->last_msg;
+                memcpy(m.words, v.words, sizeof m.words);
+                until(3, [&]{ return to.push(m); });
+            }
+            if(stored){
+                m.kind = PIPE_UPLOAD;
+                m.e = s->eph_mssg;
+                until(3, [&]{ return to.push(m); });
+            }
+        }
+    }
+
+    /*
+        Worker w of K, decodes into the satellites of
+        its PRNs only and hands the rest to the sink
+        stage
+    */
+    void worker(int w, SatelliteFile& file)
+    {
+        SpscRing<frame_view>& in = *frames[w];
+        SpscRing<pipe_item>& to = *out[w];
+        for(;;)
+        {
+            frame_view v;
+            until(3 + w, [&]{ return in.pop(v); });
+
+            pipe_item m;
+            if(v.head.length == 0){
+                m.kind = PIPE_END;
+                until(3 + w, [&]{ return to.push(m); });
+                return;
+            }
+
+            Satellite* s = file.satellite[v.head.svId];
+            s->take(v.head);
+            s->decode_words(v.words);
+
+            m.kind = PIPE_FRAME;
+            m.prn = v.head.svId;
+            m.id = s->last_msg;
+            m.stored = s->eph_updated;
+            memcpy(m.words, v.words, sizeof m.words);
+            if(m.stored) m.e = s->eph_mssg;
+            s->eph_updated = false;
+            s->dc_msg = 0;
+
+            until(3 + w, [&]{ return to.push(m); });
+            counts[3 + w]++;
+        }
+    }
+
+    /* sink stage, takes from the decoders in turn */
+    void drain(SatelliteFile& file, NdjsonSink* sink)
+    {
+        int done = 0, next = 0;
+        while(done < workers)
+        {
+            pipe_item m;
+            until(2, [&]{
+                for(int i = 0 ; i < workers ; i++){
+                    int r = (next + i) % workers;
+                    if(out[r]->pop(m)){ next = r + 1; return true; }
+                }
+                return false;
+            });
+
+            switch(m.kind)
+            {
+                case PIPE_END:     done++; continue;
+                case PIPE_MESSAGE: sink->message(m.prn, m.id, m.words); break;
+                case PIPE_UPLOAD:  sink->ephemeris(m.prn, m.e); break;
+                case PIPE_FRAME:   file.merge_frame(m.prn, m.id, m.words, m.stored ? &m.e : NULL); break;
+            }
+            counts[2]++;
+        }
+    }
+
+};
+
+
+#endif
@@ -0,0 +1,291 @@
+/****************************************
+ *
+ *   Pipeline test
+ *   Serial and parallel decode of one
+ *   synthetic capture must agree
+ *
+ *   The serial decode, the pipeline with
+ *   one decoder and the archive batch
+ *   write the same NDJSON bytes and fill
+ *   the same store. With 3, 4 and 8
+ *   workers the pipeline keeps the order
+ *   of each PRN only, its lines and
+ *   uploads are compared PRN by PRN
+ *
+ *   g++ -std=c++20 -O2 -pthread -I. pipeline_test.cpp -o pipeline_test
+ *   ./pipeline_test [temp dir]
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <iostream>
+#include <unistd.h>
+
+#include "pipeline.h"
+#include "archive_batch.h"
+
+#define TEST_ROUNDS  8          /* uploads of each satellite */
+#define TEST_SATS    32
+#define TEST_SEED    20211019
+#define TEST_WEEK    2168       /* week of the uploads, mod 8192 */
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if(ok) return;
+    std::cerr << "FAIL " << what << std::endl;
+    failures++;
+}
+
+
+/* ubx frame of a subframe, checksum over class to last word */
+static void frame(std::vector<uint8_t>& out, int prn, const uint32_t* words)
+{
+    uint8_t f[UBX_HEAD + LENGTH + 2] = { H1, H2, BRD_CLASS, BRD_ID, LENGTH, 0 };
+    uint8_t* p = f + UBX_HEAD;
+    p[0] = GNSS_ID; p[1] = (uint8_t)prn; p[2] = signal; p[3] = 0;
+    p[4] = 10;      p[5] = (uint8_t)(prn % 16); p[6] = 2; p[7] = 0;
+
+    for(int i = 0 ; i < 10 ; i++)
+        for(int j = 0 ; j < 4 ; j++)
+            p[8 + 4*i + j] = (uint8_t)(words[i] >> 8*j);
+
+    ck checksum;
+    for(int i = 2 ; i < UBX_HEAD + LENGTH ; i++) calculate(checksum, f[i]);
+    f[UBX_HEAD + LENGTH] = checksum.ck_a;
+    f[UBX_HEAD + LENGTH + 1] = checksum.ck_b;
+
+    out.insert(out.end(), f, f + sizeof f);
+}
+
+/*
+    Random words under a cnav header, 10 and 11 share toe,
+    10 has a real week. The crc24q of bits 0 - 275 goes in
+    bits 276 - 299
+*/
+static void subframe(uint32_t* w, int prn, int id, int tow, int toe, std::mt19937& rng)
+{
+    for(int i = 0 ; i < 10 ; i++) w[i] = (uint32_t)rng();
+
+    w[0] = 0x8Bu << 24 | (uint32_t)prn << 18 | (uint32_t)id << 12 | (uint32_t)(tow & 0xFFF);
+    if(id == 10) w[1] = (w[1] & ~(0x1FFFu << 13)) | (uint32_t)TEST_WEEK << 13;
+    if(id == 10) w[2] = (w[2] & ~(0x7FFu << 15)) | (uint32_t)toe << 15;
+    if(id == 11) w[1] = (w[1] & ~(0x7FFu << 15)) | (uint32_t)toe << 15;
+
+    uint8_t bytes[40];
+    for(int i = 0 ; i < 10 ; i++)
+        for(int j = 0 ; j < 4 ; j++)
+            bytes[4*i + j] = (uint8_t)(w[i] >> (24 - 8*j));
+
+    uint32_t crc = crc24q_bits(bytes, 276, false);
+    w[8] = (w[8] & ~0xFFFu) | crc >> 12;
+    w[9] = (w[9] & 0xFFFFFu) | (crc & 0xFFF) << 20;
+}
+
+/*
+    Every satellite sends its messages round by round,
+    satellites interleaved in a shuffled order. Some
+    frames are corrupted, some messages fail their crc
+    and junk is put between others
+*/
+static std::vector<uint8_t> capture()
+{
+    static const int ids[] = { 10, 11, 30, 12, 13, 31, 14, 33, 34, 37 };
+
+    std::mt19937 rng(TEST_SEED);
+    std::vector<uint8_t> out;
+    std::vector<int> prns;
+    for(int prn = 1 ; prn <= TEST_SATS ; prn++) prns.push_back(prn);
+
+    int n = 0;
+    for(int r = 0 ; r < TEST_ROUNDS ; r++)
+        for(int id: ids)
+        {
+            std::shuffle(prns.begin(), prns.end(), rng);
+            for(int prn: prns)
+            {
+                uint32_t w[10];
+                subframe(w, prn, id, n, r + 1, rng);
+                if(n % 89 == 0) w[3] ^= 0x100;
+                frame(out, prn, w);
+
+                if(++n % 97 == 0) out[out.size() - 20] ^= 0x40;
+                if(n % 61 == 0) for(int j = 0 ; j < 7 ; j++) out.push_back((uint8_t)rng());
+            }
+        }
+    return out;
+}
+
+static std::string slurp(const std::string& path)
+{
+    std::string s;
+    FILE* fp = fopen(path.c_str(), "rb");
+    if(fp == NULL) return s;
+
+    char buff[1 << 16];
+    size_t n;
+    while((n = fread(buff, 1, sizeof buff, fp)) > 0) s.append(buff, n);
+    fclose(fp);
+    return s;
+}
+
+/* lines by the first prn of each line, in order */
+static std::map<int, std::vector<std::string>> by_prn(const std::string& text)
+{
+    std::map<int, std::vector<std::string>> m;
+    size_t at = 0;
+    while(at < text.size())
+    {
+        size_t end = text.find('\n', at);
+        if(end == std::string::npos) end = text.size();
+        std::string line = text.substr(at, end - at);
+
+        size_t k = line.find("\"prn\":");
+        m[k == std::string::npos ? 0 : atoi(line.c_str() + k + 6)].push_back(line);
+        at = end + 1;
+    }
+    return m;
+}
+
+/* all fields when corrected, else the fields dc corrections leave */
+static bool same_store(const EphemerisStore& a, const EphemerisStore& b, bool corrected)
+{
+    for(int prn = 1 ; prn <= TEST_SATS ; prn++)
+    {
+        const std::vector<eph>& x = a.ephemerides(prn);
+        const std::vector<eph>& y = b.ephemerides(prn);
+        if(x.size() != y.size()) return false;
+
+        for(size_t i = 0 ; i < x.size() ; i++)
+        {
+            if(x[i].TOE != y[i].TOE || x[i].week != y[i].week || x[i].toc != y[i].toc) return false;
+            if(!corrected) continue;
+            if(x[i].clock_bias != y[i].clock_bias || x[i].clock_drift != y[i].clock_drift
+               || x[i].sqrtA != y[i].sqrtA || x[i].M0 != y[i].M0 || x[i].OMEGA != y[i].OMEGA
+               || x[i].I0 != y[i].I0 || x[i].omega != y[i].omega
+               || x[i].IODE != y[i].IODE || x[i].IODC != y[i].IODC) return false;
+        }
+    }
+    return true;
+}
+
+/* gps_file over a ring fed in odd sized reads */
+static void serial(const std::vector<uint8_t>& bytes, SatelliteFile& file)
+{
+    ByteRing ring(1 << 16);
+    UbxFramer f;
+    for(size_t i = 0 ; i < bytes.size() ; i += 1000)
+    {
+        ring.write(bytes.data() + i, std::min((size_t)1000, bytes.size() - i));
+        f.scan(ring, file);
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    std::string dir = argc > 1 ? argv[1] : "/tmp";
+    std::string stem = dir + "/pipeline_test_" + std::to_string(getpid());
+    std::string path = stem + ".ubx";
+
+    std::vector<uint8_t> bytes = capture();
+    FILE* fp = fopen(path.c_str(), "wb");
+    if(fp == NULL){
+        std::cerr << "capture can not be written: " << path << std::endl;
+        return 1;
+    }
+    fwrite(bytes.data(), 1, bytes.size(), fp);
+    fclose(fp);
+
+    /* decoders print as they go */
+    std::streambuf* out = std::cout.rdbuf(NULL);
+
+    /* serial reference */
+    SatelliteFile ref;
+    NdjsonSink ref_sink;
+    ref_sink.open(stem + ".serial.ndjson");
+    ref.sink = &ref_sink;
+    serial(bytes, ref);
+    ref_sink.close();
+    std::string expect = slurp(stem + ".serial.ndjson");
+    std::map<int, std::vector<std::string>> expect_prn = by_prn(expect);
+
+    size_t uploads = 0;
+    for(int prn = 1 ; prn <= TEST_SATS ; prn++) uploads += ref.ephemerides.ephemerides(prn).size();
+
+    std::vector<std::string> results;
+    const int workers[] = { 1, 3, 4, 8 };
+    for(int k: workers)
+    {
+        std::string name = "pipeline, " + std::to_string(k) + " workers";
+        std::string ndjson = stem + ".pipe" + std::to_string(k) + ".ndjson";
+
+        /* small blocks and rings, frames cross blocks and rings fill */
+        Pipeline p(1000, 4, 64, k);
+        SatelliteFile file;
+        NdjsonSink sink;
+        sink.open(ndjson);
+        file.sink = &sink;
+        bool ran = p.run(path, file);
+        sink.close();
+        std::string got = slurp(ndjson);
+        remove(ndjson.c_str());
+
+        check(ran, name + ": run");
+        if(k == 1){
+            check(got == expect, name + ": ndjson differs from serial");
+            check(same_store(ref.ephemerides, file.ephemerides, true), name + ": store differs from serial");
+        }
+        else{
+            check(by_prn(got) == expect_prn, name + ": ndjson of a prn differs from serial");
+            check(same_store(ref.ephemerides, file.ephemerides, false), name + ": uploads differ from serial");
+        }
+        results.push_back(name + ": " + std::to_string(p.items[STAGE_DECODER]) + " frames");
+    }
+
+    for(int k: workers)
+    {
+        std::string name = "archive batch, " + std::to_string(k) + " threads";
+        std::string ndjson = stem + ".batch" + std::to_string(k) + ".ndjson";
+
+        /* chunks of a few frames, each resyncs */
+        ArchiveBatch b(k, 4096);
+        NdjsonSink sink;
+        sink.open(ndjson);
+        b.add(path, &sink);
+        bool ran = b.run();
+        sink.close();
+        std::string got = slurp(ndjson);
+        remove(ndjson.c_str());
+
+        check(ran, name + ": run");
+        check(got == expect, name + ": ndjson differs from serial");
+        check(same_store(ref.ephemerides, b.file(0).ephemerides, true), name + ": store differs from serial");
+        results.push_back(name);
+    }
+
+    std::cout.rdbuf(out);
+    std::cout.clear();
+
+    remove(path.c_str());
+    remove((stem + ".serial.ndjson").c_str());
+
+    check(uploads >= TEST_SATS, "serial decode stored too few uploads");
+    check(expect_prn.size() > TEST_SATS / 2, "serial decode wrote too few prns");
+
+    std::cout << bytes.size() << " bytes, " << std::count(expect.begin(), expect.end(), '\n')
+              << " lines, " << uploads << " uploads" << std::endl;
+    for(const std::string& r: results) std::cout << r << std::endl;
+    std::cout << (failures ? "pipeline test failed" : "pipeline test passed") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,402 @@
+/****************************************
+ *
+ *   Rinex 4 navigation writer
+ *   RINEX 4.00 EPH G CNAV, ION, EOP and
+ *   STO records straight from decoded
+ *   message 10, 11, 30, 32, 33 and 35
+ *
+ *   Records stream through a fixed
+ *   buffer flushed with fwrite, CNAV
+ *   terms RINEX 3 can not hold (Adot,
+ *   delta n0 dot, ISCs, URA indices)
+ *   are kept
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef RINEX4_NAV_WRITER_H
+#define RINEX4_NAV_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "gps_l2_satellite.h"
+#include "ggto_service.h"
+#include "rinex_format.h"
+
+#define RNX4_VERSION  4.00
+#define RNX4_BUFFER   (1 << 20)          /* output buffer (bytes) */
+#define RNX4_RECORD   (10 * RNX_LINE)    /* longest record */
+#define CNAV_MSG_SEC  12                 /* cnav message length on L2C (s) */
+#define TOE_SLOTS     2016               /* toe / 300 in a week */
+#define RNX4_TOW_WEEK 100800             /* 6 s tow counts in a week */
+
+
+/*___________________________________________________
+   Rinex4NavWriter Class:
+        :program, agency: PGM / RUN BY fields
+        :member functions:::::::::::::::::::::
+            -open, close: output file
+            -header: header, leap seconds of
+             a message 33
+            -eph_record, ion, eop, sto: one record
+            -write: every record of a file
+_____________________________________________________
+
+*/
+class Rinex4NavWriter : public RinexFormat{
+
+    public:
+
+    std::string program;
+    std::string agency;
+
+    explicit Rinex4NavWriter(size_t capacity = RNX4_BUFFER)
+        : program("ubx-gps-protocol"), agency(""), fp(NULL)
+    {
+        buf.resize(capacity < 4 * RNX4_RECORD ? 4 * RNX4_RECORD : capacity);
+        p = buf.data();
+    }
+
+    ~Rinex4NavWriter() { close(); }
+
+    bool open(const std::string& path)
+    {
+        close();
+        fp = fopen(path.c_str(), "wb");
+        if(fp == NULL){
+            std::cout << "Rinex file can not be opened: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /* flush and close */
+    void close()
+    {
+        if(fp == NULL) return;
+        flush();
+        fclose(fp);
+        fp = NULL;
+    }
+
+    void header(const Msg_Type_33* utc = NULL)
+    {
+        reserve();
+        char* line = p;
+        fixed(RNX4_VERSION, 9, 2);
+        pad(line + 20);
+        text("N: GNSS NAV DATA");
+        pad(line + 40);
+        text("G: GPS");
+        label(line, "RINEX VERSION / TYPE");
+
+        run_by(program.c_str(), agency.c_str());
+
+        if(utc)
+        {
+            line = p;
+            integer(utc->deltatLS, 6);
+            integer(utc->deltatLSF, 6);
+            integer(utc->WNLSF, 6);
+            integer(utc->DN, 6);
+            text("GPS");
+            label(line, "LEAP SECONDS");
+        }
+
+        line = p;
+        label(line, "END OF HEADER");
+    }
+
+    /* ephemeris of message 10, 11 of one toe and the 30 after them */
+    void eph_record(int prn, const Msg_Type_10& m10, const Msg_Type_11& m11, const Msg_Type_30& m30)
+    {
+        reserve();
+        int week = full_week(m10.WN);
+
+        start("EPH", prn);
+        char* line = p;
+        sat(prn);
+        *p++ = ' ';
+        epoch(gpst2time(week, m30.toc));
+        sci(m30.af0);
+        sci(m30.af1);
+        sci(m30.af2);
+        end(line);
+
+        orbit(m10.Adot, m11.crsn, m10.delntan0 * PI, m10.M0n * PI);
+        orbit(m11.cucn, m10.en, m11.cusn, sqrt(AREF + m10.deltaA));
+        orbit(m10.top, m11.cicn, m11.omega0n * PI, m11.cisn);
+        orbit(m11.i0n * PI, m11.crcn, m10.omegan * PI, (m11.delomegadot + OMEGADOTREF) * PI);
+        orbit(m11.i0nDOT * PI, m10.deln0dot * PI, m30.URANED0, m30.URANED1);
+        orbit(m10.URAi, m10.L1_health << 2 | m10.L2_health << 1 | m10.L5_health,
+              m30.TGD, m30.URANED2);
+        orbit(m30.ISCL1CA, m30.ISCL2C, m30.ISCL5I5, m30.ISCL5Q5);
+
+        line = p;
+        text("    ");
+        sci(week_tow(transmission(m10.TOW)));
+        sci(week);
+        end(line);
+    }
+
+    /* klobuchar of message 30, epoch is the transmission time */
+    void ion(int prn, int week, const Msg_Type_30& m)
+    {
+        reserve();
+        start("ION", prn);
+        char* line = p;
+        text("    ");
+        epoch(gpst2time(week, transmission(m.TOW)));
+        sci(m.alpha[0]);
+        sci(m.alpha[1]);
+        sci(m.alpha[2]);
+        end(line);
+
+        orbit(m.alpha[3], m.beta[0], m.beta[1], m.beta[2]);
+
+        line = p;
+        text("    ");
+        sci(m.beta[3]);
+        end(line);
+    }
+
+    /* earth orientation of message 32 at tEOP */
+    void eop(int prn, int week, const Msg_Type_32& m)
+    {
+        reserve();
+        start("EOP", prn);
+        char* line = p;
+        text("    ");
+        epoch(gpst2time(week, m.tEOP));
+        sci(m.PM_X);
+        sci(m.PM_Xdot);
+        sci(0);
+        end(line);
+
+        line = p;
+        pad(line + 23);
+        sci(m.PM_Y);
+        sci(m.PM_Ydot);
+        sci(0);
+        end(line);
+
+        orbit(week_tow(transmission(m.TOW)), m.deltaUTGPS, m.deltaUTGPSdot, 0);
+    }
+
+    /* gps - utc of message 33 */
+    void sto(int prn, const Msg_Type_33& m)
+    {
+        reserve();
+        offset(prn, gpst2time(full_week(m.WNot), m.tot), "GPUT", "UTC(USNO)");
+        orbit(week_tow(transmission(m.TOW)), m.A0, m.A1, m.A2);
+    }
+
+    /*
+        Gps - gnss of message 35, GLONASS goes out as
+        GLGP (glonass - gps) so the polynomial flips
+    */
+    void sto(int prn, const Msg_Type_35& m)
+    {
+        if(m.GNSSID != GGTO_GAL && m.GNSSID != GGTO_GLO) return;
+
+        reserve();
+        double s = m.GNSSID == GGTO_GAL ? 1.0 : -1.0;
+        offset(prn, gpst2time(full_week(m.WNGGTO), m.tGGTO),
+               m.GNSSID == GGTO_GAL ? "GPGA" : "GLGP", "");
+        orbit(week_tow(transmission(m.TOW)), s * m.A0GGTO, s * m.A1GGTO,
+              s * m.A2GGTO);
+    }
+
+    /*
+        Every record of a decoded file, by satellite,
+        a record only when its content changes
+        @return false if the file can not be opened
+    */
+    bool write(const std::string& path, const SatelliteFile& file)
+    {
+        if(!open(path)) return false;
+
+        const Msg_Type_33* utc = NULL;
+        for(int i = 1 ; i <= MAXPRN ; i++){
+            const Satellite* s = file.satellite[i];
+            if(!s->m33.empty() && (utc == NULL || s->m33.back().TOW > utc->TOW))
+                utc = &s->m33.back();
+        }
+        header(utc);
+
+        for(int prn = 1 ; prn <= MAXPRN ; prn++) satellite(prn, *file.satellite[prn]);
+
+        close();
+        return true;
+    }
+
+    private:
+
+    FILE* fp;
+    std::vector<char> buf;
+
+    void flush()
+    {
+        size_t n = p - buf.data();
+        if(fp && n) fwrite(buf.data(), 1, n, fp);
+        p = buf.data();
+    }
+
+    /* room for the longest record */
+    void reserve()
+    {
+        if((size_t)(buf.data() + buf.size() - p) < RNX4_RECORD) flush();
+    }
+
+    /* start of message, tow count is of the next one */
+    static double transmission(uint32_t tow)
+    {
+        return tow * 6.0 - CNAV_MSG_SEC;
+    }
+
+    /* transmission time as seconds of the week, negative wraps back */
+    static double week_tow(double sec)
+    {
+        return sec < 0 ? sec + 604800 : sec;
+    }
+
+    /* > EPH G01 CNAV */
+    void start(const char* type, int prn)
+    {
+        char* line = p;
+        text("> ");
+        text(type);
+        *p++ = ' ';
+        sat(prn);
+        text(" CNAV");
+        end(line);
+    }
+
+    void sat(int prn)
+    {
+        *p++ = 'G';
+        integer(prn, 2, true);
+    }
+
+    /* sto epoch line, 4X,I4,5(1X,I2.2),3(1X,A18), sbas id blank */
+    void offset(int prn, gtime_t t, const char* id, const char* utc_id)
+    {
+        start("STO", prn);
+        char* line = p;
+        text("    ");
+        epoch(t);
+        *p++ = ' ';
+        text(id, 18);
+        pad(line + 62);
+        text(utc_id, 18);
+        end(line);
+    }
+
+    /* broadcast orbit line, 4X,4D19.12 */
+    void orbit(double a, double b, double c, double d)
+    {
+        char* line = p;
+        text("    ");
+        sci(a);
+        sci(b);
+        sci(c);
+        sci(d);
+        end(line);
+    }
+
+    /* records of one satellite, messages in reception order */
+    void satellite(int prn, const Satellite& s)
+    {
+        /* first message 11 of each toe */
+        std::vector<int> m11(TOE_SLOTS, -1);
+        for(size_t i = 0 ; i < s.m11.size() ; i++){
+            int k = slot(s.m11[i].toe);
+            if(k >= 0 && m11[k] < 0) m11[k] = (int)i;
+        }
+        std::vector<int64_t> t10 = tows(s.m10), t11 = tows(s.m11), t30 = tows(s.m30);
+
+        int week = s.m10.empty() ? sessionweek() : full_week(s.m10.back().WN);
+
+        /*
+            the clock of an upload is the first 30 after
+            its 10 and 11, the last one before if none
+            follows, whatever toc it carries
+        */
+        long last_toe = -1;
+        for(size_t i = 0 ; i < s.m10.size() ; i++)
+        {
+            const Msg_Type_10& m = s.m10[i];
+            int k = slot(m.toe);
+            if(k < 0 || (long)m.toe == last_toe || m11[k] < 0 || t30.empty()) continue;
+
+            int64_t t = std::max(t10[i], t11[m11[k]]);
+            size_t j = std::lower_bound(t30.begin(), t30.end(), t) - t30.begin();
+            if(j == t30.size()) j--;
+            eph_record(prn, m, s.m11[m11[k]], s.m30[j]);
+            last_toe = m.toe;
+        }
+
+        for(size_t i = 0 ; i < s.m30.size() ; i++)
+            if(i == 0 || !same(s.m30[i].alpha, s.m30[i-1].alpha, 4)
+                      || !same(s.m30[i].beta, s.m30[i-1].beta, 4))
+                ion(prn, week, s.m30[i]);
+
+        for(size_t i = 0 ; i < s.m32.size() ; i++){
+            const Msg_Type_32& m = s.m32[i];
+            if(i == 0 || m.tEOP != s.m32[i-1].tEOP || m.PM_X != s.m32[i-1].PM_X
+               || m.PM_Y != s.m32[i-1].PM_Y || m.deltaUTGPS != s.m32[i-1].deltaUTGPS)
+                eop(prn, week, m);
+        }
+
+        for(size_t i = 0 ; i < s.m33.size() ; i++){
+            const Msg_Type_33& m = s.m33[i];
+            if(i == 0 || m.tot != s.m33[i-1].tot || m.A0 != s.m33[i-1].A0
+               || m.A1 != s.m33[i-1].A1)
+                sto(prn, m);
+        }
+
+        for(size_t i = 0 ; i < s.m35.size() ; i++){
+            const Msg_Type_35& m = s.m35[i];
+            if(i == 0 || m.GNSSID != s.m35[i-1].GNSSID || m.tGGTO != s.m35[i-1].tGGTO
+               || m.A0GGTO != s.m35[i-1].A0GGTO || m.A1GGTO != s.m35[i-1].A1GGTO)
+                sto(prn, m);
+        }
+    }
+
+    /* tow counts in reception order, unwrapped over week rollovers */
+    template <class M>
+    static std::vector<int64_t> tows(const std::vector<M>& v)
+    {
+        std::vector<int64_t> t(v.size());
+        int64_t week = 0;
+        for(size_t i = 0 ; i < v.size() ; i++){
+            if(i > 0 && v[i].TOW < v[i-1].TOW) week += RNX4_TOW_WEEK;
+            t[i] = week + v[i].TOW;
+        }
+        return t;
+    }
+
+    static int slot(double t)
+    {
+        int k = (int)(t / 300);
+        return k >= 0 && k < TOE_SLOTS ? k : -1;
+    }
+
+    static bool same(const double* a, const double* b, int n)
+    {
+        for(int i = 0 ; i < n ; i++) if(a[i] != b[i]) return false;
+        return true;
+    }
+
+};
+
+
+#endif
\ No newline at end of file
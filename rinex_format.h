@@ -0,0 +1,144 @@
+/****************************************
+ *
+ *   Rinex formatting
+ *   Fixed column fields of rinex files
+ *   written with std::to_chars at a
+ *   cursor into a caller owned buffer
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef RINEX_FORMAT_H
+#define RINEX_FORMAT_H
+
+#include <string.h>
+#include <time.h>
+#include <charconv>
+#include <cmath>
+
+#include "gpstime.h"
+
+#define RNX_LINE      81         /* 80 columns and newline */
+
+
+/*___________________________________________________
+   RinexFormat Class:
+        :p: write cursor, buffer space is the
+            caller's
+        :member functions:::::::::::::::::::::
+            -sci: fortran D field
+            -fixed, integer, text: plain fields
+            -epoch: yyyy mm dd hh mm ss
+            -run_by: PGM / RUN BY / DATE line
+            -label, end: line endings
+_____________________________________________________
+
+*/
+class RinexFormat{
+
+    protected:
+
+    char* p;
+
+    /* fortran D format, right aligned in width */
+    void sci(double v, int width = 19, int digits = 12)
+    {
+        if(fabs(v) < 1E-99) v = 0;
+
+        char tmp[32];
+        std::to_chars_result r = std::to_chars(tmp, tmp + sizeof tmp, v,
+                                               std::chars_format::scientific, digits);
+        int n = (int)(r.ptr - tmp);
+        char* e = (char*)memchr(tmp, 'e', n);
+        if(e) *e = 'D';
+
+        for(int i = n ; i < width ; i++) *p++ = ' ';
+        memcpy(p, tmp, n);
+        p += n;
+    }
+
+    void fixed(double v, int width, int digits)
+    {
+        char tmp[32];
+        std::to_chars_result r = std::to_chars(tmp, tmp + sizeof tmp, v,
+                                               std::chars_format::fixed, digits);
+        int n = (int)(r.ptr - tmp);
+        for(int i = n ; i < width ; i++) *p++ = ' ';
+        memcpy(p, tmp, n);
+        p += n;
+    }
+
+    /* right aligned, zero filled with zeros set (I2.2) */
+    void integer(long v, int width, bool zeros = false)
+    {
+        char tmp[24];
+        std::to_chars_result r = std::to_chars(tmp, tmp + sizeof tmp, v);
+        int n = (int)(r.ptr - tmp);
+        for(int i = n ; i < width ; i++) *p++ = zeros ? '0' : ' ';
+        memcpy(p, tmp, n);
+        p += n;
+    }
+
+    void text(const char* s, size_t width = 80)
+    {
+        size_t n = strlen(s);
+        if(n > width) n = width;
+        memcpy(p, s, n);
+        p += n;
+    }
+
+    void pad(char* to)
+    {
+        while(p < to) *p++ = ' ';
+    }
+
+    /* I4,5(1X,I2.2) */
+    void epoch(gtime_t t)
+    {
+        double ep[6];
+        time2epoch(t, ep);
+        integer((long)ep[0], 4);
+        for(int i = 1 ; i < 6 ; i++){
+            *p++ = ' ';
+            integer((long)ep[i], 2, true);
+        }
+    }
+
+    /* PGM / RUN BY / DATE fields, file creation time in utc */
+    void run_by(const char* pgm, const char* agency)
+    {
+        char date[32];
+        time_t now = ::time(NULL);
+        strftime(date, sizeof date, "%Y%m%d %H%M%S UTC", gmtime(&now));
+
+        char* line = p;
+        text(pgm, 20);
+        pad(line + 20);
+        text(agency, 20);
+        pad(line + 40);
+        text(date, 20);
+        label(line, "PGM / RUN BY / DATE");
+    }
+
+    /* header label in columns 61-80 */
+    void label(char* line, const char* name)
+    {
+        pad(line + 60);
+        text(name, 20);
+        end(line);
+    }
+
+    /* trailing blanks of a line are not written */
+    void end(char* line)
+    {
+        while(p > line && p[-1] == ' ') p--;
+        *p++ = '\n';
+    }
+
+};
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,324 @@
+/****************************************
+ *
+ *   Rinex navigation reader
+ *   Gps ephemerides of RINEX 3 and 4
+ *   navigation files (LNAV, and CNAV
+ *   of version 4) into the ephemeris
+ *   store
+ *
+ *   The file is memory mapped, split at
+ *   record boundaries and the pieces are
+ *   parsed in parallel with from_chars,
+ *   fortran D exponents included
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef RINEX_NAV_READER_H
+#define RINEX_NAV_READER_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <charconv>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cmath>
+#include <iostream>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "ephemeris_store.h"
+#include "rinex_format.h"
+
+#define RNX_FIELD     19         /* D19.12 field width */
+#define RNX_LNAV_FIT  4          /* lnav fit interval for flag 0 (h) */
+#define RNX_CHUNK_MIN (1 << 20)  /* smallest piece per thread (bytes) */
+
+
+/*___________________________________________________
+   RinexNavReader Class:
+        :threads: parser count, 0 for all cores
+        :version: rinex version of the last file
+        :records: gps ephemerides of the last file
+        :member functions:::::::::::::::::::::
+            -read: map a file and load it
+            -parse: load a file already in memory
+_____________________________________________________
+
+*/
+class RinexNavReader{
+
+    public:
+
+    int threads;
+    double version;
+    size_t records;
+
+    explicit RinexNavReader(int workers = 0) : threads(workers), version(0), records(0) {}
+
+    /*
+        Gps ephemerides of a navigation file into store
+        @return false if the file can not be read or
+                is not a rinex 3 / 4 navigation file
+    */
+    bool read(const std::string& path, EphemerisStore& store)
+    {
+#ifndef WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0){
+            std::cout << "Rinex file can not be opened: " << path << std::endl;
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size == 0){ ::close(fd); return false; }
+
+        size_t size = (size_t)st.st_size;
+        void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(map == MAP_FAILED) return false;
+        madvise(map, size, MADV_SEQUENTIAL);
+        madvise(map, size, MADV_WILLNEED);
+
+        bool ok = parse((const char*)map, size, store);
+        munmap(map, size);
+        return ok;
+#else
+        FILE* fp = fopen(path.c_str(), "rb");
+        if(fp == NULL){
+            std::cout << "Rinex file can not be opened: " << path << std::endl;
+            return false;
+        }
+        std::vector<char> data;
+        char block[1 << 16];
+        size_t n;
+        while((n = fread(block, 1, sizeof block, fp)) > 0)
+            data.insert(data.end(), block, block + n);
+        fclose(fp);
+        return parse(data.data(), data.size(), store);
+#endif
+    }
+
+    bool parse(const char* data, size_t size, EphemerisStore& store)
+    {
+        const char* end = data + size;
+        const char* body = header(data, end);
+        records = 0;
+        if(body == NULL || version < 3 || version >= 5) return false;
+
+        /* pieces start at a record line */
+        int n = threads > 0 ? threads : (int)std::thread::hardware_concurrency();
+        size_t most = (size_t)(end - body) / RNX_CHUNK_MIN + 1;
+        if(n < 1) n = 1;
+        if((size_t)n > most) n = (int)most;
+
+        std::vector<const char*> cut(n + 1);
+        cut[0] = body;
+        cut[n] = end;
+        for(int k = 1 ; k < n ; k++)
+            cut[k] = record_start(body + (end - body) * k / n, end);
+
+        std::vector<std::vector<std::pair<int, eph> > > out(n);
+        std::vector<std::thread> pool;
+        for(int k = 1 ; k < n ; k++)
+            pool.push_back(std::thread([&, k](){ piece(cut[k], cut[k+1], out[k]); }));
+        piece(cut[0], cut[1], out[0]);
+        for(auto& t: pool) t.join();
+
+        /* in file order, a later upload of a toe wins */
+        for(const auto& part: out)
+            for(const auto& r: part) store.insert(r.first, r.second);
+
+        for(const auto& part: out) records += part.size();
+        return true;
+    }
+
+    private:
+
+    /* header lines up to END OF HEADER, NULL if there is none */
+    const char* header(const char* s, const char* end)
+    {
+        version = 0;
+        for(bool first = true ; s < end ; first = false)
+        {
+            const char* e = line_end(s, end);
+            if(first) version = number(s, e, 0, 9);
+            if(e - s >= 73 && memcmp(s + 60, "END OF HEADER", 13) == 0)
+                return next_line(e, end);
+            s = next_line(e, end);
+        }
+        return NULL;
+    }
+
+    /* first record line at or after s */
+    const char* record_start(const char* s, const char* end) const
+    {
+        s = next_line(line_end(s, end), end);
+        while(s < end && !(version >= 4 ? *s == '>' : *s != ' ' && *s != '\r' && *s != '\n'))
+            s = next_line(line_end(s, end), end);
+        return s;
+    }
+
+    void piece(const char* s, const char* end, std::vector<std::pair<int, eph> >& out) const
+    {
+        while(s < end)
+        {
+            bool cnav = false;
+
+            if(version >= 4){
+                /* > EPH G01 LNAV, other records are skipped */
+                const char* e = line_end(s, end);
+                bool gps = e - s >= 14 && *s == '>' && memcmp(s + 2, "EPH G", 5) == 0;
+                cnav = gps && memcmp(s + 10, "CNAV", 4) == 0;
+                bool lnav = gps && memcmp(s + 10, "LNAV", 4) == 0;
+                s = next_line(e, end);
+                if(!lnav && !cnav){
+                    while(s < end && *s != '>') s = next_line(line_end(s, end), end);
+                    continue;
+                }
+            }
+
+            if(s >= end) break;
+            if(*s != 'G'){
+                /* record of another system, its continuation lines start blank */
+                s = next_line(line_end(s, end), end);
+                while(s < end && *s == ' ') s = next_line(line_end(s, end), end);
+                continue;
+            }
+
+            /* epoch line and the broadcast orbit lines */
+            const char* ln[9];
+            int lines = cnav ? 9 : 8;
+            int got = 0;
+            for( ; got < lines && s < end ; got++){
+                ln[got] = s;
+                s = next_line(line_end(s, end), end);
+            }
+            if(got < lines) break;
+
+            double v[4 * 9];
+            for(int i = 0 ; i < 3 ; i++)
+                v[i + 1] = number(ln[0], line_end(ln[0], end), 23 + i * RNX_FIELD, RNX_FIELD);
+            for(int l = 1 ; l < lines ; l++){
+                const char* e = line_end(ln[l], end);
+                for(int i = 0 ; i < 4 ; i++)
+                    v[l * 4 + i] = number(ln[l], e, 4 + i * RNX_FIELD, RNX_FIELD);
+            }
+
+            int prn = (int)number(ln[0], ln[0] + 3, 1, 2);
+            if(prn < 1 || prn > MAXPRN) continue;
+
+            eph e = cnav ? from_cnav(v) : from_lnav(v);
+            toc(ln[0], line_end(ln[0], end), e);
+            if(cnav) e.TOE = e.toc;
+            out.push_back(std::make_pair(prn, e));
+        }
+    }
+
+    /* toc of the epoch line, seconds from the start of the record week */
+    static void toc(const char* s, const char* e, eph& r)
+    {
+        double ep[6];
+        for(int i = 0 ; i < 6 ; i++)
+            ep[i] = number(s, e, i == 0 ? 4 : 4 + i * 3 + 2, i == 0 ? 4 : 2);
+
+        int week;
+        r.toc = time2gpst(epoch2time(ep), &week);
+        if(week != (int)r.week) r.toc += (week - r.week) * 604800.0;
+    }
+
+    /* v[1..3] clock, v[4 l + i] orbit line l, field i */
+    static eph from_lnav(const double* v)
+    {
+        eph e = eph();
+        e.clock_bias = v[1];  e.clock_drift = v[2];   e.clock_rate = v[3];
+        e.IODE = v[4];        e.Crs = v[5];           e.delta_n = v[6];    e.M0 = v[7];
+        e.Cuc = v[8];         e.eccentricity = v[9];  e.Cus = v[10];       e.sqrtA = v[11];
+        e.TOE = v[12];        e.Cic = v[13];          e.OMEGA = v[14];     e.Cis = v[15];
+        e.I0 = v[16];         e.Crc = v[17];          e.omega = v[18];     e.OMEGA_DOT = v[19];
+        e.IDOT = v[20];       e.l2_codes = v[21];     e.week = v[22];      e.l2_p_flag = v[23];
+        e.sv_acc = ura_index(v[24]);
+        e.sv_health = (uint8_t)v[25];
+        e.tgd = v[26];        e.IODC = v[27];
+        e.trans_time = (uint32_t)v[28];
+        e.fit_interval = v[29] > 0 ? (uint8_t)v[29] : RNX_LNAV_FIT;
+        return e;
+    }
+
+    /* rinex 4 cnav, toe is the toc */
+    static eph from_cnav(const double* v)
+    {
+        eph e = eph();
+        e.clock_bias = v[1];  e.clock_drift = v[2];   e.clock_rate = v[3];
+        e.Adot = v[4];        e.Crs = v[5];           e.delta_n = v[6];    e.M0 = v[7];
+        e.Cuc = v[8];         e.eccentricity = v[9];  e.Cus = v[10];       e.sqrtA = v[11];
+        e.Cic = v[13];        e.OMEGA = v[14];        e.Cis = v[15];
+        e.I0 = v[16];         e.Crc = v[17];          e.omega = v[18];     e.OMEGA_DOT = v[19];
+        e.IDOT = v[20];       e.delta_n_dot = v[21];
+        e.sv_acc = ura_index_ed((int)v[24]);
+        e.sv_health = (uint8_t)v[25];
+        e.tgd = v[26];
+        e.trans_time = (uint32_t)v[32];
+        e.week = v[33];
+        e.fit_interval = EPH_FIT_HOURS;
+        return e;
+    }
+
+    /* smallest ura index covering meters, IS-GPS-200 20.3.3.3.1.3 */
+    static uint8_t ura_index(double meters)
+    {
+        static const double ura[] = { 2.4, 3.4, 4.85, 6.85, 9.65, 13.65, 24.0, 48.0,
+                                      96.0, 192.0, 384.0, 768.0, 1536.0, 3072.0,
+                                      6144.0 };
+        uint8_t i = 0;
+        while(i < 14 && ura[i] < meters) i++;
+        return i;
+    }
+
+    /* field at column col of width w, blank or missing is 0 */
+    static double number(const char* s, const char* e, int col, int w)
+    {
+        if(e - s <= col) return 0;
+        const char* a = s + col;
+        const char* b = e - s < col + w ? e : a + w;
+        while(a < b && *a == ' ') a++;
+        if(a == b) return 0;
+
+        char tmp[32];
+        size_t n = (size_t)(b - a) < sizeof tmp ? (size_t)(b - a) : sizeof tmp;
+        for(size_t i = 0 ; i < n ; i++)
+            tmp[i] = (a[i] == 'D' || a[i] == 'd') ? 'E' : a[i];
+
+        /* from_chars does not take a leading + */
+        const char* f = tmp[0] == '+' ? tmp + 1 : tmp;
+        double x = 0;
+        std::from_chars(f, tmp + n, x);
+        return x;
+    }
+
+    static const char* line_end(const char* s, const char* end)
+    {
+        const char* e = (const char*)memchr(s, '\n', end - s);
+        if(e == NULL) e = end;
+        if(e > s && e[-1] == '\r') e--;
+        return e;
+    }
+
+    static const char* next_line(const char* e, const char* end)
+    {
+        while(e < end && *e != '\n') e++;
+        return e < end ? e + 1 : end;
+    }
+
+};
+
+
+#endif
\ No newline at end of file
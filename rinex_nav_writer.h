@@ -0,0 +1,209 @@
+/****************************************
+ *
+ *   Rinex navigation writer
+ *   Gps ephemerides of the store as a
+ *   RINEX 3.04 navigation file
+ *
+ *   Header and records are formatted
+ *   with std::to_chars into one buffer
+ *   sized up front, then written with a
+ *   single fwrite
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef RINEX_NAV_WRITER_H
+#define RINEX_NAV_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "ephemeris_store.h"
+#include "iono_engine.h"
+#include "time_service.h"
+#include "rinex_format.h"
+
+#define RNX_VERSION   3.04
+#define RNX_REC_LINES 8          /* lines of a gps record */
+#define RNX_HDR_LINES 16         /* header lines at most */
+
+
+/*___________________________________________________
+   RinexNavWriter Class:
+        :program, agency: PGM / RUN BY fields
+        :member functions:::::::::::::::::::::
+            -format: header and every ephemeris
+             of the store into the buffer
+            -write: format and write to a file
+            -buffer, size: formatted text
+_____________________________________________________
+
+*/
+class RinexNavWriter : public RinexFormat{
+
+    public:
+
+    std::string program;
+    std::string agency;
+
+    RinexNavWriter() : program("ubx-gps-protocol"), agency("") {}
+
+    /*
+        Format a navigation file, records by PRN
+        then toe
+        @param iono: GPSA / GPSB lines, NULL to skip
+        @param time: GPUT and LEAP SECONDS, NULL to skip,
+                     leap seconds at the first toc
+    */
+    void format(const EphemerisStore& store, const IonoEngine* iono = NULL,
+                const TimeService* time = NULL)
+    {
+        size_t records = 0;
+        double first = INFINITY;
+        for(int prn = 1 ; prn <= MAXPRN ; prn++)
+        {
+            records += store.ephemerides(prn).size();
+            for(const eph& e: store.ephemerides(prn))
+                first = std::min(first, gpst_seconds(gpst2time(full_week((int)e.week), e.toc)));
+        }
+
+        buf.resize((RNX_HDR_LINES + records * RNX_REC_LINES) * RNX_LINE);
+        p = buf.data();
+
+        header(iono, time, first);
+        for(int prn = 1 ; prn <= MAXPRN ; prn++)
+            for(const eph& e: store.ephemerides(prn)) record(prn, e);
+
+        buf.resize(p - buf.data());
+    }
+
+    /* format and write, false if the file can not be opened */
+    bool write(const std::string& path, const EphemerisStore& store,
+               const IonoEngine* iono = NULL, const TimeService* time = NULL)
+    {
+        format(store, iono, time);
+
+        FILE* fp = fopen(path.c_str(), "wb");
+        if(fp == NULL){
+            std::cout << "Rinex file can not be opened: " << path << std::endl;
+            return false;
+        }
+        size_t n = fwrite(buf.data(), 1, buf.size(), fp);
+        fclose(fp);
+        return n == buf.size();
+    }
+
+    const char* buffer() const { return buf.data(); }
+    size_t size() const { return buf.size(); }
+
+    private:
+
+    std::vector<char> buf;
+
+    /* first: gps seconds of the earliest toc, infinite if none */
+    void header(const IonoEngine* iono, const TimeService* time, double first)
+    {
+        char* line = p;
+        fixed(RNX_VERSION, 9, 2);
+        pad(line + 20);
+        text("N: GNSS NAV DATA");
+        pad(line + 40);
+        text("G: GPS");
+        label(line, "RINEX VERSION / TYPE");
+
+        run_by(program.c_str(), agency.c_str());
+
+        if(iono && iono->valid)
+        {
+            const double* coef[2] = { iono->alpha, iono->beta };
+            const char* name[2] = { "GPSA", "GPSB" };
+            for(int k = 0 ; k < 2 ; k++){
+                line = p;
+                text(name[k]);
+                *p++ = ' ';
+                for(int i = 0 ; i < 4 ; i++) sci(coef[k][i], 12, 4);
+                label(line, "IONOSPHERIC CORR");
+            }
+        }
+
+        if(time && time->utc_params)
+        {
+            double week = floor(time->tot / 604800.0);
+            line = p;
+            text("GPUT ");
+            sci(time->A0, 17, 10);
+            sci(time->A1, 16, 9);
+            integer((long)(time->tot - week * 604800.0), 7);
+            integer((long)week, 5);
+            label(line, "TIME SYSTEM CORR");
+        }
+
+        /* leap count of the data, not of the wall clock */
+        if(time && std::isinf(first) && time->utc_params) first = time->tot;
+        if(time && !std::isinf(first))
+        {
+            line = p;
+            integer(time->leap_seconds(first), 6);
+            label(line, "LEAP SECONDS");
+        }
+
+        line = p;
+        label(line, "END OF HEADER");
+    }
+
+    void record(int prn, const eph& e)
+    {
+        /* ura index to meters, IS-GPS-200 20.3.3.3.1.3 */
+        static const double ura[] = { 2.4, 3.4, 4.85, 6.85, 9.65, 13.65, 24.0, 48.0,
+                                      96.0, 192.0, 384.0, 768.0, 1536.0, 3072.0,
+                                      6144.0 };
+
+        int week = full_week((int)e.week);
+
+        char* line = p;
+        *p++ = 'G';
+        integer(prn, 2, true);
+        *p++ = ' ';
+        epoch(gpst2time(week, e.toc));
+        sci(e.clock_bias);
+        sci(e.clock_drift);
+        sci(e.clock_rate);
+        end(line);
+
+        orbit(e.IODE, e.Crs, e.delta_n, e.M0);
+        orbit(e.Cuc, e.eccentricity, e.Cus, e.sqrtA);
+        orbit(e.TOE, e.Cic, e.OMEGA, e.Cis);
+        orbit(e.I0, e.Crc, e.omega, e.OMEGA_DOT);
+        orbit(e.IDOT, e.l2_codes, week, e.l2_p_flag);
+        orbit(ura[e.sv_acc < 15 ? e.sv_acc : 14], e.sv_health, e.tgd, e.IODC);
+
+        line = p;
+        text("    ");
+        sci(e.trans_time);
+        sci(e.fit_interval ? e.fit_interval : EPH_FIT_HOURS);
+        end(line);
+    }
+
+    /* broadcast orbit line, 4X,4D19.12 */
+    void orbit(double a, double b, double c, double d)
+    {
+        char* line = p;
+        text("    ");
+        sci(a);
+        sci(b);
+        sci(c);
+        sci(d);
+        end(line);
+    }
+
+};
+
+
+#endif
\ No newline at end of file
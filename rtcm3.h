@@ -0,0 +1,148 @@
+/****************************************
+ *
+ *   RTCM 3 encoder
+ *   Gps ephemeris message 1019 from the
+ *   assembled ephemerides
+ *   RTCM 10403.3 3.5.11
+ *
+ *   Frames are preamble, length, message
+ *   and the crc 24q of crc24q.h
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef RTCM3_H
+#define RTCM3_H
+
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+
+#include "bit.h"
+#include "crc24q.h"
+#include "ephemeris_store.h"
+#include "gps_l2_message_types.hpp"
+
+#define RTCM3_PREAMB  0xD3       /* frame preamble */
+#define RTCM3_HEAD    3          /* preamble, 6 reserved, 10 length bits */
+#define RTCM3_CRC     3
+#define RTCM3_MAXLEN  1023       /* message bytes */
+#define RTCM_1019_LEN 61         /* 488 bits */
+#define RTCM_1019_FRAME (RTCM3_HEAD + RTCM_1019_LEN + RTCM3_CRC)
+
+
+/*___________________________________________________
+   Rtcm3Encoder Class:
+        :member functions:::::::::::::::::::::
+            -frame: wrap a message in place
+            -eph1019: gps ephemeris frame
+_____________________________________________________
+
+*/
+class Rtcm3Encoder{
+
+    public:
+
+    /*
+        Preamble, length and crc around the message
+        at buff + RTCM3_HEAD
+        @param len: message bytes
+        @return frame bytes, 0 if len is too long
+    */
+    static int frame(uint8_t* buff, int len)
+    {
+        if(len < 0 || len > RTCM3_MAXLEN) return 0;
+
+        buff[0] = RTCM3_PREAMB;
+        setbitu(buff, 8, 6, 0);
+        setbitu(buff, 14, 10, (uint32_t)len);
+
+        uint32_t crc = crc24q_bytes(buff, RTCM3_HEAD + len);
+        setbitu(buff, (RTCM3_HEAD + len) * 8, 24, crc);
+        return RTCM3_HEAD + len + RTCM3_CRC;
+    }
+
+    /*
+        Message 1019, semi-circle terms of the store
+        are in radians. A cnav upload has no iode,
+        one is made from its toe so a rover sees every
+        upload as a new issue
+        @param buff: RTCM_1019_FRAME bytes at least
+        @param issue: sends of the same toe before, a
+                      corrected upload moves the iode
+        @return frame bytes, 0 and buff untouched if
+                the upload has no health
+    */
+    static int eph1019(int prn, const eph& e, uint8_t* buff, uint32_t issue = 0)
+    {
+        if(e.sv_health == EPH_HEALTH_UNKNOWN) return 0;
+        memset(buff, 0, RTCM_1019_FRAME);
+
+        uint32_t iode = ((e.IODE > 0 ? (uint32_t)e.IODE : iode_of(e.TOE)) + issue) & 0xFF;
+        uint32_t iodc = ((e.IODC > 0 ? (uint32_t)e.IODC : 0) & 0x300) | iode;
+        uint32_t sva  = e.sv_acc < EPH_URA_MAX ? e.sv_acc : EPH_URA_MAX;
+        double toc = fmod(e.toc, 604800.0);
+        if(toc < 0) toc += 604800.0;
+
+        int i = RTCM3_HEAD * 8;
+        setbitu(buff, i, 12, 1019);                             i += 12;
+        setbitu(buff, i,  6, prn);                              i +=  6;
+        setbitu(buff, i, 10, (uint32_t)e.week % 1024);          i += 10;
+        setbitu(buff, i,  4, sva);                              i +=  4;
+        setbitu(buff, i,  2, (uint32_t)e.l2_codes);             i +=  2;
+        setbits(buff, i, 14, round_to(e.IDOT / PI, P2_43));     i += 14;
+        setbitu(buff, i,  8, iode & 0xFF);                      i +=  8;
+        setbitu(buff, i, 16, (uint32_t)(toc / 16.0));           i += 16;
+        setbits(buff, i,  8, round_to(e.clock_rate, P2_55));    i +=  8;
+        setbits(buff, i, 16, round_to(e.clock_drift, P2_43));   i += 16;
+        setbits(buff, i, 22, round_to(e.clock_bias, P2_31));    i += 22;
+        setbitu(buff, i, 10, iodc & 0x3FF);                     i += 10;
+        setbits(buff, i, 16, round_to(e.Crs, P2_5));            i += 16;
+        setbits(buff, i, 16, round_to(e.delta_n / PI, P2_43));  i += 16;
+        setbits(buff, i, 32, round_to(e.M0 / PI, P2_31));       i += 32;
+        setbits(buff, i, 16, round_to(e.Cuc, P2_29));           i += 16;
+        setbitu(buff, i, 32, (uint32_t)floor(e.eccentricity / P2_33 + 0.5)); i += 32;
+        setbits(buff, i, 16, round_to(e.Cus, P2_29));           i += 16;
+        setbitu(buff, i, 32, (uint32_t)floor(e.sqrtA / P2_19 + 0.5)); i += 32;
+        setbitu(buff, i, 16, (uint32_t)(e.TOE / 16.0));         i += 16;
+        setbits(buff, i, 16, round_to(e.Cic, P2_29));           i += 16;
+        setbits(buff, i, 32, round_to(e.OMEGA / PI, P2_31));    i += 32;
+        setbits(buff, i, 16, round_to(e.Cis, P2_29));           i += 16;
+        setbits(buff, i, 32, round_to(e.I0 / PI, P2_31));       i += 32;
+        setbits(buff, i, 16, round_to(e.Crc, P2_5));            i += 16;
+        setbits(buff, i, 32, round_to(e.omega / PI, P2_31));    i += 32;
+        setbits(buff, i, 24, round_to(e.OMEGA_DOT / PI, P2_43)); i += 24;
+        setbits(buff, i,  8, round_to(e.tgd, P2_31));           i +=  8;
+        setbitu(buff, i,  6, lnav_health(e.sv_health));         i +=  6;
+        setbitu(buff, i,  1, (uint32_t)e.l2_p_flag);            i +=  1;
+        setbitu(buff, i,  1, e.fit_interval > 4 ? 1 : 0);       i +=  1;
+
+        return frame(buff, RTCM_1019_LEN);
+    }
+
+    /* 6 bit lnav health, any unhealthy signal sets it */
+    static uint32_t lnav_health(uint8_t health)
+    {
+        return health ? 0x3F : 0;
+    }
+
+    /* 8 bit issue from the 300 s toe step, distinct over 21 h */
+    static uint32_t iode_of(double toe)
+    {
+        return ((uint32_t)(toe / 300.0)) & 0xFF;
+    }
+
+    private:
+
+    static int32_t round_to(double v, double scale)
+    {
+        return (int32_t)floor(v / scale + 0.5);
+    }
+
+};
+
+
+#endif
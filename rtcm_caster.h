@@ -0,0 +1,233 @@
+/****************************************
+ *
+ *   RTCM caster
+ *   Local tcp server streaming message
+ *   1019 of every new or corrected
+ *   upload to connected rovers
+ *
+ *   Sockets are non blocking with nagle
+ *   off, a frame is sent from the decode
+ *   loop as soon as the store changes. A
+ *   new rover first gets the last frame
+ *   of every PRN
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef RTCM_CASTER_H
+#define RTCM_CASTER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <iostream>
+#ifndef WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+typedef int socket_t;
+#define BAD_SOCKET    (-1)
+#define close_socket  ::close
+#else
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define BAD_SOCKET    INVALID_SOCKET
+#define close_socket  closesocket
+#define MSG_NOSIGNAL  0
+#endif
+
+#include "rtcm3.h"
+#include "ephemeris_store.h"
+
+#define CASTER_PORT   2101       /* ntrip caster port */
+#define CASTER_BACKLOG 8
+
+
+/*___________________________________________________
+   RtcmCaster Class:
+        :frames: frames published since listen
+        :member functions:::::::::::::::::::::
+            -listen, close: server socket
+            -publish: 1019 of a PRN, or of each
+             PRN whose store generation changed,
+             a resend of the same toe takes the
+             next iode
+            -clients: connected rovers
+_____________________________________________________
+
+*/
+class RtcmCaster{
+
+    public:
+
+    size_t frames;
+
+    RtcmCaster() : frames(0), server(BAD_SOCKET)
+    {
+        for(int i = 0 ; i <= MAXPRN ; i++){
+            sent[i] = 0;
+            toe[i] = -1;
+            issue[i] = 0;
+            last_len[i] = 0;
+        }
+    }
+
+    ~RtcmCaster() { close(); }
+
+    /*
+        Listen on host:port, loopback by default
+        @return false if the socket can not be bound
+    */
+    bool listen(int port = CASTER_PORT, const char* host = "127.0.0.1")
+    {
+        close();
+#ifdef WIN32
+        WSADATA wsa;
+        if(WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return false;
+#endif
+        server = socket(AF_INET, SOCK_STREAM, 0);
+        if(server == BAD_SOCKET) return false;
+
+        int on = 1;
+        setsockopt(server, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof on);
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        inet_pton(AF_INET, host, &addr.sin_addr);
+
+        if(bind(server, (sockaddr*)&addr, sizeof addr) != 0
+           || ::listen(server, CASTER_BACKLOG) != 0)
+        {
+            std::cout << "Caster can not listen on " << host << ":" << port << std::endl;
+            close();
+            return false;
+        }
+        nonblocking(server);
+        frames = 0;
+        return true;
+    }
+
+    void close()
+    {
+        for(socket_t c: peers) close_socket(c);
+        peers.clear();
+        if(server != BAD_SOCKET) close_socket(server);
+        server = BAD_SOCKET;
+    }
+
+    int clients() const { return (int)peers.size(); }
+
+    /* send one ephemeris now */
+    void publish(int prn, const eph& e)
+    {
+        if(prn < 1 || prn > MAXPRN) return;
+
+        /* without health a rover would take the PRN as healthy */
+        if(e.sv_health == EPH_HEALTH_UNKNOWN) return;
+
+        /* same toe again is a corrected upload, new issue */
+        double key = e.week * 604800.0 + e.TOE;
+        if(key == toe[prn]) issue[prn]++;
+        else{
+            toe[prn] = key;
+            issue[prn] = 0;
+        }
+
+        /* rovers joining now get the frame this one replaces */
+        accept_all();
+        last_len[prn] = Rtcm3Encoder::eph1019(prn, e, last[prn], issue[prn]);
+        send(last[prn], last_len[prn]);
+        frames++;
+    }
+
+    /*
+        Latest upload of every PRN whose generation
+        moved since the last call, inserts and dc
+        corrections alike. Rovers waiting to connect
+        are taken in first, whether anything changed
+        or not
+    */
+    void publish(const EphemerisStore& store)
+    {
+        accept_all();
+        for(int prn = 1 ; prn <= MAXPRN ; prn++)
+        {
+            uint32_t g = store.generation(prn);
+            if(g == sent[prn] || store.ephemerides(prn).empty()) continue;
+            sent[prn] = g;
+            publish(prn, store.ephemerides(prn).back());
+        }
+    }
+
+    private:
+
+    socket_t server;
+    std::vector<socket_t> peers;
+    uint32_t sent[MAXPRN + 1];
+    double toe[MAXPRN + 1];                     /* week seconds of the last toe sent */
+    uint32_t issue[MAXPRN + 1];                 /* sends of that toe before */
+    uint8_t last[MAXPRN + 1][RTCM_1019_FRAME];  /* last frame of each PRN */
+    int last_len[MAXPRN + 1];
+
+    static void nonblocking(socket_t s)
+    {
+#ifndef WIN32
+        fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#else
+        u_long on = 1;
+        ioctlsocket(s, FIONBIO, &on);
+#endif
+    }
+
+    /* rovers waiting on the backlog, each gets the current set */
+    void accept_all()
+    {
+        if(server == BAD_SOCKET) return;
+
+        socket_t c;
+        while((c = accept(server, NULL, NULL)) != BAD_SOCKET)
+        {
+            int on = 1;
+            setsockopt(c, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof on);
+            nonblocking(c);
+
+            bool ok = true;
+            for(int prn = 1 ; prn <= MAXPRN && ok ; prn++)
+                if(last_len[prn])
+                    ok = ::send(c, (const char*)last[prn], last_len[prn], MSG_NOSIGNAL)
+                         == last_len[prn];
+            if(ok) peers.push_back(c);
+            else close_socket(c);
+        }
+    }
+
+    /*
+        A rover that can not take a whole frame is
+        dropped, a partial frame would corrupt the
+        stream and the decoder must not wait
+    */
+    void send(const uint8_t* buff, int n)
+    {
+        for(size_t i = 0 ; i < peers.size() ; )
+        {
+            if(::send(peers[i], (const char*)buff, n, MSG_NOSIGNAL) == n){ i++; continue; }
+            close_socket(peers[i]);
+            peers[i] = peers.back();
+            peers.pop_back();
+        }
+    }
+
+};
+
+
+#endif
@@ -0,0 +1,233 @@
+/****************************************
+ *
+ *   Time service
+ *   GPS <-> UTC conversion seeded from
+ *   the leap second table and the utc
+ *   parameters of message 33
+ *   IS-GPS-200 30.3.3.6.2
+ *
+ *   Leap boundaries are kept as integer
+ *   seconds since the gps epoch in both
+ *   time scales; times after the latest
+ *   boundary convert in O(1)
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef TIME_SERVICE_H
+#define TIME_SERVICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <cmath>
+
+#include "gpstime.h"
+#include "gps_l2_satellite.h"
+
+
+/*___________________________________________________
+   TimeService Class:
+        :gps_edge: gps seconds a leap count starts
+        :utc_edge: same boundaries in utc seconds
+        :leap: gps - utc from the boundary on (s)
+        :A0, A1, A2, tot: utc polynomial of the
+                          latest message 33
+        :member functions:::::::::::::::::::::
+            -update: take a decoded message 33
+            -collect: latest message 33 of a file
+            -leap_seconds: gps - utc at gps time
+            -gps2utc, utc2gps: single and batch
+_____________________________________________________
+
+*/
+class TimeService{
+
+    public:
+
+    double A0, A1, A2;
+    double tot;               /* gps seconds since gps epoch */
+    bool utc_params;          /* apply A0, A1, A2 */
+
+    TimeService()
+    {
+        A0 = A1 = A2 = tot = 0;
+        utc_params = false;
+
+        /* before the first leap, gps = utc */
+        gps_edge.push_back(INT64_MIN);
+        utc_edge.push_back(INT64_MIN);
+        leap.push_back(0);
+
+        int n = 0;
+        while(leaps[n][0] > 0) n++;
+        for(int i = n - 1 ; i >= 0 ; i--)
+            add_edge((int64_t)gpst_seconds(epoch2time(leaps[i])), (int)-leaps[i][6]);
+    }
+
+    /*
+        Utc parameters of message 33, a leap second
+        the table does not know yet is added at the
+        end of day DN of week WNLSF
+    */
+    void update(const Msg_Type_33& m)
+    {
+        A0 = m.A0;
+        A1 = m.A1;
+        A2 = m.A2;
+        tot = m.WNot * 604800.0 + m.tot;
+        utc_params = true;
+
+        if(m.DN >= 1 && m.DN <= 7 && m.deltatLSF > leap.back())
+            add_edge((int64_t)m.WNLSF * 604800 + (int64_t)m.DN * 86400, m.deltatLSF);
+    }
+
+    /* message 33 with the latest tow count */
+    void collect(const SatelliteFile& file)
+    {
+        const Msg_Type_33* latest = NULL;
+        for(int i = 1 ; i <= MAXPRN ; i++)
+        {
+            const Satellite* s = file.satellite[i];
+            if(s->m33.empty()) continue;
+            if(latest == NULL || s->m33.back().TOW > latest->TOW)
+                latest = &s->m33.back();
+        }
+        if(latest) update(*latest);
+    }
+
+    /* gps - utc leap seconds at gps seconds t */
+    int leap_seconds(double t) const
+    {
+        return leap[interval(gps_edge, t)];
+    }
+
+    /*
+        Gps to utc, both in seconds since the gps
+        epoch, utc on its own scale
+    */
+    double gps2utc(double t) const
+    {
+        return t - leap[interval(gps_edge, t)] - polynomial(t);
+    }
+
+    double utc2gps(double t) const
+    {
+        double g = t + leap[interval(utc_edge, t)];
+        return g + polynomial(g);
+    }
+
+    gtime_t gps2utc(gtime_t t) const
+    {
+        double sec = gpst_seconds(t);
+        t.time -= leap[interval(gps_edge, sec)];
+        return utc_params ? timeadd(t, -polynomial(sec)) : t;
+    }
+
+    gtime_t utc2gps(gtime_t t) const
+    {
+        t.time += leap[interval(utc_edge, gpst_seconds(t))];
+        return utc_params ? timeadd(t, polynomial(gpst_seconds(t))) : t;
+    }
+
+    /*
+        Batch gps to utc of n times, a batch inside
+        one leap interval is a single vector loop
+        @param t: gps seconds since gps epoch
+        @param out: utc seconds since gps epoch
+    */
+    void gps2utc(const double* t, size_t n, double* out) const
+    {
+        convert(gps_edge, t, n, out, -1.0);
+    }
+
+    void utc2gps(const double* t, size_t n, double* out) const
+    {
+        convert(utc_edge, t, n, out, 1.0);
+    }
+
+    private:
+
+    std::vector<int64_t> gps_edge;
+    std::vector<int64_t> utc_edge;
+    std::vector<int> leap;
+
+    /* boundary at utc seconds u, gps - utc is ls from then on */
+    void add_edge(int64_t u, int ls)
+    {
+        size_t i = utc_edge.size();
+        while(i > 1 && utc_edge[i-1] > u) i--;
+        if(utc_edge[i-1] == u) return;
+
+        utc_edge.insert(utc_edge.begin() + i, u);
+        gps_edge.insert(gps_edge.begin() + i, u + ls);
+        leap.insert(leap.begin() + i, ls);
+    }
+
+    /* utc offset beyond the leap seconds at gps seconds t */
+    double polynomial(double t) const
+    {
+        if(!utc_params) return 0;
+        double dt = t - tot;
+        return A0 + dt * (A1 + dt * A2);
+    }
+
+    /* last boundary at or before t, O(1) past the latest one */
+    static size_t interval(const std::vector<int64_t>& edge, double t)
+    {
+        size_t n = edge.size();
+        if(t >= (double)edge[n-1]) return n - 1;
+
+        size_t lo = 0, hi = n - 1;
+        while(hi - lo > 1){
+            size_t mid = (lo + hi) / 2;
+            if(t >= (double)edge[mid]) lo = mid; else hi = mid;
+        }
+        return lo;
+    }
+
+    void convert(const std::vector<int64_t>& edge, const double* t, size_t n,
+                 double* out, double sign) const
+    {
+        if(n == 0) return;
+
+        double lo = t[0], hi = t[0];
+        OMP_SIMD(reduction(min:lo) reduction(max:hi))
+        for(size_t i = 0 ; i < n ; i++){
+            lo = t[i] < lo ? t[i] : lo;
+            hi = t[i] > hi ? t[i] : hi;
+        }
+
+        /* polynomial is taken at gps time, the output for utc2gps */
+        double a0 = utc_params ? A0 : 0, a1 = utc_params ? A1 : 0;
+        double a2 = utc_params ? A2 : 0;
+        double at = sign > 0 ? 1.0 : 0.0;
+
+        size_t k = interval(edge, lo);
+        if(k == interval(edge, hi))
+        {
+            /* one leap count for the whole batch */
+            double ls = sign * leap[k], t0 = tot - at * ls;
+            OMP_SIMD()
+            for(size_t i = 0 ; i < n ; i++){
+                double dt = t[i] - t0;
+                out[i] = t[i] + ls + sign * (a0 + dt * (a1 + dt * a2));
+            }
+            return;
+        }
+
+        /* batch spans a boundary */
+        for(size_t i = 0 ; i < n ; i++){
+            double ls = sign * leap[interval(edge, t[i])];
+            double dt = t[i] + at * ls - tot;
+            out[i] = t[i] + ls + sign * (a0 + dt * (a1 + dt * a2));
+        }
+    }
+
+};
+
+
+#endif
@@ -0,0 +1,276 @@
+/****************************************
+ *
+ *   UBX framer
+ *   Incremental UBX framing over a byte
+ *   ring for streams that arrive in
+ *   pieces, tcp and udp receivers
+ *
+ *   Frames are checked with the full
+ *   fletcher checksum before their length
+ *   is trusted, gps l2 subframes go to
+ *   SatelliteFile::decode_frame
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef UBX_FRAMER_H
+#define UBX_FRAMER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gps_l2_cnav_decode.h"
+
+#define UBX_HEAD      6          /* sync, class, id, length */
+#define UBX_MAXLEN    2048       /* longest payload accepted */
+#define RING_BYTES    65536      /* default ring, power of two */
+
+
+/*___________________________________________________
+   ByteRing Class:
+        Power of two ring, indices run free
+        and are masked on access
+        :member functions:::::::::::::::::::::
+            -spans: free space as up to two
+             writable blocks, for readv
+            -commit: bytes written to spans
+            -peek, copy, consume: reader side
+_____________________________________________________
+
+*/
+class ByteRing{
+
+    public:
+
+    explicit ByteRing(size_t bytes = RING_BYTES) : head(0), tail(0)
+    {
+        cap = 1;
+        while(cap < bytes) cap <<= 1;
+        mask = cap - 1;
+        buff = (uint8_t*)malloc(cap);
+    }
+
+    ~ByteRing() { free(buff); }
+
+    ByteRing(const ByteRing&) = delete;
+    ByteRing& operator=(const ByteRing&) = delete;
+
+    size_t size() const { return head - tail; }
+    size_t space() const { return cap - size(); }
+    size_t capacity() const { return cap; }
+
+    /* @return blocks, 0 when full */
+    int spans(uint8_t** p, size_t* n)
+    {
+        size_t free_bytes = space();
+        if(free_bytes == 0) return 0;
+
+        size_t at = head & mask;
+        size_t first = cap - at < free_bytes ? cap - at : free_bytes;
+        p[0] = buff + at; n[0] = first;
+        if(first == free_bytes) return 1;
+        p[1] = buff; n[1] = free_bytes - first;
+        return 2;
+    }
+
+    void commit(size_t n) { head += n; }
+
+    /* datagrams and tests, n at most space() */
+    void write(const uint8_t* src, size_t n)
+    {
+        for(size_t i = 0 ; i < n ; ) {
+            size_t at = (head + i) & mask;
+            size_t k = cap - at < n - i ? cap - at : n - i;
+            memcpy(buff + at, src + i, k);
+            i += k;
+        }
+        head += n;
+    }
+
+    uint8_t peek(size_t i) const { return buff[(tail + i) & mask]; }
+
+    void copy(size_t i, size_t n, uint8_t* dst) const
+    {
+        for(size_t j = 0 ; j < n ; ) {
+            size_t at = (tail + i + j) & mask;
+            size_t k = cap - at < n - j ? cap - at : n - j;
+            memcpy(dst + j, buff + at, k);
+            j += k;
+        }
+    }
+
+    void consume(size_t n) { tail += n; }
+
+    private:
+
+    uint8_t* buff;
+    size_t cap;
+    size_t mask;
+    size_t head;           /* bytes written */
+    size_t tail;           /* bytes consumed */
+
+};
+
+
+/* gps l2 subframe out of its ubx frame */
+typedef struct{
+
+    UbxFrame head;         /* CK_A, CK_B included */
+    uint32_t words[10];
+
+} frame_view;
+
+
+/*___________________________________________________
+   UbxFramer Class:
+        :frames: gps l2 frames decoded
+        :bad: frames failing the checksum
+        :skipped: bytes dropped to resync
+        :member functions:::::::::::::::::::::
+            -next: next complete frame of a
+             ring
+            -each: every complete frame of a
+             ring, an incomplete tail is kept
+             for the next call
+            -scan: each, gps l2 frames decoded
+             into a file
+            -view: gps l2 subframe of a frame
+_____________________________________________________
+
+*/
+class UbxFramer{
+
+    public:
+
+    size_t frames;
+    size_t bad;
+    size_t skipped;
+
+    UbxFramer() : frames(0), bad(0), skipped(0) {}
+
+    /*
+        @param frame: at least UBX_HEAD + UBX_MAXLEN + 2
+                      bytes, the frame found
+        @param len: its payload length
+        @return false when the ring holds no complete
+                frame, an incomplete tail is kept
+    */
+    bool next(ByteRing& ring, uint8_t* frame, size_t& len)
+    {
+        while(ring.size() >= UBX_HEAD + 2)
+        {
+            if(ring.peek(0) != H1 || ring.peek(1) != H2){
+                ring.consume(1); skipped++;
+                continue;
+            }
+
+            len = ring.peek(4) | (size_t)ring.peek(5) << 8;
+            if(len > UBX_MAXLEN){
+                ring.consume(1); skipped++;
+                continue;
+            }
+            if(ring.size() < UBX_HEAD + len + 2) return false;
+
+            ring.copy(0, UBX_HEAD + len + 2, frame);
+
+            ck checksum;
+            for(size_t i = 2 ; i < UBX_HEAD + len ; i++) calculate(checksum, frame[i]);
+            if(checksum.ck_a != frame[UBX_HEAD + len] || checksum.ck_b != frame[UBX_HEAD + len + 1]){
+                bad++;
+                ring.consume(1); skipped++;
+                continue;
+            }
+            ring.consume(UBX_HEAD + len + 2);
+            return true;
+        }
+        return false;
+    }
+
+    /*
+        @param found: called as found(frame, len) for
+                      frames passing the checksum,
+                      len is the payload length
+        @return frames found
+    */
+    template <class F>
+    int each(ByteRing& ring, F found)
+    {
+        int n = 0;
+        uint8_t frame[UBX_HEAD + UBX_MAXLEN + 2];
+        size_t len;
+
+        while(next(ring, frame, len))
+        {
+            found((const uint8_t*)frame, len);
+            n++;
+        }
+        return n;
+    }
+
+    /*
+        @param decoded: called as decoded(prn) after
+                        each frame the file decoded
+        @return frames decoded by this call
+    */
+    template <class F>
+    int scan(ByteRing& ring, SatelliteFile& file, F decoded)
+    {
+        int n = 0;
+        each(ring, [&](const uint8_t* f, size_t len)
+        {
+            frame_view v;
+            if(!view(f, len, v)) return;
+
+            file.decode_frame(v.head, v.words);
+            frames++;
+            n++;
+            decoded((int)v.head.svId);
+        });
+        return n;
+    }
+
+    int scan(ByteRing& ring, SatelliteFile& file)
+    {
+        return scan(ring, file, [](int){});
+    }
+
+    /* @return false for frames other than gps l2 subframes */
+    static bool view(const uint8_t* f, size_t len, frame_view& v)
+    {
+        if(f[2] != BRD_CLASS || f[3] != BRD_ID || len != LENGTH) return false;
+
+        const uint8_t* p = f + UBX_HEAD;
+        if(p[0] != GNSS_ID || p[2] != signal || p[1] < 1 || p[1] > 32) return false;
+
+        UbxFrame& h = v.head;
+        h.preamble1 = f[0];
+        h.preamble2 = f[1];
+        h.msgClass  = f[2];
+        h.msgID     = f[3];
+        h.length    = (U2)len;
+        h.gnssId    = p[0];
+        h.svId      = p[1];
+        h.reserved0 = p[2];
+        h.freqId    = p[3];
+        h.numWords  = p[4];
+        h.chn       = p[5];
+        h.version   = p[6];
+        h.reserved1 = p[7];
+        h.CK_A      = f[UBX_HEAD + len];
+        h.CK_B      = f[UBX_HEAD + len + 1];
+
+        for(int i = 0 ; i < 10 ; i++)
+            v.words[i] = (uint32_t)p[8 + 4*i] | (uint32_t)p[9 + 4*i] << 8
+                       | (uint32_t)p[10 + 4*i] << 16 | (uint32_t)p[11 + 4*i] << 24;
+        return true;
+    }
+
+};
+
+
+#endif
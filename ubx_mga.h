@@ -0,0 +1,388 @@
+/****************************************
+ *
+ *   UBX-MGA-GPS assistance
+ *   EPH, ALM, IONO and UTC messages of
+ *   the latest decoded data for u-blox
+ *   receivers that cold start
+ *   u-blox M8 protocol 32.11.9
+ *
+ *   A set of frames is built once and
+ *   written to every receiver link, tcp
+ *   or serial
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef UBX_MGA_H
+#define UBX_MGA_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <iostream>
+#ifndef WIN32
+#include <termios.h>
+#endif
+
+#include "gps_l2_cnav_decode.h"
+#include "almanac.h"
+#include "iono_engine.h"
+#include "rtcm3.h"
+#include "rtcm_caster.h"
+
+#define MGA_CLASS     0x13       /* UBX-MGA */
+#define MGA_GPS       0x00       /* UBX-MGA-GPS */
+#define MGA_EPH       0x01       /* message types */
+#define MGA_ALM       0x02
+#define MGA_UTC       0x05
+#define MGA_IONO      0x06
+#define MGA_EPH_LEN   68         /* payload bytes */
+#define MGA_ALM_LEN   36
+#define MGA_UTC_LEN   20
+#define MGA_IONO_LEN  16
+#define UBX_OVERHEAD  8          /* sync, class, id, length, checksum */
+
+
+/*___________________________________________________
+   UbxMgaEncoder Class:
+        Payload fields little endian at their
+        protocol offsets, semi-circle terms of
+        the store are in radians
+        :member functions:::::::::::::::::::::
+            -mga_eph, mga_alm, mga_iono, mga_utc:
+             one frame
+            -assist: frames of every PRN with
+             an upload of known health or an
+             almanac
+_____________________________________________________
+
+*/
+class UbxMgaEncoder{
+
+    public:
+
+    /*
+        Health and ura of message 10, sent as rtcm 1019
+        sends them
+        @return false, nothing appended, if the upload
+                has no health
+    */
+    static bool mga_eph(int prn, const eph& e, std::vector<U1>& out)
+    {
+        if(e.sv_health == EPH_HEALTH_UNKNOWN) return false;
+
+        U1 p[MGA_EPH_LEN];
+        memset(p, 0, sizeof p);
+
+        uint32_t iodc = e.IODC > 0 ? (uint32_t)e.IODC : Rtcm3Encoder::iode_of(e.TOE);
+        double toc = fmod(e.toc, 604800.0);
+        if(toc < 0) toc += 604800.0;
+
+        p[0] = MGA_EPH;
+        p[2] = (U1)prn;
+        p[4] = e.fit_interval > 4 ? 1 : 0;
+        p[5] = e.sv_acc < EPH_URA_MAX ? e.sv_acc : EPH_URA_MAX;
+        p[6] = (U1)Rtcm3Encoder::lnav_health(e.sv_health);
+        put(p, 7, 1, round_to(e.tgd, P2_31));
+        put(p, 8, 2, iodc & 0x3FF);
+        put(p, 10, 2, (int64_t)(toc / 16.0));
+        put(p, 13, 1, round_to(e.clock_rate, P2_55));
+        put(p, 14, 2, round_to(e.clock_drift, P2_43));
+        put(p, 16, 4, round_to(e.clock_bias, P2_31));
+        put(p, 20, 2, round_to(e.Crs, P2_5));
+        put(p, 22, 2, round_to(e.delta_n / PI, P2_43));
+        put(p, 24, 4, round_to(e.M0 / PI, P2_31));
+        put(p, 28, 2, round_to(e.Cuc, P2_29));
+        put(p, 30, 2, round_to(e.Cus, P2_29));
+        put(p, 32, 4, round_to(e.eccentricity, P2_33));
+        put(p, 36, 4, round_to(e.sqrtA, P2_19));
+        put(p, 40, 2, (int64_t)(e.TOE / 16.0));
+        put(p, 42, 2, round_to(e.Cic, P2_29));
+        put(p, 44, 4, round_to(e.OMEGA / PI, P2_31));
+        put(p, 48, 2, round_to(e.Cis, P2_29));
+        put(p, 50, 2, round_to(e.Crc, P2_5));
+        put(p, 52, 4, round_to(e.I0 / PI, P2_31));
+        put(p, 56, 4, round_to(e.omega / PI, P2_31));
+        put(p, 60, 4, round_to(e.OMEGA_DOT / PI, P2_43));
+        put(p, 64, 2, round_to(e.IDOT / PI, P2_43));
+
+        frame(p, sizeof p, out);
+        return true;
+    }
+
+    /* almanac health is the 6 bit lnav code, any unhealthy signal sets it */
+    static void mga_alm(int prn, const alm& a, std::vector<U1>& out)
+    {
+        U1 p[MGA_ALM_LEN];
+        memset(p, 0, sizeof p);
+
+        p[0] = MGA_ALM;
+        p[2] = (U1)prn;
+        p[3] = a.health ? 0x3F : 0;
+        put(p, 4, 2, round_to(a.e, P2_21));
+        p[6] = (U1)(a.week & 0xFF);
+        p[7] = (U1)(a.toa / ALM_TOA_SCALE);
+        put(p, 8, 2, round_to(a.i0 / PI - ALM_I0, P2_19));
+        put(p, 10, 2, round_to(a.OMEGA_DOT / PI, P2_38));
+        put(p, 12, 4, round_to(a.sqrtA, P2_11));
+        put(p, 16, 4, round_to(a.OMEGA0 / PI, P2_23));
+        put(p, 20, 4, round_to(a.omega / PI, P2_23));
+        put(p, 24, 4, round_to(a.M0 / PI, P2_23));
+        put(p, 28, 2, round_to(a.af0, P2_20));
+        put(p, 30, 2, round_to(a.af1, P2_38));
+
+        frame(p, sizeof p, out);
+    }
+
+    static void mga_iono(const IonoEngine& k, std::vector<U1>& out)
+    {
+        static const double alpha[4] = { P2_30, P2_27, P2_24, P2_24 };
+        static const double beta[4]  = { 2048, 16384, 65536, 65536 };
+
+        U1 p[MGA_IONO_LEN];
+        memset(p, 0, sizeof p);
+
+        p[0] = MGA_IONO;
+        for(int i = 0 ; i < 4 ; i++){
+            put(p, 4 + i, 1, round_to(k.alpha[i], alpha[i]));
+            put(p, 8 + i, 1, round_to(k.beta[i], beta[i]));
+        }
+        frame(p, sizeof p, out);
+    }
+
+    static void mga_utc(const Msg_Type_33& m, std::vector<U1>& out)
+    {
+        U1 p[MGA_UTC_LEN];
+        memset(p, 0, sizeof p);
+
+        p[0] = MGA_UTC;
+        put(p, 4, 4, round_to(m.A0, P2_30));
+        put(p, 8, 4, round_to(m.A1, P2_50));
+        put(p, 12, 1, m.deltatLS);
+        p[13] = (U1)(m.tot / ALM_TOA_SCALE);
+        p[14] = (U1)(m.WNot & 0xFF);
+        p[15] = (U1)(m.WNLSF & 0xFF);
+        p[16] = (U1)m.DN;
+        put(p, 17, 1, m.deltatLSF);
+
+        frame(p, sizeof p, out);
+    }
+
+    /*
+        Assistance of the latest data, iono and utc
+        first, then ephemerides, then almanacs
+        @param utc_msg: latest message 33, NULL to skip
+    */
+    static void assist(const EphemerisStore& store, const Almanac& almanac,
+                       const IonoEngine& iono_engine, const Msg_Type_33* utc_msg,
+                       std::vector<U1>& out)
+    {
+        out.clear();
+        out.reserve(2 * MAXPRN * (MGA_EPH_LEN + UBX_OVERHEAD));
+
+        if(iono_engine.valid) mga_iono(iono_engine, out);
+        if(utc_msg) mga_utc(*utc_msg, out);
+        for(int prn = 1 ; prn <= MAXPRN ; prn++)
+            if(!store.ephemerides(prn).empty()) mga_eph(prn, store.ephemerides(prn).back(), out);
+        for(int prn = 1 ; prn <= MAXPRN ; prn++)
+            if(almanac.sat[prn].valid) mga_alm(prn, almanac.sat[prn], out);
+    }
+
+    /* same of a decoded file, utc of its latest message 33 */
+    static void assist(const SatelliteFile& file, const Almanac& almanac,
+                       const IonoEngine& iono_engine, std::vector<U1>& out)
+    {
+        const Msg_Type_33* latest = NULL;
+        for(int i = 1 ; i <= MAXPRN ; i++)
+        {
+            const Satellite* s = file.satellite[i];
+            if(s->m33.empty()) continue;
+            if(latest == NULL || s->m33.back().TOW > latest->TOW)
+                latest = &s->m33.back();
+        }
+        assist(file.ephemerides, almanac, iono_engine, latest, out);
+    }
+
+    private:
+
+    /* sync, class, id, length, payload, checksum of ck */
+    static void frame(const U1* payload, U2 len, std::vector<U1>& out)
+    {
+        U1 head[6] = { H1, H2, MGA_CLASS, MGA_GPS, (U1)(len & 0xFF), (U1)(len >> 8) };
+
+        ck checksum;
+        for(int i = 2 ; i < 6 ; i++) calculate(checksum, head[i]);
+        for(U2 i = 0 ; i < len ; i++) calculate(checksum, payload[i]);
+
+        out.insert(out.end(), head, head + 6);
+        out.insert(out.end(), payload, payload + len);
+        out.push_back(checksum.ck_a);
+        out.push_back(checksum.ck_b);
+    }
+
+    /* little endian two's complement field */
+    static void put(U1* p, int at, int bytes, int64_t v)
+    {
+        for(int i = 0 ; i < bytes ; i++, v >>= 8) p[at + i] = (U1)(v & 0xFF);
+    }
+
+    static int64_t round_to(double v, double scale)
+    {
+        return (int64_t)floor(v / scale + 0.5);
+    }
+
+};
+
+
+/*___________________________________________________
+   MgaLinks Class:
+        Receivers to assist, tcp endpoints
+        and serial ports
+        :member functions:::::::::::::::::::::
+            -tcp, serial: add a receiver
+            -push: frames to every receiver
+            -close
+_____________________________________________________
+
+*/
+class MgaLinks{
+
+    public:
+
+    ~MgaLinks() { close(); }
+
+    /* receiver behind a tcp to serial bridge or ser2net */
+    bool tcp(const char* host, int port)
+    {
+#ifdef WIN32
+        WSADATA wsa;
+        if(WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return false;
+#endif
+        socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+        if(s == BAD_SOCKET) return false;
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        inet_pton(AF_INET, host, &addr.sin_addr);
+
+        if(connect(s, (sockaddr*)&addr, sizeof addr) != 0){
+            std::cout << "Receiver can not be reached: " << host << ":" << port << std::endl;
+            close_socket(s);
+            return false;
+        }
+        int on = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof on);
+        link l = { true, s, -1 };
+        links.push_back(l);
+        return true;
+    }
+
+    /* raw 8N1 serial port */
+    bool serial(const char* path, int baud)
+    {
+#ifndef WIN32
+        int fd = ::open(path, O_RDWR | O_NOCTTY);
+        if(fd < 0){
+            std::cout << "Serial port can not be opened: " << path << std::endl;
+            return false;
+        }
+        struct termios tio;
+        tcgetattr(fd, &tio);
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, speed(baud));
+        cfsetospeed(&tio, speed(baud));
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &tio);
+
+        link l = { false, BAD_SOCKET, fd };
+        links.push_back(l);
+        return true;
+#else
+        std::cout << "Serial links are not supported on this platform" << std::endl;
+        return false;
+#endif
+    }
+
+    /* @return receivers that took every byte */
+    int push(const std::vector<U1>& frames)
+    {
+        int ok = 0;
+        for(const link& l: links)
+            if(write_all(l, frames.data(), frames.size())) ok++;
+        return ok;
+    }
+
+    int receivers() const { return (int)links.size(); }
+
+    void close()
+    {
+        for(const link& l: links){
+            if(l.is_tcp) close_socket(l.s);
+#ifndef WIN32
+            else ::close(l.fd);
+#endif
+        }
+        links.clear();
+    }
+
+    private:
+
+    typedef struct
+    {
+        bool is_tcp;
+        socket_t s;
+        int fd;
+    } link;
+
+    std::vector<link> links;
+
+    static bool write_all(const link& l, const U1* p, size_t n)
+    {
+        while(n > 0)
+        {
+            long k;
+            if(l.is_tcp) k = ::send(l.s, (const char*)p, (int)n, MSG_NOSIGNAL);
+#ifndef WIN32
+            else k = ::write(l.fd, p, n);
+#else
+            else k = -1;
+#endif
+            if(k <= 0) return false;
+            p += k;
+            n -= (size_t)k;
+        }
+#ifndef WIN32
+        if(!l.is_tcp) tcdrain(l.fd);
+#endif
+        return true;
+    }
+
+#ifndef WIN32
+    static speed_t speed(int baud)
+    {
+        switch(baud)
+        {
+            case 4800:   return B4800;
+            case 19200:  return B19200;
+            case 38400:  return B38400;
+            case 57600:  return B57600;
+            case 115200: return B115200;
+            case 230400: return B230400;
+            case 460800: return B460800;
+            case 921600: return B921600;
+            default:     return B9600;
+        }
+    }
+#endif
+
+};
+
+
+#endif
@@ -0,0 +1,294 @@
+/****************************************
+ *
+ *   Visibility predictor
+ *   Rise / set times, elevation and
+ *   azimuth tracks of gps satellites
+ *   from the constellation almanac for
+ *   many ground sites
+ *
+ *   Satellite positions are computed
+ *   once per epoch in parallel over PRNs
+ *   then shared by sites, which run in
+ *   parallel over sites
+ *
+ *   @author :  Berru Karakas
+ *   @info   :  karakasb19@itu.edu.tr
+ *
+ ****************************************/
+
+
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+
+#include "almanac.h"
+
+#define WGS84_A   6378137.0            /* earth semi major axis (m) */
+#define WGS84_E2  6.69437999014E-3     /* first eccentricity squared */
+
+
+/*
+___________________________________________________
+   Site Struct:
+        geodetic latitude, longitude (rad)
+        ellipsoidal height (m)
+        elevation mask (rad), below the
+        horizon if negative
+___________________________________________________
+
+*/
+typedef struct
+{
+    double lat;
+    double lon;
+    double hgt;
+    double mask;
+
+} site_t;
+
+/*
+___________________________________________________
+   Pass Struct:
+        rise and set in gps seconds, a pass
+        already in view at the start rises at
+        t0, one still in view sets at t1
+___________________________________________________
+
+*/
+typedef struct
+{
+    int prn;
+    double rise;
+    double set;
+    double max_el;          /* rad */
+
+} pass_t;
+
+
+/*___________________________________________________
+   VisibilityPredictor Class:
+        :almanac: constellation almanac
+        :threads: worker count, 0 for all cores
+        :passes: per site passes, by rise time
+                 within a PRN
+        :elevation, azimuth: per site tracks,
+                 [ (prn-1) * epochs + k ] (rad)
+        :member functions:::::::::::::::::::::
+            -predict: passes (and tracks) of sites
+_____________________________________________________
+
+*/
+class VisibilityPredictor{
+
+    public:
+
+    std::vector<std::vector<pass_t> > passes;
+    std::vector<std::vector<float> > elevation;
+    std::vector<std::vector<float> > azimuth;
+    size_t epochs;
+
+    VisibilityPredictor(const Almanac& alm, int threads = 0)
+        : almanac(alm), workers(threads)
+    {
+        if(workers <= 0) workers = std::thread::hardware_concurrency();
+        if(workers <= 0) workers = 1;
+        epochs = 0;
+    }
+
+    /*
+        Predict passes of every PRN over sites
+        @param sites: ground sites
+        @param t0, t1: gps seconds since gps epoch
+        @param step: epoch interval (s)
+        @param tracks: also keep el/az tracks
+        @return false for step <= 0 or t1 < t0,
+                nothing is predicted
+    */
+    bool predict(const std::vector<site_t>& sites, double t0, double t1,
+                 double step, bool tracks = false)
+    {
+        if(!(step > 0) || !(t1 >= t0)){
+            std::cout << "Visibility span or step is not valid" << std::endl;
+            epochs = 0;
+            passes.clear();
+            elevation.clear();
+            azimuth.clear();
+            return false;
+        }
+
+        epochs = (size_t)floor((t1 - t0) / step) + 1;
+        start = t0;
+        interval = step;
+
+        /* satellite positions, shared by sites */
+        for(int k = 0 ; k < 3 ; k++) xyz[k].assign((size_t)MAXPRN * epochs, 0);
+        in_view.assign(MAXPRN + 1, 0);
+        for(int prn = 1 ; prn <= MAXPRN ; prn++) in_view[prn] = almanac.sat[prn].valid;
+
+        parallel(MAXPRN, [&](size_t i){ orbit((int)i + 1); });
+
+        passes.assign(sites.size(), std::vector<pass_t>());
+        elevation.assign(tracks ? sites.size() : 0, std::vector<float>());
+        azimuth.assign(tracks ? sites.size() : 0, std::vector<float>());
+
+        parallel(sites.size(), [&](size_t i){ site(sites[i], i, tracks); });
+        return true;
+    }
+
+    private:
+
+    const Almanac& almanac;
+    int workers;
+    double start;
+    double interval;
+    std::vector<double> xyz[3];        /* per PRN, per epoch */
+    std::vector<uint8_t> in_view;      /* PRN has an almanac, set before the workers */
+
+    /* run job(i) for i < n over the workers */
+    template <class F>
+    void parallel(size_t n, F job)
+    {
+        std::atomic<size_t> next(0);
+        auto work = [&](){
+            for(size_t i = next++ ; i < n ; i = next++) job(i);
+        };
+
+        std::vector<std::thread> pool;
+        for(int w = 1 ; w < workers && (size_t)w < n ; w++)
+            pool.push_back(std::thread(work));
+        work();
+        for(auto& t: pool) t.join();
+    }
+
+    void orbit(int prn)
+    {
+        if(!in_view[prn]) return;
+
+        size_t base = (size_t)(prn - 1) * epochs;
+        for(size_t k = 0 ; k < epochs ; k++){
+            double p[3];
+            almanac.position(prn, start + k * interval, p);
+            xyz[0][base + k] = p[0];
+            xyz[1][base + k] = p[1];
+            xyz[2][base + k] = p[2];
+        }
+    }
+
+    void site(const site_t& s, size_t index, bool tracks)
+    {
+        /* site position and local up, east, north */
+        double sp = sin(s.lat), cp = cos(s.lat);
+        double sl = sin(s.lon), cl = cos(s.lon);
+        double N = WGS84_A / sqrt(1.0 - WGS84_E2 * sp * sp);
+        double r[3] = { (N + s.hgt) * cp * cl, (N + s.hgt) * cp * sl,
+                        (N * (1.0 - WGS84_E2) + s.hgt) * sp };
+        double up[3] = { cp * cl, cp * sl, sp };
+        double east[3] = { -sl, cl, 0 };
+        double north[3] = { -sp * cl, -sp * sl, cp };
+
+        double sin_mask = sin(s.mask);
+        double mask2 = sin_mask * sin_mask;
+        bool below = sin_mask < 0;
+
+        std::vector<uint8_t> visible(epochs);
+        std::vector<pass_t>& out = passes[index];
+        if(tracks){
+            elevation[index].assign((size_t)MAXPRN * epochs, 0);
+            azimuth[index].assign((size_t)MAXPRN * epochs, 0);
+        }
+
+        for(int prn = 1 ; prn <= MAXPRN ; prn++)
+        {
+            if(!in_view[prn]) continue;
+
+            size_t base = (size_t)(prn - 1) * epochs;
+            const double* x = &xyz[0][base];
+            const double* y = &xyz[1][base];
+            const double* z = &xyz[2][base];
+            uint8_t* v = visible.data();
+
+            /* above mask: d.up >= sin(mask) |d|, squared to skip sqrt,
+               a mask below the horizon also takes u < 0 down to it */
+            for(size_t k = 0 ; k < epochs ; k++){
+                double dx = x[k] - r[0], dy = y[k] - r[1], dz = z[k] - r[2];
+                double u = dx * up[0] + dy * up[1] + dz * up[2];
+                double d2 = dx * dx + dy * dy + dz * dz;
+                v[k] = below ? (u >= 0) | (u * u <= mask2 * d2)
+                             : (u >= 0) & (u * u >= mask2 * d2);
+            }
+
+            if(tracks){
+                float* el = &elevation[index][base];
+                float* az = &azimuth[index][base];
+                for(size_t k = 0 ; k < epochs ; k++){
+                    double d[3] = { x[k] - r[0], y[k] - r[1], z[k] - r[2] };
+                    double e = dot(d, east), n = dot(d, north), u = dot(d, up);
+                    el[k] = (float)atan2(u, sqrt(e * e + n * n));
+                    az[k] = (float)atan2(e, n);
+                    if(az[k] < 0) az[k] += (float)(2 * PI);
+                }
+            }
+
+            /* transitions, crossing times interpolated on sin(el) */
+            pass_t p = pass_t();
+            bool up_now = false;
+            double best = -1;
+            for(size_t k = 0 ; k < epochs ; k++)
+            {
+                if(v[k] && !up_now){
+                    p.prn = prn;
+                    p.rise = k == 0 ? start : crossing(x, y, z, r, up, k, sin_mask);
+                    best = -1;
+                    up_now = true;
+                }
+                if(v[k]){
+                    double se = sin_el(x[k], y[k], z[k], r, up);
+                    if(se > best) best = se;
+                }
+                if(!v[k] && up_now){
+                    p.set = crossing(x, y, z, r, up, k, sin_mask);
+                    p.max_el = asin(best);
+                    out.push_back(p);
+                    up_now = false;
+                }
+            }
+            if(up_now){
+                p.set = start + (epochs - 1) * interval;
+                p.max_el = asin(best);
+                out.push_back(p);
+            }
+        }
+    }
+
+    static double dot(const double* a, const double* b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    static double sin_el(double x, double y, double z,
+                         const double* r, const double* up)
+    {
+        double d[3] = { x - r[0], y - r[1], z - r[2] };
+        return dot(d, up) / sqrt(dot(d, d));
+    }
+
+    /* time sin(el) crosses the mask between epochs k-1 and k */
+    double crossing(const double* x, const double* y, const double* z,
+                    const double* r, const double* up, size_t k, double sin_mask) const
+    {
+        double a = sin_el(x[k-1], y[k-1], z[k-1], r, up);
+        double b = sin_el(x[k], y[k], z[k], r, up);
+        double f = b != a ? (sin_mask - a) / (b - a) : 0;
+        return start + (k - 1 + f) * interval;
+    }
+
+};
+
+
+#endif